@@ -0,0 +1,73 @@
+#include "arena.h"
+#include <cstdlib>
+
+namespace sim
+{
+
+CArena::CArena(void) {
+	m_head = NULL;
+	m_offset = 0;
+	m_used = 0;
+	m_capacity = 0;
+	m_blocks = 0;
+	m_blockAllocations = 0;
+}
+
+CArena::~CArena(void) {
+	release();
+}
+
+void CArena::addBlock(size_t size) {
+	Block* block = (Block*)malloc(sizeof(Block) + size);
+	if (block == NULL) throw std::bad_alloc();
+	block->next = m_head;
+	block->size = size;
+	m_head = block;
+	m_offset = 0;
+	m_capacity += size;
+	m_blocks++;
+	m_blockAllocations++;
+}
+
+void* CArena::allocate(size_t bytes, size_t align) {
+	if (m_head) {
+		// the header keeps block data aligned to the header's size, align the address itself
+		const size_t base = (size_t)blockData(m_head);
+		const size_t start = ((base + m_offset + align - 1) & ~(align - 1)) - base;
+		if (start + bytes <= m_head->size) {
+			m_used += start + bytes - m_offset;
+			m_offset = start + bytes;
+			return blockData(m_head) + start;
+		}
+		// the tail of the block stays unused until the next reset
+		m_used += m_head->size - m_offset;
+		m_offset = m_head->size;
+	}
+	addBlock(bytes + align > ARENA_BLOCK ? bytes + align : ARENA_BLOCK);
+	return allocate(bytes, align);
+}
+
+void CArena::reset() {
+	// one block with room for everything the last level needed
+	if (m_blocks > 1) {
+		const size_t size = m_capacity;
+		release();
+		addBlock(size);
+	}
+	m_offset = 0;
+	m_used = 0;
+}
+
+void CArena::release() {
+	while (m_head) {
+		Block* next = m_head->next;
+		free(m_head);
+		m_head = next;
+	}
+	m_offset = 0;
+	m_used = 0;
+	m_capacity = 0;
+	m_blocks = 0;
+}
+
+}
@@ -0,0 +1,127 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: arena.h
+//
+// Desc: Per-level memory. CArena hands out memory by bumping a pointer through large
+//       blocks and gives all of it back at once with reset(); CArenaArray is a fixed
+//       capacity array that lives in an arena and constructs / destroys its elements in
+//       place. reset() folds the blocks of the last level into one block big enough for
+//       all of them, so reloading a level of the same size or smaller takes no allocation.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __arenaH__
+#define __arenaH__
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+#define ARENA_BLOCK (64 * 1024)     // smallest block the arena asks the system for
+
+namespace sim
+{
+	class CArena {
+	public:
+		CArena(void);
+		~CArena(void);
+
+		// never fails short of running out of memory; align must be a power of two
+		void* allocate(size_t bytes, size_t align);
+		template <class T> T* allocateArray(size_t count) { return (T*)allocate(count * sizeof(T), alignof(T)); }
+
+		// forgets everything handed out; whoever constructed objects in it destroys them first
+		void reset();
+		// reset() and gives the blocks back to the system
+		void release();
+
+		size_t getUsed() const { return m_used; }
+		size_t getCapacity() const { return m_capacity; }
+		int getBlocks() const { return m_blocks; }
+		// blocks taken from the system since the arena was made
+		unsigned long getBlockAllocations() const { return m_blockAllocations; }
+
+	private:
+		struct Block
+		{
+			Block*	next;
+			size_t	size;       // usable bytes after the header
+		};
+
+		CArena(const CArena&);
+		CArena& operator=(const CArena&);
+
+		void addBlock(size_t size);
+		static char* blockData(Block* block) { return (char*)(block + 1); }
+
+		Block*			m_head;     // block being filled, older ones follow
+		size_t			m_offset;   // into m_head
+		size_t			m_used;
+		size_t			m_capacity;
+		int				m_blocks;
+		unsigned long	m_blockAllocations;
+	};
+
+	// -----------------------------------------------------------------------------
+	// CArenaArray : vector-like storage for one level's objects
+	// -----------------------------------------------------------------------------
+
+	template <class T>
+	class CArenaArray {
+	public:
+		CArenaArray(void) : m_data(NULL), m_size(0), m_capacity(0) {}
+		~CArenaArray(void) { clear(); }
+
+		// room for capacity elements; the old storage goes back with the arena's reset()
+		void allocate(CArena& arena, size_t capacity) {
+			clear();
+			m_data = capacity ? arena.allocateArray<T>(capacity) : NULL;
+			m_capacity = capacity;
+		}
+		// destroys the elements and drops the storage, before the arena is reset
+		void release() {
+			clear();
+			m_data = NULL;
+			m_capacity = 0;
+		}
+
+		// false, with nothing written, once the capacity is used up
+		bool push_back(const T& value) {
+			if (m_size >= m_capacity) return false;
+			new (m_data + m_size) T(value);
+			m_size++;
+			return true;
+		}
+		// boxes and enemies have nothing to destroy, so dropping a level is free
+		void clear() {
+			if (!std::is_trivially_destructible<T>::value) {
+				for (size_t i = 0; i < m_size; i++) m_data[i].~T();
+			}
+			m_size = 0;
+		}
+
+		size_t size() const { return m_size; }
+		size_t capacity() const { return m_capacity; }
+		bool empty() const { return m_size == 0; }
+
+		T& operator[](size_t i) { return m_data[i]; }
+		const T& operator[](size_t i) const { return m_data[i]; }
+		T& back() { return m_data[m_size - 1]; }
+		T* data() { return m_data; }
+		const T* data() const { return m_data; }
+		T* begin() { return m_data; }
+		T* end() { return m_data + m_size; }
+		const T* begin() const { return m_data; }
+		const T* end() const { return m_data + m_size; }
+
+	private:
+		CArenaArray(const CArenaArray&);
+		CArenaArray& operator=(const CArenaArray&);
+
+		T*		m_data;
+		size_t	m_size;
+		size_t	m_capacity;
+	};
+}
+
+#endif // __arenaH__
@@ -0,0 +1,354 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: benchmark.cpp
+//
+// Desc: Microbenchmarks of the simulation's hot paths, without a GPU: CWall::hasIntersected,
+//       the enemy update pass at several enemy counts, bullet integration (CSphere::ballUpdate
+//       and CProjectilePool::integrate), goable() / win() lookups, and make_map /
+//       locate_enemy at several map sizes. Levels come from the seeded maze generator, so
+//       every run measures the same work. Each case prints a line and all of them go to
+//       a JSON file with --json, for tracking over time:
+//
+//           { "benchmark": "VirtualLegoBench", "threads": 1, "quick": false,
+//             "cases": [ { "name": "wall_intersect", "params": { "walls": 64 },
+//                          "unit": "ns", "per": "test", "samples": 15,
+//                          "min": 1.2, "mean": 1.3, "p99": 1.5 }, ... ] }
+//
+//       --quick runs smaller sizes and fewer samples, --filter NAME only the cases whose
+//       name contains NAME, --threads T the world on T threads (default 1).
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gameSim.h"
+#include "mazeGenerator.h"
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct BenchParam
+{
+	const char* name;
+	double value;
+};
+
+struct BenchResult
+{
+	std::string name;
+	std::vector<BenchParam> params;
+	const char* unit;       // of min / mean / p99
+	const char* per;        // what one measured operation is
+	int samples;
+	double min, mean, p99;
+};
+
+struct BenchOptions
+{
+	bool quick;
+	int threads;
+	const char* filter;
+};
+
+static std::vector<BenchResult> results;
+static volatile long long sink;     // keeps results the compiler would otherwise drop
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool wanted(const BenchOptions& options, const char* name) {
+	return options.filter == NULL || strstr(name, options.filter) != NULL;
+}
+
+static void report(const char* name, const std::vector<BenchParam>& params, const char* unit, const char* per,
+	int samples, double min, double mean, double p99) {
+	BenchResult r;
+	r.name = name;
+	r.params = params;
+	r.unit = unit;
+	r.per = per;
+	r.samples = samples;
+	r.min = min;
+	r.mean = mean;
+	r.p99 = p99;
+	results.push_back(r);
+
+	std::string label = name;
+	for (size_t i = 0; i < params.size(); i++) {
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), "%s%s=%.*f", i ? "," : " ", params[i].name,
+			params[i].value == floor(params[i].value) ? 0 : 3, params[i].value);
+		label += buffer;
+	}
+	printf("%-56s %10.3f %-3s/%-8s min %10.3f  p99 %10.3f  (%d samples)\n", label.c_str(), mean, unit, per, min, p99, samples);
+}
+
+// times in the unit per operation, one per sample
+static void reportSamples(const char* name, const std::vector<BenchParam>& params, const char* unit, const char* per,
+	std::vector<double> samples) {
+	std::sort(samples.begin(), samples.end());
+	double sum = 0;
+	for (size_t i = 0; i < samples.size(); i++) sum += samples[i];
+	const size_t p99 = std::min(samples.size() - 1, (size_t)(samples.size() * 0.99));
+	report(name, params, unit, per, (int)samples.size(), samples[0], sum / samples.size(), samples[p99]);
+}
+
+// one profiled scope, in milliseconds per call
+static bool reportScope(const char* scope, const char* name, const std::vector<BenchParam>& params, const char* per) {
+	std::vector<sim::PhaseSummary> phases;
+	sim::CProfiler::summarize(phases);
+	for (size_t i = 0; i < phases.size(); i++) {
+		if (strcmp(phases[i].name, scope) != 0) continue;
+		report(name, params, "ms", per, phases[i].count, phases[i].min_ms, phases[i].avg_ms, phases[i].p99_ms);
+		return true;
+	}
+	return false;
+}
+
+static double unit(unsigned int& state) {
+	state = state * 1664525u + 1013904223u;
+	return (state >> 8) * (1.0 / 16777216.0);
+}
+
+// a generated maze written to a temporary .lvl, so CWorld::loadFile() can map it
+static bool makeLevel(int size, int enemies, const char* path) {
+	sim::MazeSettings settings;
+	settings.cols = settings.rows = size;
+	settings.seed = 1;
+	settings.enemies = enemies;
+	sim::CMazeGenerator generator;
+	std::vector<std::string> rows;
+	sim::CLevel level;
+	return generator.generate(settings, rows) && level.fromRows(rows) && level.save(path);
+}
+
+// -----------------------------------------------------------------------------
+// Cases
+// -----------------------------------------------------------------------------
+
+static void benchWallIntersect(const BenchOptions& options) {
+	const int wallCounts[2] = { 64, 4096 };
+	const int balls = 256;
+	for (int w = 0; w < 2; w++) {
+		unsigned int state = 1;
+		std::vector<sim::CWall> walls(wallCounts[w]);
+		for (size_t i = 0; i < walls.size(); i++) {
+			walls[i].setSize(WORLD_SIZE, WALL_HEIGHT, WORLD_SIZE);
+			walls[i].setPosition(unit(state) * 100 - 50, WALL_HEIGHT / 2, unit(state) * 100 - 50);
+		}
+		std::vector<sim::CSphere> spheres(balls);
+		for (size_t i = 0; i < spheres.size(); i++) spheres[i].setCenter(unit(state) * 100 - 50, unit(state) * WALL_HEIGHT, unit(state) * 100 - 50);
+
+		const int rounds = options.quick ? 2 : 8;
+		std::vector<double> samples;
+		for (int s = 0; s < (options.quick ? 5 : 15); s++) {
+			long long hits = 0;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int round = 0; round < rounds; round++)
+				for (int b = 0; b < balls; b++)
+					for (size_t i = 0; i < walls.size(); i++) hits += walls[i].hasIntersected(spheres[b]);
+			samples.push_back(seconds(start) * 1e9 / ((double)rounds * balls * walls.size()));
+			sink = hits;
+		}
+		std::vector<BenchParam> params(1);
+		params[0].name = "walls";
+		params[0].value = wallCounts[w];
+		reportSamples("wall_intersect", params, "ns", "test", samples);
+	}
+}
+
+static void benchEnemyUpdate(const BenchOptions& options, const char* path) {
+	const int counts[3] = { 100, 1000, 10000 };
+	const int size = 256;
+	for (int c = 0; c < 3; c++) {
+		if (options.quick && c == 2) break;
+		if (!makeLevel(size, counts[c], path)) return;
+		sim::CWorld world;
+		world.setThreads(options.threads);
+		if (!world.loadFile(path)) return;
+		sim::Input idle;
+		for (int t = 0; t < 30; t++) world.tick(1.0 / 60, idle);
+
+		// the pass is private to the world; its profile scope times it inside whole ticks
+		sim::CProfiler::clear();
+		sim::CProfiler::setEnabled(true);
+		for (int t = 0; t < (options.quick ? 100 : 500) && world.getStatus() == sim::GAME_RUNNING; t++) world.tick(1.0 / 60, idle);
+		sim::CProfiler::setEnabled(false);
+
+		std::vector<BenchParam> params(3);
+		params[0].name = "enemies";
+		params[0].value = (double)world.getEnemies().size();
+		params[1].name = "cells";
+		params[1].value = (double)size * size;
+		params[2].name = "threads";
+		params[2].value = world.getThreads();
+		reportScope("enemies", "enemy_update", params, "pass");
+		reportScope("tick", "tick", params, "tick");
+	}
+}
+
+static void benchBullets(const BenchOptions& options) {
+	const int counts[2] = { 1000, 100000 };
+	for (int c = 0; c < 2; c++) {
+		const int n = counts[c];
+		const int steps = options.quick ? 20 : 100;
+		std::vector<BenchParam> params(1);
+		params[0].name = "bullets";
+		params[0].value = n;
+
+		std::vector<sim::CSphere> spheres(n);
+		for (int i = 0; i < n; i++) spheres[i].setPowerY(1, 0.5, -1);
+		std::vector<double> samples;
+		for (int s = 0; s < (options.quick ? 5 : 15); s++) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int step = 0; step < steps; step++)
+				for (int i = 0; i < n; i++) spheres[i].ballUpdate(1.0 / 60);
+			samples.push_back(seconds(start) * 1e9 / ((double)steps * n));
+		}
+		sink = (long long)spheres[n - 1].getCenter().x;
+		reportSamples("bullet_ballUpdate", params, "ns", "bullet", samples);
+
+		sim::CArena arena;
+		sim::CProjectilePool pool;
+		pool.reserve(arena, n);
+		for (int i = 0; i < n; i++) pool.spawn(sim::Vec3(0, 1, 0), sim::Vec3(1, 0.5, -1), 0);
+		samples.clear();
+		for (int s = 0; s < (options.quick ? 5 : 15); s++) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int step = 0; step < steps; step++) pool.integrate(1.0 / 60);
+			samples.push_back(seconds(start) * 1e9 / ((double)steps * n));
+		}
+		sink = (long long)pool.getCenter(n - 1).x;
+		reportSamples("bullet_integrate", params, "ns", "bullet", samples);
+	}
+}
+
+static void benchLookups(const BenchOptions& options, const char* path) {
+	const int size = options.quick ? 256 : 1024;
+	if (!makeLevel(size, 0, path)) return;
+	sim::CWorld world;
+	if (!world.loadFile(path)) return;
+
+	const int n = 1 << 16;
+	unsigned int state = 1;
+	const double extent = size * WORLD_SIZE;
+	std::vector<double> xs(n), zs(n);
+	for (int i = 0; i < n; i++) {
+		xs[i] = unit(state) * extent - extent / 2;
+		zs[i] = unit(state) * extent - extent / 2;
+	}
+	std::vector<BenchParam> params(1);
+	params[0].name = "cells";
+	params[0].value = (double)size * size;
+
+	std::vector<double> samples;
+	for (int s = 0; s < (options.quick ? 5 : 15); s++) {
+		long long open = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < n; i++) open += world.goable(xs[i], zs[i]);
+		samples.push_back(seconds(start) * 1e9 / n);
+		sink = open;
+	}
+	reportSamples("goable", params, "ns", "lookup", samples);
+
+	// win() reads the player's position, so it is timed where the player stands
+	const int calls = 1 << 20;
+	samples.clear();
+	for (int s = 0; s < (options.quick ? 5 : 15); s++) {
+		long long won = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < calls; i++) won += world.win(0);
+		samples.push_back(seconds(start) * 1e9 / calls);
+		sink = won;
+	}
+	reportSamples("win", params, "ns", "lookup", samples);
+}
+
+static void benchLevelBuild(const BenchOptions& options, const char* path) {
+	const int sizes[4] = { 64, 256, 1024, 4096 };
+	for (int k = 0; k < 4; k++) {
+		if (options.quick && k == 3) break;
+		const int size = sizes[k];
+		const int enemies = size * size / 100;
+		if (!makeLevel(size, enemies, path)) return;
+		sim::CWorld world;
+		world.setCulling(false);        // the PVS build would dwarf what is measured here
+		sim::CProfiler::clear();
+		sim::CProfiler::setEnabled(true);
+		bool loaded = true;
+		for (int s = 0; s < (size >= 4096 ? 3 : options.quick ? 3 : 10) && loaded; s++) loaded = world.loadFile(path);
+		sim::CProfiler::setEnabled(false);
+		if (!loaded) return;
+
+		std::vector<BenchParam> params(3);
+		params[0].name = "cells";
+		params[0].value = (double)size * size;
+		params[1].name = "walls";
+		params[1].value = (double)world.getWalls().size();
+		params[2].name = "enemies";
+		params[2].value = (double)world.getEnemies().size();
+		reportScope("make_map", "make_map", params, "load");
+		reportScope("locate_enemy", "locate_enemy", params, "load");
+	}
+}
+
+// -----------------------------------------------------------------------------
+// JSON
+// -----------------------------------------------------------------------------
+
+static bool writeJson(const char* path, const BenchOptions& options) {
+	FILE* f = fopen(path, "w");
+	if (f == NULL) return false;
+	fprintf(f, "{\n  \"benchmark\": \"VirtualLegoBench\",\n  \"threads\": %d,\n  \"quick\": %s,\n  \"cases\": [\n",
+		options.threads, options.quick ? "true" : "false");
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchResult& r = results[i];
+		fprintf(f, "    { \"name\": \"%s\", \"params\": {", r.name.c_str());
+		for (size_t p = 0; p < r.params.size(); p++) fprintf(f, "%s \"%s\": %.17g", p ? "," : "", r.params[p].name, r.params[p].value);
+		fprintf(f, " }, \"unit\": \"%s\", \"per\": \"%s\", \"samples\": %d, \"min\": %.6g, \"mean\": %.6g, \"p99\": %.6g }%s\n",
+			r.unit, r.per, r.samples, r.min, r.mean, r.p99, i + 1 < results.size() ? "," : "");
+	}
+	fprintf(f, "  ]\n}\n");
+	return fclose(f) == 0;
+}
+
+static void usage(const char* argv0) {
+	printf("usage: %s [--json FILE] [--quick] [--filter NAME] [--threads T]\n", argv0);
+}
+
+int main(int argc, char* argv[]) {
+	BenchOptions options;
+	options.quick = false;
+	options.threads = 1;
+	options.filter = NULL;
+	const char* jsonPath = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--json") && i + 1 < argc) jsonPath = argv[++i];
+		else if (!strcmp(argv[i], "--quick")) options.quick = true;
+		else if (!strcmp(argv[i], "--filter") && i + 1 < argc) options.filter = argv[++i];
+		else if (!strcmp(argv[i], "--threads") && i + 1 < argc) options.threads = atoi(argv[++i]);
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	const char* levelPath = "vlbench.lvl";
+	if (wanted(options, "wall_intersect")) benchWallIntersect(options);
+	if (wanted(options, "enemy_update") || wanted(options, "tick")) benchEnemyUpdate(options, levelPath);
+	if (wanted(options, "bullet")) benchBullets(options);
+	if (wanted(options, "goable") || wanted(options, "win")) benchLookups(options, levelPath);
+	if (wanted(options, "make_map") || wanted(options, "locate_enemy")) benchLevelBuild(options, levelPath);
+	remove(levelPath);
+
+	if (jsonPath && !writeJson(jsonPath, options)) {
+		fprintf(stderr, "%s: cannot write\n", jsonPath);
+		return 1;
+	}
+	return 0;
+}
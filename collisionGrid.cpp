@@ -0,0 +1,237 @@
+#include "collisionGrid.h"
+#include <cmath>
+
+namespace sim
+{
+
+CCollisionGrid::CCollisionGrid(void) {
+	m_cols = m_rows = 0;
+	m_origin_x = m_origin_z = 0;
+	m_cell_size = 1;
+}
+
+void CCollisionGrid::clear() {
+	m_cols = m_rows = 0;
+	m_cellStart.clear();
+	m_entries.clear();
+}
+
+int CCollisionGrid::colOf(double x) const {
+	return (int)floor((x - m_origin_x) / m_cell_size);
+}
+
+int CCollisionGrid::rowOf(double z) const {
+	return (int)floor((m_origin_z - z) / m_cell_size);
+}
+
+static inline int clampi(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+bool sweepBox(const Vec3& from, const Vec3& to, const Vec3& lo, const Vec3& hi, double& t) {
+	const double a[3] = { from.x, from.y, from.z };
+	const double d[3] = { to.x - from.x, to.y - from.y, to.z - from.z };
+	const double l[3] = { lo.x, lo.y, lo.z };
+	const double h[3] = { hi.x, hi.y, hi.z };
+	double t0 = 0, t1 = 1;
+	for (int k = 0; k < 3; k++) {
+		if (d[k] == 0) {
+			if (a[k] <= l[k] || a[k] >= h[k]) return false;
+			continue;
+		}
+		double ta = (l[k] - a[k]) / d[k];
+		double tb = (h[k] - a[k]) / d[k];
+		if (ta > tb) { double tmp = ta; ta = tb; tb = tmp; }
+		if (ta > t0) t0 = ta;
+		if (tb < t1) t1 = tb;
+		if (t0 >= t1) return false;
+	}
+	t = t0;
+	return true;
+}
+
+bool sweepWall(const Vec3& from, const Vec3& to, double radius, const CWall& wall, double& t) {
+	Vec3 p = wall.getPosition();
+	Vec3 s = wall.getSize();
+	Vec3 lo(p.x - s.x / 2 - radius, p.y - s.y / 2 - radius, p.z - s.z / 2 - radius);
+	Vec3 hi(p.x + s.x / 2 + radius, p.y + s.y / 2 + radius, p.z + s.z / 2 + radius);
+	return sweepBox(from, to, lo, hi, t);
+}
+
+void CCollisionGrid::cellRange(const CWall& wall, int* range) const {
+	Vec3 p = wall.getPosition();
+	Vec3 s = wall.getSize();
+	range[0] = clampi((int)floor((p.x - s.x / 2 - m_origin_x) / m_cell_size), 0, m_cols - 1);
+	range[1] = clampi((int)ceil((p.x + s.x / 2 - m_origin_x) / m_cell_size) - 1, 0, m_cols - 1);
+	range[2] = clampi((int)floor((m_origin_z - p.z - s.z / 2) / m_cell_size), 0, m_rows - 1);
+	range[3] = clampi((int)ceil((m_origin_z - p.z + s.z / 2) / m_cell_size) - 1, 0, m_rows - 1);
+}
+
+bool CCollisionGrid::sameCells(const CWall& a, const CWall& b) const {
+	int ra[4], rb[4];
+	cellRange(a, ra);
+	cellRange(b, rb);
+	return ra[0] == rb[0] && ra[1] == rb[1] && ra[2] == rb[2] && ra[3] == rb[3];
+}
+
+void CCollisionGrid::build(const CWall* walls, int count, int cols, int rows, double origin_x, double origin_z, double cell_size) {
+	m_cols = cols;
+	m_rows = rows;
+	m_origin_x = origin_x;
+	m_origin_z = origin_z;
+	m_cell_size = cell_size;
+
+	// cell range of every wall; a box that ends exactly on a cell border does not enter the next cell
+	std::vector<int>& range = m_range;
+	range.resize(count * 4);
+	for (int i = 0; i < count; i++) cellRange(walls[i], &range[i * 4]);
+
+	// counting sort into a compressed (offset + entries) cell table
+	m_cellStart.assign(m_cols * m_rows + 1, 0);
+	for (int i = 0; i < count; i++) {
+		for (int r = range[i * 4 + 2]; r <= range[i * 4 + 3]; r++)
+			for (int c = range[i * 4 + 0]; c <= range[i * 4 + 1]; c++)
+				m_cellStart[r * m_cols + c + 1]++;
+	}
+	for (int k = 0; k < m_cols * m_rows; k++) m_cellStart[k + 1] += m_cellStart[k];
+
+	m_entries.resize(m_cellStart[m_cols * m_rows]);
+	std::vector<int>& fill = m_fill;
+	fill.assign(m_cellStart.begin(), m_cellStart.end() - 1);
+	for (int i = 0; i < count; i++) {
+		Entry e;
+		e.wall = i;
+		e.min_col = range[i * 4 + 0];
+		e.min_row = range[i * 4 + 2];
+		for (int r = range[i * 4 + 2]; r <= range[i * 4 + 3]; r++)
+			for (int c = range[i * 4 + 0]; c <= range[i * 4 + 1]; c++)
+				m_entries[fill[r * m_cols + c]++] = e;
+	}
+}
+
+bool CCollisionGrid::hasIntersected(const CSphere& ball, const CWall* walls, CollisionStats& stats) const {
+	stats.queries++;
+	if (m_cols == 0) return false;
+
+	Vec3 c = ball.getCenter();
+	double r = ball.getRadius();
+	int c0 = colOf(c.x - r), c1 = colOf(c.x + r);
+	int r0 = rowOf(c.z + r), r1 = rowOf(c.z - r);
+	if (c1 < 0 || r1 < 0 || c0 >= m_cols || r0 >= m_rows) return false;
+	c0 = clampi(c0, 0, m_cols - 1);	c1 = clampi(c1, 0, m_cols - 1);
+	r0 = clampi(r0, 0, m_rows - 1);	r1 = clampi(r1, 0, m_rows - 1);
+
+	for (int row = r0; row <= r1; row++) {
+		for (int col = c0; col <= c1; col++) {
+			const int cell = row * m_cols + col;
+			for (int k = m_cellStart[cell]; k < m_cellStart[cell + 1]; k++) {
+				const Entry& e = m_entries[k];
+				// a wall spanning several visited cells is only tested in the first of them
+				if (col != (e.min_col > c0 ? e.min_col : c0) || row != (e.min_row > r0 ? e.min_row : r0)) continue;
+				stats.box_tests++;
+				if (walls[e.wall].hasIntersected(ball)) return true;
+			}
+		}
+	}
+	return false;
+}
+
+int CCollisionGrid::firstIntersected(const CSphere& ball, const CWall* walls, const unsigned char* skip, CollisionStats& stats) const {
+	stats.queries++;
+	if (m_cols == 0) return -1;
+
+	Vec3 c = ball.getCenter();
+	double r = ball.getRadius();
+	int c0 = colOf(c.x - r), c1 = colOf(c.x + r);
+	int r0 = rowOf(c.z + r), r1 = rowOf(c.z - r);
+	if (c1 < 0 || r1 < 0 || c0 >= m_cols || r0 >= m_rows) return -1;
+	c0 = clampi(c0, 0, m_cols - 1);	c1 = clampi(c1, 0, m_cols - 1);
+	r0 = clampi(r0, 0, m_rows - 1);	r1 = clampi(r1, 0, m_rows - 1);
+
+	int first = -1;
+	for (int row = r0; row <= r1; row++) {
+		for (int col = c0; col <= c1; col++) {
+			const int cell = row * m_cols + col;
+			for (int k = m_cellStart[cell]; k < m_cellStart[cell + 1]; k++) {
+				const Entry& e = m_entries[k];
+				if (col != (e.min_col > c0 ? e.min_col : c0) || row != (e.min_row > r0 ? e.min_row : r0)) continue;
+				if ((skip && skip[e.wall]) || (first >= 0 && e.wall > first)) continue;
+				stats.box_tests++;
+				if (walls[e.wall].hasIntersected(ball)) first = e.wall;
+			}
+		}
+	}
+	return first;
+}
+
+bool CCollisionGrid::sweep(const Vec3& from, const Vec3& to, double radius, const CWall* walls,
+	const unsigned char* skip, CollisionStats& stats, double& t_hit, int& index) const {
+	stats.queries++;
+	if (m_cols == 0) return false;
+
+	// segment in cell units: u grows with columns, v with rows
+	const double u0 = (from.x - m_origin_x) / m_cell_size, v0 = (m_origin_z - from.z) / m_cell_size;
+	const double u1 = (to.x - m_origin_x) / m_cell_size, v1 = (m_origin_z - to.z) / m_cell_size;
+	const double du = u1 - u0, dv = v1 - v0;
+	const double ru = radius / m_cell_size;
+
+	int col = (int)floor(u0), row = (int)floor(v0);
+	const int end_col = (int)floor(u1), end_row = (int)floor(v1);
+	const int step_c = du > 0 ? 1 : -1, step_r = dv > 0 ? 1 : -1;
+	const double big = 1e300;
+	const double delta_c = du != 0 ? fabs(1 / du) : big;
+	const double delta_r = dv != 0 ? fabs(1 / dv) : big;
+	double max_c = du > 0 ? (col + 1 - u0) / du : (du < 0 ? (u0 - col) / -du : big);
+	double max_r = dv > 0 ? (row + 1 - v0) / dv : (dv < 0 ? (v0 - row) / -dv : big);
+	int steps = abs(end_col - col) + abs(end_row - row) + 1;
+
+	double best = 2;
+	int best_index = -1;
+	double t_enter = 0;
+	while (steps-- > 0) {
+		const double t_exit = max_c < max_r ? (max_c < 1 ? max_c : 1) : (max_r < 1 ? max_r : 1);
+
+		// cells touched by the sphere while its center crosses this cell
+		const double ua = u0 + du * t_enter, ub = u0 + du * t_exit;
+		const double va = v0 + dv * t_enter, vb = v0 + dv * t_exit;
+		int c0 = (int)floor((ua < ub ? ua : ub) - ru), c1 = (int)floor((ua < ub ? ub : ua) + ru);
+		int r0 = (int)floor((va < vb ? va : vb) - ru), r1 = (int)floor((va < vb ? vb : va) + ru);
+		if (c1 >= 0 && r1 >= 0 && c0 < m_cols && r0 < m_rows) {
+			c0 = clampi(c0, 0, m_cols - 1);	c1 = clampi(c1, 0, m_cols - 1);
+			r0 = clampi(r0, 0, m_rows - 1);	r1 = clampi(r1, 0, m_rows - 1);
+			for (int r = r0; r <= r1; r++) {
+				for (int c = c0; c <= c1; c++) {
+					stats.cells_visited++;
+					const int cell = r * m_cols + c;
+					for (int k = m_cellStart[cell]; k < m_cellStart[cell + 1]; k++) {
+						const int w = m_entries[k].wall;
+						if (skip && skip[w]) continue;
+						stats.box_tests++;
+						double t;
+						if (sweepWall(from, to, radius, walls[w], t) && (t < best || (t == best && w < best_index))) {
+							best = t;
+							best_index = w;
+						}
+					}
+				}
+			}
+		}
+		// nothing later along the segment can be hit before what we already found
+		if (best <= t_exit || t_exit >= 1) break;
+
+		t_enter = t_exit;
+		if (max_c < max_r) {
+			col += step_c;
+			max_c += delta_c;
+		}
+		else {
+			row += step_r;
+			max_r += delta_r;
+		}
+	}
+
+	if (best_index < 0) return false;
+	t_hit = best;
+	index = best_index;
+	return true;
+}
+
+}
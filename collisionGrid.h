@@ -0,0 +1,82 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: collisionGrid.h
+//
+// Desc: Uniform grid over the map cells. Every static box is registered in the cells it
+//       covers, so a bullet only has to be tested against the boxes of the cells its
+//       sphere overlaps instead of against every wall of the level.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __collisionGridH__
+#define __collisionGridH__
+
+#include "simShapes.h"
+#include <vector>
+
+namespace sim
+{
+	struct CollisionStats
+	{
+		CollisionStats() { reset(); }
+		void reset() { queries = 0; box_tests = 0; cells_visited = 0; }
+		void add(const CollisionStats& o) { queries += o.queries; box_tests += o.box_tests; cells_visited += o.cells_visited; }
+
+		unsigned long long queries;         // sphere vs level queries
+		unsigned long long box_tests;       // box tests made by those queries
+		unsigned long long cells_visited;   // grid cells walked by swept queries
+	};
+
+	// first time t in [0, 1) at which the point from + (to - from) * t is strictly inside
+	// the box [lo, hi]; a segment starting inside reports t = 0
+	bool sweepBox(const Vec3& from, const Vec3& to, const Vec3& lo, const Vec3& hi, double& t);
+	// sweepBox() of a sphere against a wall grown by its radius
+	bool sweepWall(const Vec3& from, const Vec3& to, double radius, const CWall& wall, double& t);
+
+	class CCollisionGrid {
+	public:
+		CCollisionGrid(void);
+
+		// origin is the world position of the top-left corner of cell (row 0, col 0);
+		// rows grow towards -z and columns towards +x, like the map array.
+		void build(const CWall* walls, int count, int cols, int rows, double origin_x, double origin_z, double cell_size);
+		void clear();
+
+		bool hasIntersected(const CSphere& ball, const CWall* walls, CollisionStats& stats) const;
+		// lowest index among the boxes touching the ball (skip[] entries set are ignored), -1 if none
+		int firstIntersected(const CSphere& ball, const CWall* walls, const unsigned char* skip, CollisionStats& stats) const;
+
+		// continuous test of a sphere moving from -> to: walks the cells crossed by the
+		// segment (Amanatidis-Woo) and returns the first box touched, skipping boxes whose
+		// skip[] entry is set. Costs O(cells crossed) instead of O(boxes).
+		bool sweep(const Vec3& from, const Vec3& to, double radius, const CWall* walls,
+			const unsigned char* skip, CollisionStats& stats, double& t_hit, int& index) const;
+
+		// true when both boxes cover the same cells, so moving a box from one to the other
+		// leaves the grid valid without a rebuild
+		bool sameCells(const CWall& a, const CWall& b) const;
+
+		int getCols() const { return m_cols; }
+		int getRows() const { return m_rows; }
+		int colOf(double x) const;
+		int rowOf(double z) const;
+
+	private:
+		void cellRange(const CWall& wall, int* range) const;
+
+		struct Entry
+		{
+			int wall;
+			int min_col, min_row;   // first cell the wall covers, used to test it only once
+		};
+
+		int					m_cols, m_rows;
+		double				m_origin_x, m_origin_z;
+		double				m_cell_size;
+		std::vector<int>	m_cellStart;    // m_cols * m_rows + 1 offsets into m_entries
+		std::vector<Entry>	m_entries;
+		std::vector<int>	m_range, m_fill;    // build() scratch, kept so rebuilds do not allocate
+	};
+}
+
+#endif // __collisionGridH__
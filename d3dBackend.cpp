@@ -0,0 +1,174 @@
+#include "d3dBackend.h"
+
+namespace render
+{
+
+static const DWORD VERTEX_FVF = D3DFVF_XYZ | D3DFVF_NORMAL | D3DFVF_DIFFUSE;
+
+static D3DCOLORVALUE toD3D(const Color& c) {
+	D3DCOLORVALUE v;
+	v.r = c.r;	v.g = c.g;	v.b = c.b;	v.a = c.a;
+	return v;
+}
+
+static const D3DMATRIX* toD3D(const Mat4& m) {
+	// same row-major, row-vector layout as D3DXMATRIX
+	return reinterpret_cast<const D3DMATRIX*>(&m);
+}
+
+bool CD3DBackend::init(IDirect3DDevice9* device) {
+	release();
+	m_device = device;
+	if (m_device == NULL) return false;
+	m_device->SetRenderState(D3DRS_LIGHTING, TRUE);
+	// lit geometry takes its color from the material, not from the vertices
+	m_device->SetRenderState(D3DRS_COLORVERTEX, FALSE);
+	m_device->SetRenderState(D3DRS_SPECULARENABLE, TRUE);
+	m_device->SetRenderState(D3DRS_SHADEMODE, D3DSHADE_GOURAUD);
+	return true;
+}
+
+void CD3DBackend::release() {
+	for (size_t i = 0; i < m_meshes.size(); i++) releaseMesh((MeshHandle)i);
+	for (size_t i = 0; i < m_buffers.size(); i++) releaseBuffer((BufferHandle)i);
+	m_meshes.clear();
+	m_buffers.clear();
+	m_device = NULL;
+}
+
+MeshHandle CD3DBackend::createBox(float width, float height, float depth) {
+	ID3DXMesh* mesh = NULL;
+	if (m_device == NULL || FAILED(D3DXCreateBox(m_device, width, height, depth, &mesh, NULL)))
+		return -1;
+	m_meshes.push_back(mesh);
+	return (MeshHandle)m_meshes.size() - 1;
+}
+
+MeshHandle CD3DBackend::createSphere(float radius, int slices, int stacks) {
+	ID3DXMesh* mesh = NULL;
+	if (m_device == NULL || FAILED(D3DXCreateSphere(m_device, radius, slices, stacks, &mesh, NULL)))
+		return -1;
+	m_meshes.push_back(mesh);
+	return (MeshHandle)m_meshes.size() - 1;
+}
+
+BufferHandle CD3DBackend::createStaticBuffer(const Vertex* vertices, int vertexCount,
+	const unsigned short* indices, int indexCount) {
+	if (m_device == NULL || vertexCount <= 0 || indexCount <= 0) return -1;
+
+	Buffer b;
+	b.vb = NULL;
+	b.ib = NULL;
+	b.vertices = vertexCount;
+	b.triangles = indexCount / 3;
+	void* data = NULL;
+
+	if (FAILED(m_device->CreateVertexBuffer(vertexCount * sizeof(Vertex), D3DUSAGE_WRITEONLY, VERTEX_FVF,
+		D3DPOOL_MANAGED, &b.vb, NULL)))
+		return -1;
+	if (FAILED(b.vb->Lock(0, 0, &data, 0))) {
+		b.vb->Release();
+		return -1;
+	}
+	memcpy(data, vertices, vertexCount * sizeof(Vertex));
+	b.vb->Unlock();
+
+	if (FAILED(m_device->CreateIndexBuffer(indexCount * sizeof(unsigned short), D3DUSAGE_WRITEONLY, D3DFMT_INDEX16,
+		D3DPOOL_MANAGED, &b.ib, NULL))) {
+		b.vb->Release();
+		return -1;
+	}
+	if (FAILED(b.ib->Lock(0, 0, &data, 0))) {
+		b.vb->Release();
+		b.ib->Release();
+		return -1;
+	}
+	memcpy(data, indices, indexCount * sizeof(unsigned short));
+	b.ib->Unlock();
+
+	m_buffers.push_back(b);
+	return (BufferHandle)m_buffers.size() - 1;
+}
+
+void CD3DBackend::releaseMesh(MeshHandle mesh) {
+	if (mesh < 0 || mesh >= (int)m_meshes.size() || m_meshes[mesh] == NULL) return;
+	m_meshes[mesh]->Release();
+	m_meshes[mesh] = NULL;
+}
+
+void CD3DBackend::releaseBuffer(BufferHandle buffer) {
+	if (buffer < 0 || buffer >= (int)m_buffers.size() || m_buffers[buffer].vb == NULL) return;
+	m_buffers[buffer].vb->Release();
+	m_buffers[buffer].ib->Release();
+	m_buffers[buffer].vb = NULL;
+	m_buffers[buffer].ib = NULL;
+}
+
+bool CD3DBackend::beginFrame(unsigned int clearColor) {
+	if (m_device == NULL) return false;
+	m_device->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, clearColor, 1.0f, 0);
+	return !FAILED(m_device->BeginScene());
+}
+
+void CD3DBackend::endFrame() {
+	m_device->EndScene();
+	m_device->Present(0, 0, 0, 0);
+	m_device->SetTexture(0, NULL);
+}
+
+void CD3DBackend::setCamera(const Mat4& view, const Mat4& proj) {
+	m_device->SetTransform(D3DTS_VIEW, toD3D(view));
+	m_device->SetTransform(D3DTS_PROJECTION, toD3D(proj));
+}
+
+void CD3DBackend::setLight(int index, const PointLight& light) {
+	D3DLIGHT9 lit;
+	::ZeroMemory(&lit, sizeof(lit));
+	lit.Type = D3DLIGHT_POINT;
+	lit.Diffuse = toD3D(light.diffuse);
+	lit.Specular = toD3D(light.specular);
+	lit.Ambient = toD3D(light.ambient);
+	lit.Position.x = light.position.x;
+	lit.Position.y = light.position.y;
+	lit.Position.z = light.position.z;
+	lit.Range = light.range;
+	lit.Attenuation0 = light.attenuation0;
+	lit.Attenuation1 = light.attenuation1;
+	lit.Attenuation2 = light.attenuation2;
+	m_device->SetLight(index, &lit);
+	m_device->LightEnable(index, TRUE);
+}
+
+void CD3DBackend::setLighting(bool enable) {
+	m_device->SetRenderState(D3DRS_LIGHTING, enable ? TRUE : FALSE);
+}
+
+void CD3DBackend::setTransform(const Mat4& world) {
+	m_device->SetTransform(D3DTS_WORLD, toD3D(world));
+}
+
+void CD3DBackend::setMaterial(const Material& material) {
+	D3DMATERIAL9 mtrl;
+	mtrl.Ambient = toD3D(material.color);
+	mtrl.Diffuse = toD3D(material.color);
+	mtrl.Specular = toD3D(material.color);
+	mtrl.Emissive = toD3D(BLACK);
+	mtrl.Power = material.power;
+	m_device->SetMaterial(&mtrl);
+}
+
+void CD3DBackend::drawMesh(MeshHandle mesh) {
+	if (mesh < 0 || mesh >= (int)m_meshes.size() || m_meshes[mesh] == NULL) return;
+	m_meshes[mesh]->DrawSubset(0);
+}
+
+void CD3DBackend::drawBuffer(BufferHandle buffer) {
+	if (buffer < 0 || buffer >= (int)m_buffers.size() || m_buffers[buffer].vb == NULL) return;
+	const Buffer& b = m_buffers[buffer];
+	m_device->SetFVF(VERTEX_FVF);
+	m_device->SetStreamSource(0, b.vb, 0, sizeof(Vertex));
+	m_device->SetIndices(b.ib);
+	m_device->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, 0, b.vertices, 0, b.triangles);
+}
+
+}
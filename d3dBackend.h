@@ -0,0 +1,61 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: d3dBackend.h
+//
+// Desc: IRenderBackend on top of an IDirect3DDevice9. Meshes come from D3DX, static
+//       batches live in managed vertex/index buffers.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __d3dBackendH__
+#define __d3dBackendH__
+
+#include "d3dUtility.h"
+#include "renderBackend.h"
+#include <vector>
+
+namespace render
+{
+	class CD3DBackend : public IRenderBackend {
+	public:
+		CD3DBackend(void) : m_device(NULL) {}
+		~CD3DBackend(void) { release(); }
+
+		// sets the render states the scene relies on
+		bool init(IDirect3DDevice9* device);
+		void release();
+
+		MeshHandle createBox(float width, float height, float depth);
+		MeshHandle createSphere(float radius, int slices, int stacks);
+		BufferHandle createStaticBuffer(const Vertex* vertices, int vertexCount,
+			const unsigned short* indices, int indexCount);
+		void releaseMesh(MeshHandle mesh);
+		void releaseBuffer(BufferHandle buffer);
+
+		bool beginFrame(unsigned int clearColor);
+		void endFrame();
+		void setCamera(const Mat4& view, const Mat4& proj);
+		void setLight(int index, const PointLight& light);
+		void setLighting(bool enable);
+
+		void setTransform(const Mat4& world);
+		void setMaterial(const Material& material);
+		void drawMesh(MeshHandle mesh);
+		void drawBuffer(BufferHandle buffer);
+
+	private:
+		struct Buffer
+		{
+			IDirect3DVertexBuffer9*	vb;
+			IDirect3DIndexBuffer9*	ib;
+			int						vertices;
+			int						triangles;
+		};
+
+		IDirect3DDevice9*		m_device;
+		std::vector<ID3DXMesh*>	m_meshes;
+		std::vector<Buffer>		m_buffers;
+	};
+}
+
+#endif // __d3dBackendH__
@@ -0,0 +1,43 @@
+#include "enemyPool.h"
+
+namespace sim
+{
+
+CEnemyPool::CEnemyPool(void) {
+	m_x = m_z = NULL;
+	m_life = m_shots = NULL;
+	m_alive = NULL;
+	m_count = 0;
+	m_capacity = 0;
+}
+
+void CEnemyPool::reserve(CArena& arena, int capacity) {
+	m_count = 0;
+	m_capacity = capacity;
+	m_x = arena.allocateArray<double>(capacity);	m_z = arena.allocateArray<double>(capacity);
+	m_life = arena.allocateArray<int>(capacity);
+	m_shots = arena.allocateArray<int>(capacity);
+	m_alive = arena.allocateArray<unsigned char>(capacity);
+}
+
+int CEnemyPool::spawn(double x, double z) {
+	if (m_count >= m_capacity) return -1;
+	const int i = m_count++;
+	restore(i, x, z, ENEMY_LIFE, 0, true);
+	return i;
+}
+
+void CEnemyPool::shot(int i, bool headShot) {
+	m_life[i]--;
+	if (m_life[i] <= 0 || headShot) m_alive[i] = 0;
+}
+
+void CEnemyPool::restore(int i, double x, double z, int life, int shots, bool alive) {
+	m_x[i] = x;
+	m_z[i] = z;
+	m_life[i] = life;
+	m_shots[i] = shots;
+	m_alive[i] = alive ? 1 : 0;
+}
+
+}
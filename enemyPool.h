@@ -0,0 +1,61 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: enemyPool.h
+//
+// Desc: The enemies of a level stored as parallel arrays (position, life, bullets in the
+//       air, alive) taken from the level's arena, the way CProjectilePool keeps bullets.
+//       This is the state the enemy passes read and write every tick, a few bytes per
+//       enemy in contiguous memory. The body and head boxes follow from the position
+//       (enemyBody(), enemyHead() in gameSim.h) and only live in the world's hitbox array,
+//       which collision and the renderer look up by enemy index.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __enemyPoolH__
+#define __enemyPoolH__
+
+#include "simShapes.h"
+#include "arena.h"
+
+#define ENEMY_LIFE 3
+
+namespace sim
+{
+	class CEnemyPool {
+	public:
+		CEnemyPool(void);
+
+		// the only call that takes memory; it stays valid until the arena is reset
+		void reserve(CArena& arena, int capacity);
+		void clear() { m_count = 0; }
+
+		// a live enemy at the center of its spawn cell; returns its index, -1 when full
+		int spawn(double x, double z);
+
+		// a head shot kills, anything else takes one life
+		void shot(int i, bool headShot);
+		void fired(int i) { m_shots[i]++; }
+		void bulletGone(int i) { m_shots[i]--; }
+		void moveTo(int i, double x, double z) { m_x[i] = x; m_z[i] = z; }
+		// back to a saved state (worldState.h)
+		void restore(int i, double x, double z, int life, int shots, bool alive);
+
+		int size() const { return m_count; }
+		int capacity() const { return m_capacity; }
+
+		bool isAlive(int i) const { return m_alive[i] != 0; }
+		int getLife(int i) const { return m_life[i]; }
+		int getShots(int i) const { return m_shots[i]; }     // bullets of enemy i still in the projectile pool
+		Vec3 getPosition(int i) const { return Vec3(m_x[i], 0.0f, m_z[i]); }
+
+	private:
+		double*				m_x, *m_z;
+		int*				m_life;
+		int*				m_shots;
+		unsigned char*		m_alive;
+		int					m_count;
+		int					m_capacity;
+	};
+}
+
+#endif // __enemyPoolH__
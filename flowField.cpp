@@ -0,0 +1,94 @@
+#include "flowField.h"
+
+namespace sim
+{
+
+void CFlowField::build(const CLevel& level, int range) {
+	clear();
+	if (!level.isOpen()) return;
+	m_range = range;
+	m_cols = level.getCols();
+	m_rows = level.getRows();
+	m_walls.resize((size_t)m_cols * m_rows);
+	for (int row = 0; row < m_rows; row++)
+		for (int col = 0; col < m_cols; col++) m_walls[(size_t)row * m_cols + col] = level.cell(row, col) == CELL_WALL;
+	m_dist.assign((size_t)m_cols * m_rows, -1);
+	m_queue.resize((size_t)m_cols * m_rows);
+}
+
+void CFlowField::clear() {
+	m_cols = m_rows = 0;
+	m_walls.clear();
+	m_dist.clear();
+	m_queue.clear();
+	m_reached = 0;
+	m_targets.clear();
+}
+
+bool CFlowField::update(const int* targetRows, const int* targetCols, int count) {
+	bool same = (int)m_targets.size() == count * 2;
+	for (int t = 0; same && t < count; t++) same = m_targets[t * 2] == targetRows[t] && m_targets[t * 2 + 1] == targetCols[t];
+	if (same) return false;
+	m_targets.resize(count * 2);
+	for (int t = 0; t < count; t++) {
+		m_targets[t * 2] = targetRows[t];
+		m_targets[t * 2 + 1] = targetCols[t];
+	}
+	m_updates++;
+
+	for (int i = 0; i < m_reached; i++) m_dist[m_queue[i]] = -1;
+	m_reached = 0;
+
+	// 4-neighbour BFS from all targets at once; the queue never holds a cell twice, so it
+	// needs no wrap around
+	int head = 0, tail = 0;
+	for (int t = 0; t < count; t++) {
+		if (!isOpen(targetRows[t], targetCols[t])) continue;
+		const int start = targetRows[t] * m_cols + targetCols[t];
+		if (m_dist[start] == 0) continue;
+		m_dist[start] = 0;
+		m_queue[tail++] = start;
+	}
+	while (head < tail) {
+		const int k = m_queue[head++];
+		const int row = k / m_cols, col = k % m_cols;
+		const int d = m_dist[k] + 1;
+		if (m_range > 0 && d > m_range) break;
+		const int nr[4] = { row - 1, row + 1, row, row };
+		const int nc[4] = { col, col, col - 1, col + 1 };
+		for (int i = 0; i < 4; i++) {
+			if (!isOpen(nr[i], nc[i])) continue;
+			const int n = nr[i] * m_cols + nc[i];
+			if (m_dist[n] >= 0) continue;
+			m_dist[n] = d;
+			m_queue[tail++] = n;
+		}
+	}
+	m_reached = tail;
+	return true;
+}
+
+bool CFlowField::next(int row, int col, int& nextRow, int& nextCol) const {
+	int best = getDistance(row, col);
+	if (best <= 0) return false;
+
+	bool found = false;
+	for (int dr = -1; dr <= 1; dr++) {
+		for (int dc = -1; dc <= 1; dc++) {
+			if (dr == 0 && dc == 0) continue;
+			if (dr != 0 && dc != 0 && (!isOpen(row + dr, col) || !isOpen(row, col + dc))) continue;
+			const int d = getDistance(row + dr, col + dc);
+			// a diagonal step covers two BFS steps, so it has to gain at least that much
+			const int gain = best - d;
+			if (d < 0 || gain <= 0 || (dr != 0 && dc != 0 && gain < 2)) continue;
+			if (!found || d < getDistance(nextRow, nextCol)) {
+				nextRow = row + dr;
+				nextCol = col + dc;
+				found = true;
+			}
+		}
+	}
+	return found;
+}
+
+}
@@ -0,0 +1,63 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: flowField.h
+//
+// Desc: One breadth-first distance field over the wall grid towards the nearest of a few
+//       target cells (the players), shared by every enemy. It is recomputed only when a
+//       target changes cell; a chaser then just reads which neighbour of its own cell is
+//       closer. The search can be capped at a number of steps, so on big maps it only
+//       touches the cells near the target and everything further away reads as unreachable.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __flowFieldH__
+#define __flowFieldH__
+
+#include "levelFile.h"
+#include <vector>
+
+namespace sim
+{
+	class CFlowField {
+	public:
+		CFlowField(void) : m_cols(0), m_rows(0), m_range(0), m_reached(0), m_updates(0) {}
+
+		// range: steps the search goes out from the target, 0 for the whole map
+		void build(const CLevel& level, int range = 0);
+		void clear();
+
+		// true when the field had to be recomputed
+		bool update(int targetRow, int targetCol) { return update(&targetRow, &targetCol, 1); }
+		// distances to the closest of count targets; none leaves every cell unreachable
+		bool update(const int* targetRows, const int* targetCols, int count);
+
+		// steps from the cell to the nearest target, -1 for walls and unreachable cells
+		int getDistance(int row, int col) const {
+			if (row < 0 || col < 0 || row >= m_rows || col >= m_cols) return -1;
+			return m_dist[(size_t)row * m_cols + col];
+		}
+		// neighbour one step closer to the target (diagonals only when both sides are open);
+		// false at the target and where the target cannot be reached
+		bool next(int row, int col, int& nextRow, int& nextCol) const;
+
+		long long getUpdates() const { return m_updates; }
+		// cells the last update reached
+		int getReached() const { return m_reached; }
+
+	private:
+		bool isOpen(int row, int col) const {
+			return row >= 0 && col >= 0 && row < m_rows && col < m_cols && !m_walls[(size_t)row * m_cols + col];
+		}
+
+		int							m_cols, m_rows;
+		int							m_range;
+		std::vector<unsigned char>	m_walls;
+		std::vector<int>			m_dist;
+		std::vector<int>			m_queue;        // BFS order of the last update, reset from it next time
+		int							m_reached;
+		std::vector<int>			m_targets;      // row, col of every target of the last update
+		long long					m_updates;
+	};
+}
+
+#endif // __flowFieldH__
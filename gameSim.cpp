@@ -0,0 +1,940 @@
+#include "gameSim.h"
+#include "levelCompiler.h"
+#include "worldState.h"
+#include "profiler.h"
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+namespace sim
+{
+
+// -----------------------------------------------------------------------------
+// Built-in level
+// -----------------------------------------------------------------------------
+
+constexpr char builtin_map[MAP_SIZE][MAP_SIZE + 1] = {
+	"111111111111111111111111111111",
+	"100000000000000000000000000001",
+	"10000000L0000000000000L0000001",
+	"100F000000000000000e0000000001",
+	"10000000000000000000e000000001",
+	"100000000000000000000000000001",
+	"111111111111111111111111000001",
+	"100000000000000000000000000001",
+	"10000L0000000000L0000000000001",
+	"10000000000000000000000000L001",
+	"10000000000000000000e000000001",
+	"100000000e00000000000000000001",
+	"100000111111111110000000000001",
+	"100000100000000000000000000001",
+	"100000100000L0000e000000L00001",
+	"1000e010000e000000000000000001",
+	"100000100000000000000000000001",
+	"100000111111111111111111111111",
+	"100000000000000000000000000001",
+	"100000000L00000000000L00000001",
+	"100000000000000e00000000000001",
+	"1000000000000000000000000e0001",
+	"100000000000000000000000000001",
+	"111111111111111111111111000001",
+	"100000000000000000000000000001",
+	"10000000L000000000L00000000001",
+	"100P00000000000000000000000001",
+	"10000000000000000000000000L001",
+	"100000000000000000000000000001",
+	"111111111111111111111111111111"
+};
+
+// a broken built-in level fails the build; loading it only points the level at this image
+constexpr LevelCounts builtin_counts = countLevel(builtin_map);
+static_assert(builtin_counts.rectangular, "built-in level: every row must be MAP_SIZE cells long");
+static_assert(builtin_counts.players == 1, "built-in level: needs exactly one player start 'P'");
+static_assert(builtin_counts.flags == 1, "built-in level: needs exactly one flag 'F'");
+static_assert(builtin_counts.closed, "built-in level: the border must be wall all the way round");
+static constexpr auto builtin_level = compileLevel<builtin_counts.wall_count, builtin_counts.spawn_count,
+	builtin_counts.light_count>(builtin_map);
+
+// -----------------------------------------------------------------------------
+// enemy boxes
+// -----------------------------------------------------------------------------
+
+CWall enemyBody(double x, double z) {
+	CWall body(ENEMYSIZE, PLAYERHEIGHT * 0.85, ENEMYSIZE);
+	body.setPosition(x - ENEMYSIZE / 2, PLAYERHEIGHT * 0.425, z - ENEMYSIZE / 2);
+	return body;
+}
+
+CWall enemyHead(double x, double z) {
+	CWall head(ENEMYSIZE, PLAYERHEIGHT * 0.3, ENEMYSIZE);
+	head.setPosition(x - ENEMYSIZE / 2, PLAYERHEIGHT, z - ENEMYSIZE / 2);
+	return head;
+}
+
+// -----------------------------------------------------------------------------
+// CWorld
+// -----------------------------------------------------------------------------
+
+CWorld::CWorld(void) {
+	m_cols = m_rows = 0;
+	m_origin_x = m_origin_z = 0;
+	m_players.resize(1);
+	resetPlayer(m_players[0]);
+	m_players[0].pos_x = m_players[0].pos_z = 0;
+	m_players[0].life = 0;
+	m_burst = 1;
+	m_status = GAME_LOST;
+	m_tick = 0;
+	m_broadphase = true;
+	m_continuous = true;
+	m_wallCells = 0;
+	m_mergeWalls = true;
+	m_culling = true;
+	m_useLos = true;
+	m_chase = true;
+	m_hitboxCell = WORLD_SIZE;
+	m_useBatch = true;
+}
+
+bool CWorld::load(void) {
+	m_visibility.clear();
+	if (!m_level.openImage(&builtin_level, (size_t)builtin_level.header.file_size)) return false;
+	return restart();
+}
+
+bool CWorld::load(const char (*rows)[MAP_SIZE + 1]) {
+	std::vector<std::string> lines(rows, rows + MAP_SIZE);
+	m_visibility.clear();
+	if (!m_level.fromRows(lines)) return false;
+	return restart();
+}
+
+bool CWorld::loadFile(const char* path) {
+	m_visibility.clear();
+	if (!m_level.open(path)) return false;
+	return restart();
+}
+
+bool CWorld::restart() {
+	PROFILE_SCOPE("restart");
+	if (!m_level.isOpen()) return false;
+	m_cols = m_level.getCols();
+	m_rows = m_level.getRows();
+	m_origin_x = -m_cols * WORLD_SIZE / 2.0;
+	m_origin_z = m_rows * WORLD_SIZE / 2.0;
+
+	// everything of the previous level goes at once; the counts are known up front, so
+	// each array is taken from the arena exactly once
+	m_walls.release();
+	m_hitboxes.release();
+	m_hitboxOff.release();
+	m_arena.reset();
+	const int spawns = m_level.getSpawnCount();
+	m_walls.allocate(m_arena, m_mergeWalls ? m_level.getWallCount() : m_level.getWallCells());
+	m_enemies.reserve(m_arena, spawns);
+	m_hitboxes.allocate(m_arena, spawns * 2);
+	m_hitboxOff.allocate(m_arena, spawns * 2);
+	m_projectiles.reserve(m_arena, MAX_PLAYERS + spawns * m_burst);
+
+	if (!make_map()) return false;
+	locate_enemy();
+	if (m_culling && !m_visibility.isBuilt()) {
+		PROFILE_SCOPE("pvs build");
+		m_visibility.build(m_level);
+	}
+	m_los.build(m_level);
+	m_flow.build(m_level, CHASE_RANGE);
+
+	m_plane.setSize(WORLD_SIZE * m_cols, 0.5f, WORLD_SIZE * m_rows);
+	m_plane.setPosition(0, 0, 0);
+	m_ceiling.setSize(WORLD_SIZE * m_cols, 0.5f, WORLD_SIZE * m_rows);
+	m_ceiling.setPosition(0, WALL_HEIGHT, 0);
+
+	for (size_t p = 0; p < m_players.size(); p++) {
+		if (m_players[p].active) resetPlayer(m_players[p]);
+	}
+	m_status = GAME_RUNNING;
+	m_tick = 0;
+	return true;
+}
+
+// walls come straight from the level's merged rectangles unless merging is off
+bool CWorld::make_map() {
+	PROFILE_SCOPE("make_map");
+	m_wallCells = m_level.getWallCells();
+	if (m_mergeWalls) {
+		for (int i = 0; i < m_level.getWallCount(); i++) {
+			const LevelRect& r = m_level.getWall(i);
+			if (!m_walls.push_back(CWall(r.cols * WORLD_SIZE, WALL_HEIGHT, r.rows * WORLD_SIZE))) return false;
+			m_walls.back().setPosition(m_origin_x + (r.col + r.cols / 2.0) * WORLD_SIZE, WALL_HEIGHT / 2,
+				m_origin_z - (r.row + r.rows / 2.0) * WORLD_SIZE);
+		}
+	}
+	else {
+		for (int row = 0; row < m_rows; row++) {
+			for (int col = 0; col < m_cols; col++) {
+				if (m_level.cell(row, col) != CELL_WALL) continue;
+				if (!m_walls.push_back(CWall(WORLD_SIZE, WALL_HEIGHT, WORLD_SIZE))) return false;
+				m_walls.back().setPosition(cellX(col), WALL_HEIGHT / 2, cellZ(row));
+			}
+		}
+		// the walls were sized from the header's wall_cells
+		if ((int)m_walls.size() != m_wallCells) return false;
+	}
+
+	m_flag = CWall();
+	if (m_level.hasFlag()) {
+		m_flag.setSize(WORLD_SIZE, WALL_HEIGHT, WORLD_SIZE);
+		m_flag.setPosition(cellX(m_level.getFlagCol()), WALL_HEIGHT / 2, cellZ(m_level.getFlagRow()));
+	}
+	if (!m_level.hasPlayer()) return false;
+
+	m_wallGrid.build(m_walls.data(), (int)m_walls.size(), m_cols, m_rows, m_origin_x, m_origin_z, WORLD_SIZE);
+	return true;
+}
+
+void CWorld::locate_enemy() {
+	PROFILE_SCOPE("locate_enemy");
+	for (int i = 0; i < m_level.getSpawnCount(); i++) {
+		const LevelCell& c = m_level.getSpawn(i);
+		m_enemies.spawn(cellX(c.col), cellZ(c.row));
+		m_hitboxes.push_back(enemyBody(cellX(c.col), cellZ(c.row)));
+		m_hitboxes.push_back(enemyHead(cellX(c.col), cellZ(c.row)));
+	}
+	for (size_t i = 0; i < m_hitboxes.size(); i++) m_hitboxOff.push_back(0);
+
+	// at most 64k grid cells so rebuilding after enemies moved stays cheap
+	int scale = 1;
+	while (((m_cols + scale - 1) / scale) * ((m_rows + scale - 1) / scale) > 65536) scale *= 2;
+	m_hitboxCell = WORLD_SIZE * scale;
+	m_hitboxGrid.build(m_hitboxes.data(), (int)m_hitboxes.size(), (m_cols + scale - 1) / scale, (m_rows + scale - 1) / scale, m_origin_x, m_origin_z, m_hitboxCell);
+}
+
+bool CWorld::goable(double pos_x, double pos_z) const {
+	if (m_level.cell(rowAt(pos_z + 0.2), colAt(pos_x + 0.2)) == CELL_WALL ||
+		m_level.cell(rowAt(pos_z + 0.2), colAt(pos_x - 0.2)) == CELL_WALL ||
+		m_level.cell(rowAt(pos_z - 0.2), colAt(pos_x + 0.2)) == CELL_WALL ||
+		m_level.cell(rowAt(pos_z - 0.2), colAt(pos_x - 0.2)) == CELL_WALL) return false;
+	return true;
+}
+
+bool CWorld::win(int player) const {
+	const double pos_x = m_players[player].pos_x, pos_z = m_players[player].pos_z;
+	if (m_level.cell(rowAt(pos_z + 0.2), colAt(pos_x + 0.2)) == CELL_FLAG ||
+		m_level.cell(rowAt(pos_z + 0.2), colAt(pos_x - 0.2)) == CELL_FLAG ||
+		m_level.cell(rowAt(pos_z - 0.2), colAt(pos_x + 0.2)) == CELL_FLAG ||
+		m_level.cell(rowAt(pos_z - 0.2), colAt(pos_x - 0.2)) == CELL_FLAG) return true;
+	return false;
+}
+
+bool CWorld::hitsWall(const CSphere& ball, CollisionStats& stats) const {
+	if (m_broadphase) return m_wallGrid.hasIntersected(ball, m_walls.data(), stats);
+
+	stats.queries++;
+	bool hit = false;
+	for (size_t k = 0; k < m_walls.size(); k++) {
+		stats.box_tests++;
+		if (m_walls[k].hasIntersected(ball)) hit = true;
+	}
+	return hit;
+}
+
+SweepHit CWorld::sweep(const Vec3& from, const Vec3& to, double radius, bool enemies, bool player, CollisionStats& stats,
+	const HitboxCandidates* candidates) const {
+	SweepHit hit;
+	double t;
+	int index;
+	if (m_wallGrid.sweep(from, to, radius, m_walls.data(), NULL, stats, t, index)) {
+		hit.type = HIT_WALL;
+		hit.index = index;
+		hit.t = t;
+	}
+
+	const CWall* slabs[2] = { &m_plane, &m_ceiling };
+	for (int k = 0; k < 2; k++) {
+		Vec3 p = slabs[k]->getPosition();
+		Vec3 s = slabs[k]->getSize();
+		stats.box_tests++;
+		if (sweepBox(from, to, Vec3(p.x - s.x / 2 - radius, p.y - s.y / 2 - radius, p.z - s.z / 2 - radius),
+			Vec3(p.x + s.x / 2 + radius, p.y + s.y / 2 + radius, p.z + s.z / 2 + radius), t) && t < hit.t) {
+			hit.type = k == 0 ? HIT_FLOOR : HIT_CEILING;
+			hit.index = -1;
+			hit.t = t;
+		}
+	}
+
+	if (enemies && candidates) {
+		// earliest of the pairs, lowest box on a tie, as the grid walk decides
+		double best = 2;
+		int best_index = -1;
+		for (int k = 0; k < candidates->count; k++) {
+			const int box = candidates->hits[k].enemy * 2 + (candidates->hits[k].head ? 1 : 0);
+			if (m_hitboxOff[box]) continue;
+			stats.box_tests++;
+			if (sweepWall(from, to, radius, m_hitboxes[box], t) && (t < best || (t == best && box < best_index))) {
+				best = t;
+				best_index = box;
+			}
+		}
+		if (best_index >= 0 && best < hit.t) {
+			hit.type = (best_index & 1) ? HIT_ENEMY_HEAD : HIT_ENEMY_BODY;
+			hit.index = best_index / 2;
+			hit.t = best;
+		}
+	}
+	else if (enemies && m_hitboxGrid.sweep(from, to, radius, m_hitboxes.data(), m_hitboxOff.data(), stats, t, index) && t < hit.t) {
+		hit.type = (index & 1) ? HIT_ENEMY_HEAD : HIT_ENEMY_BODY;
+		hit.index = index / 2;
+		hit.t = t;
+	}
+
+	// same volume as the discrete test in probe(): the bullet has to be fully between the
+	// floor and eye height. The lowest player wins a tie.
+	if (player) {
+		for (size_t p = 0; p < m_players.size(); p++) {
+			const Player& pl = m_players[p];
+			if (!pl.isPlaying()) continue;
+			stats.box_tests++;
+			if (sweepBox(from, to, Vec3(pl.pos_x - ENEMYSIZE / 2 - radius, radius, pl.pos_z - ENEMYSIZE / 2 - radius),
+				Vec3(pl.pos_x + ENEMYSIZE / 2 + radius, PLAYERHEIGHT - radius, pl.pos_z + ENEMYSIZE / 2 + radius), t) && t < hit.t) {
+				hit.type = HIT_PLAYER;
+				hit.index = (int)p;
+				hit.t = t;
+			}
+		}
+	}
+	return hit;
+}
+
+void CWorld::shootEnemy(int i, bool headShot) {
+	m_enemies.shot(i, headShot);
+	if (!m_enemies.isAlive(i)) m_hitboxOff[i * 2] = m_hitboxOff[i * 2 + 1] = 1;
+}
+
+// a volley of `burst` bullets fanned around the line to the player, when none of the
+// enemy's bullets are in the air
+void CWorld::fireEnemy(int i, int player) {
+	if (m_enemies.getShots(i) > 0) return;
+
+	const Vec3 p = m_enemies.getPosition(i), target = getPlayerPosition(player);
+	double x_power = target.x - p.x;
+	double z_power = target.z - p.z;
+	double distance = sqrt(x_power * x_power + z_power * z_power);
+	x_power /= distance;
+	z_power /= distance;
+
+	for (int k = 0; k < m_burst; k++) {
+		double spread = (k - (m_burst - 1) / 2.0) * 0.05;
+		double c = cos(spread), s = sin(spread);
+		Vec3 velocity(BULLETSPEED * (x_power * c - z_power * s), 0, BULLETSPEED * (z_power * c + x_power * s));
+		if (spawnBullet(Vec3(p.x, PLAYERHEIGHT * 0.75, p.z), velocity, i)) m_enemies.fired(i);
+	}
+}
+
+bool CWorld::spawnBullet(const Vec3& center, const Vec3& velocity, int owner) {
+	return m_projectiles.spawn(center, velocity, owner) >= 0;
+}
+
+void CWorld::retireBullet(int i) {
+	const int owner = m_projectiles.getOwner(i);
+	if (owner < 0) m_players[ownerPlayer(owner)].shots--;
+	else m_enemies.bulletGone(owner);
+	m_projectiles.retire(i);
+}
+
+// carries out what bullet i ran into; true when the bullet is gone
+bool CWorld::applyHit(int i, const SweepHit& hit) {
+	if (hit.type == HIT_NONE) return false;
+	if (hit.type == HIT_ENEMY_HEAD || hit.type == HIT_ENEMY_BODY) shootEnemy(hit.index, hit.type == HIT_ENEMY_HEAD);
+	else if (hit.type == HIT_PLAYER) damagePlayer(hit.index);
+	retireBullet(i);
+	return true;
+}
+
+void CWorld::damagePlayer(int player) {
+	m_players[player].life--;
+	if (m_players[player].life > 0) return;
+	for (size_t p = 0; p < m_players.size(); p++) {
+		if (m_players[p].isPlaying()) return;
+	}
+	m_status = GAME_LOST;
+}
+
+void CWorld::resetPlayer(Player& player) const {
+	player.pos_x = m_level.isOpen() ? cellX(m_level.getPlayerCol()) : 0;
+	player.pos_z = m_level.isOpen() ? cellZ(m_level.getPlayerRow()) : 0;
+	player.target_x = 1.0f;
+	player.target_y = 0.0f;
+	player.target_z = 0.0f;
+	player.life = 3;
+	player.shots = 0;
+	player.active = true;
+}
+
+int CWorld::addPlayer() {
+	int slot = 0;
+	while (slot < (int)m_players.size() && m_players[slot].active) slot++;
+	if (slot >= MAX_PLAYERS) return -1;
+	if (slot == (int)m_players.size()) m_players.push_back(Player());
+	// bullets of whoever had the slot before still count against it until they are gone
+	const int inFlight = m_players[slot].shots;
+	resetPlayer(m_players[slot]);
+	m_players[slot].shots = inFlight;
+	return slot;
+}
+
+// the player's bullets keep flying, they just no longer count against anyone
+void CWorld::removePlayer(int player) {
+	if (player < 0 || player >= (int)m_players.size()) return;
+	m_players[player].active = false;
+	m_players[player].life = 0;
+}
+
+bool CWorld::playerBulletsInFlight() const {
+	for (size_t p = 0; p < m_players.size(); p++) {
+		if (m_players[p].shots > 0) return true;
+	}
+	return false;
+}
+
+void CWorld::look(int player, int h, int v) {
+	if (h == 0 && v == 0) return;
+	Player& pl = m_players[player];
+	double dh = h * 0.001f;		// horizontal
+	double dv = v * 0.001f;		// vertical
+
+	double cos_target = pl.target_x;
+	double sin_target = pl.target_z;
+	double cos_dh = cos(dh * LOOKAROUNDSPEED);
+	double sin_dh = sin(dh * LOOKAROUNDSPEED);
+	pl.target_x = (cos_target * cos_dh - sin_target * sin_dh);
+	pl.target_z = (sin_target * cos_dh + cos_target * sin_dh);
+	double sin_target_up = pl.target_y;
+	double cos_target_up = sqrt(1 - pl.target_y * pl.target_y);
+	double sin_dv_up = sin(dv * LOOKAROUNDSPEED);
+	double cos_dv_up = cos(dv * LOOKAROUNDSPEED);
+	pl.target_y = sin_target_up * cos_dv_up + cos_target_up * sin_dv_up;
+	double target_radius = sqrt(pl.target_x * pl.target_x + pl.target_y * pl.target_y + pl.target_z * pl.target_z);
+	pl.target_x /= target_radius;
+	pl.target_y /= target_radius;
+	pl.target_z /= target_radius;
+}
+
+void CWorld::fire(int player) {
+	Player& pl = m_players[player];
+	if (pl.shots > 0) return;
+	Vec3 center(pl.pos_x + pl.target_x * 0.5, PLAYERHEIGHT + pl.target_y * 0.5, pl.pos_z + pl.target_z * 0.5);
+	Vec3 velocity(pl.target_x * BULLETSPEED, pl.target_y * BULLETSPEED, pl.target_z * BULLETSPEED);
+	if (spawnBullet(center, velocity, playerOwner(player))) pl.shots++;
+}
+
+void CWorld::walk(int player, const Input& input, double timeDelta) {
+	Player& pl = m_players[player];
+	double radius = sqrt(pl.target_x * pl.target_x + pl.target_z * pl.target_z);
+	double next_x = 0;
+	double next_z = 0;
+	if (input.forward) {
+		next_x += pl.target_x / radius;
+		next_z += pl.target_z / radius;
+	}
+	if (input.back) {
+		next_x -= pl.target_x / radius;
+		next_z -= pl.target_z / radius;
+	}
+	if (input.left) {
+		next_x -= pl.target_z / radius;
+		next_z += pl.target_x / radius;
+	}
+	if (input.right) {
+		next_x += pl.target_z / radius;
+		next_z -= pl.target_x / radius;
+	}
+
+	double next_radius = sqrt(next_x * next_x + next_z * next_z);
+	if (next_radius == 0) return;
+	next_x *= WALKSPEED * timeDelta / next_radius;
+	next_z *= WALKSPEED * timeDelta / next_radius;
+	if (goable(pl.pos_x + next_x, pl.pos_z + next_z)) {
+		pl.pos_x += next_x;
+		pl.pos_z += next_z;
+	}
+}
+
+// one fixed step of gameplay, timeDelta seconds long. inputs[p] is player p's; players
+// past count stand still. Players act in slot order, so the same inputs give the same
+// match whoever joined first.
+void CWorld::tick(double timeDelta, const Input* inputs, int count) {
+	PROFILE_SCOPE("tick");
+	if (m_status != GAME_RUNNING) return;
+	m_tick++;
+
+	const Input idle;
+	const int players = (int)m_players.size();
+	for (int p = 0; p < players; p++) {
+		if (!m_players[p].isPlaying()) continue;
+		const Input& input = p < count ? inputs[p] : idle;
+		look(p, input.look_h, input.look_v);
+		if (input.fire) fire(p);
+	}
+	if (m_chase) chase(timeDelta);
+
+	if (m_continuous) {
+		updateEnemies();
+		collideBullets(timeDelta);
+	}
+	else {
+		collideBullets(timeDelta);
+		if (m_status == GAME_LOST) return;
+		updateEnemies();
+	}
+	if (m_status == GAME_LOST) return;
+	{
+		PROFILE_SCOPE("integrate");
+		m_projectiles.integrate(timeDelta);
+	}
+
+	for (int p = 0; p < players; p++) {
+		if (m_players[p].isPlaying() && win(p)) {
+			m_status = GAME_WON;
+			return;
+		}
+	}
+
+	PROFILE_SCOPE("walk");
+	for (int p = 0; p < players; p++) {
+		if (m_players[p].isPlaying()) walk(p, p < count ? inputs[p] : idle, timeDelta);
+	}
+}
+
+// every live enemy steps towards the centre of the next cell on the flow field, stopping
+// next to the nearest player; the same wall test as the player's keeps them off the walls.
+// Each enemy only writes its own position and hitboxes, so the enemies are split over the jobs.
+void CWorld::chase(double timeDelta) {
+	PROFILE_SCOPE("chase");
+	{
+		PROFILE_SCOPE("flow field");
+		m_targetRows.clear();
+		m_targetCols.clear();
+		for (size_t p = 0; p < m_players.size(); p++) {
+			if (!m_players[p].isPlaying()) continue;
+			m_targetRows.push_back(rowAt(m_players[p].pos_z));
+			m_targetCols.push_back(colAt(m_players[p].pos_x));
+		}
+		m_flow.update(m_targetRows.data(), m_targetCols.data(), (int)m_targetRows.size());
+	}
+
+	const int n = m_enemies.size();
+	const double step = ENEMYSPEED * timeDelta;
+	prepareChunks(n, ENEMY_GRAIN);
+	auto walk = [this, step](int chunk, int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			if (!m_enemies.isAlive(i)) continue;
+			const Vec3 p = m_enemies.getPosition(i);
+			const int row = rowAt(p.z), col = colAt(p.x);
+			int next_row, next_col;
+			if (m_flow.getDistance(row, col) <= 1 || !m_flow.next(row, col, next_row, next_col)) continue;
+
+			double dx = cellX(next_col) - p.x, dz = cellZ(next_row) - p.z;
+			const double length = sqrt(dx * dx + dz * dz);
+			if (length > step) {
+				dx *= step / length;
+				dz *= step / length;
+			}
+			if (!goable(p.x + dx, p.z + dz)) continue;
+			m_enemies.moveTo(i, p.x + dx, p.z + dz);
+			// the grid only holds indices, it needs a rebuild once a box covers other cells
+			const CWall body = enemyBody(p.x + dx, p.z + dz), head = enemyHead(p.x + dx, p.z + dz);
+			if (!m_hitboxGrid.sameCells(m_hitboxes[i * 2], body) ||
+				!m_hitboxGrid.sameCells(m_hitboxes[i * 2 + 1], head)) m_chunks[chunk].regrid = true;
+			m_hitboxes[i * 2] = body;
+			m_hitboxes[i * 2 + 1] = head;
+		}
+	};
+	m_jobs.parallelFor(n, ENEMY_GRAIN, walk);
+
+	bool regrid = false;
+	for (int c = 0; c < CJobSystem::chunksFor(n, ENEMY_GRAIN); c++) regrid = regrid || m_chunks[c].regrid;
+	if (regrid) {
+		m_hitboxGrid.build(m_hitboxes.data(), (int)m_hitboxes.size(), m_hitboxGrid.getCols(), m_hitboxGrid.getRows(), m_origin_x, m_origin_z, m_hitboxCell);
+	}
+}
+
+// read phase, in parallel: each enemy aims at the nearest player, the PVS rejects enemies
+// cheaply, the line of sight decides for the rest (dead or culled enemies go in as an empty
+// query), and each job lists the enemies that get to fire. Write phase: the lists are walked in chunk order, so bullets enter the
+// pool in enemy order whatever the thread count.
+void CWorld::updateEnemies() {
+	PROFILE_SCOPE("enemies");
+	const int n = m_enemies.size();
+	m_losVisible.assign(n, 1);
+	m_losQueries.resize(n);
+	if (m_useLos) m_los.reserve(n);
+	prepareChunks(n, ENEMY_GRAIN);
+	m_enemyTarget.assign(n, -1);
+	auto read = [this](int chunk, int begin, int end) {
+		ChunkEvents& events = m_chunks[chunk];
+		for (int i = begin; i < end; i++) {
+			LosQuery& q = m_losQueries[i];
+			q.to_row = q.to_col = -1;
+			q.from_row = q.from_col = -1;
+			if (!m_enemies.isAlive(i)) continue;
+			const Vec3 p = m_enemies.getPosition(i);
+			const int target = nearestPlayer(p);
+			if (target < 0) continue;
+			const Vec3 player = getPlayerPosition(target);
+			q.to_row = rowAt(player.z);
+			q.to_col = colAt(player.x);
+			m_enemyTarget[i] = target;
+			// the PVS holds every pair the line of sight can see, so it only skips rays that
+			// would fail; without the line of sight it decides nothing
+			if (m_culling && m_useLos && !isPotentiallyVisible(player, p)) continue;
+			q.from_row = rowAt(p.z);
+			q.from_col = colAt(p.x);
+		}
+		if (m_useLos) m_los.query(&m_losQueries[0], begin, end - begin, &m_losVisible[0], events.los);
+		for (int i = begin; i < end; i++) {
+			if (m_losQueries[i].from_row >= 0 && m_losVisible[i]) events.fire.push_back(i);
+		}
+	};
+	m_jobs.parallelFor(n, ENEMY_GRAIN, read);
+
+	for (int c = 0; c < CJobSystem::chunksFor(n, ENEMY_GRAIN); c++) {
+		const ChunkEvents& events = m_chunks[c];
+		m_los.addStats(events.los);
+		for (size_t k = 0; k < events.fire.size(); k++) {
+			const int i = events.fire[k];
+			fireEnemy(i, m_enemyTarget[i]);
+		}
+	}
+}
+
+// ties go to the lower slot; -1 when nobody is playing
+int CWorld::nearestPlayer(const Vec3& p) const {
+	int best = -1;
+	double best_d = 0;
+	for (size_t k = 0; k < m_players.size(); k++) {
+		if (!m_players[k].isPlaying()) continue;
+		const double dx = m_players[k].pos_x - p.x, dz = m_players[k].pos_z - p.z;
+		const double d = dx * dx + dz * dz;
+		if (best < 0 || d < best_d) {
+			best = (int)k;
+			best_d = d;
+		}
+	}
+	return best;
+}
+
+bool CWorld::isPotentiallyVisible(const Vec3& from, const Vec3& p) const {
+	if (!m_visibility.isBuilt()) return true;
+	return m_visibility.isCellVisible(rowAt(from.z), colAt(from.x), rowAt(p.z), colAt(p.x));
+}
+
+// what a bullet touches where it is now: floor, ceiling and walls for everybody, enemy
+// hitboxes for the players' bullets and the players for the enemies' bullets
+SweepHit CWorld::probe(const CSphere& ball, int owner, CollisionStats& stats, const HitboxCandidates* candidates) const {
+	SweepHit hit;
+	hit.t = 0;
+	stats.box_tests += 2;
+	if (m_plane.hasIntersected(ball)) hit.type = HIT_FLOOR;
+	else if (m_ceiling.hasIntersected(ball)) hit.type = HIT_CEILING;
+	else if (hitsWall(ball, stats)) hit.type = HIT_WALL;
+	else if (owner < 0) {
+		int k = -1;
+		if (candidates) {
+			// the pairs come in box order, so the first real touch is the lowest box
+			for (int c = 0; c < candidates->count && k < 0; c++) {
+				const int box = candidates->hits[c].enemy * 2 + (candidates->hits[c].head ? 1 : 0);
+				if (m_hitboxOff[box]) continue;
+				stats.box_tests++;
+				if (m_hitboxes[box].hasIntersected(ball)) k = box;
+			}
+		}
+		else k = m_hitboxGrid.firstIntersected(ball, m_hitboxes.data(), m_hitboxOff.data(), stats);
+		if (k >= 0) {
+			hit.type = (k & 1) ? HIT_ENEMY_HEAD : HIT_ENEMY_BODY;
+			hit.index = k / 2;
+		}
+	}
+	else {
+		Vec3 c = ball.getCenter();
+		double r = ball.getRadius();
+		for (size_t p = 0; p < m_players.size(); p++) {
+			const Player& pl = m_players[p];
+			if (!pl.isPlaying()) continue;
+			stats.box_tests++;
+			if (c.z + r > pl.pos_z - ENEMYSIZE / 2 &&
+				c.z - r < pl.pos_z + ENEMYSIZE / 2 &&
+				c.y + r < PLAYERHEIGHT &&
+				c.y - r > 0 &&
+				c.x + r > pl.pos_x - ENEMYSIZE / 2 &&
+				c.x - r < pl.pos_x + ENEMYSIZE / 2) {
+				hit.type = HIT_PLAYER;
+				hit.index = (int)p;
+				break;
+			}
+		}
+	}
+	return hit;
+}
+
+// what bullet i runs into this step: the discrete test only looks where the bullet is and
+// lets fast bullets skip over thin objects, the swept test follows it along the whole step
+SweepHit CWorld::bulletHit(int i, double timeDelta, CollisionStats& stats, const HitboxCandidates* candidates) const {
+	const int owner = m_projectiles.getOwner(i);
+	const Vec3 from = m_projectiles.getCenter(i);
+	if (!m_continuous) {
+		CSphere ball;
+		ball.setCenter(from.x, from.y, from.z);
+		return probe(ball, owner, stats, candidates);
+	}
+	const Vec3 v = m_projectiles.getVelocity(i);
+	const Vec3 to(from.x + v.x * timeDelta, from.y + v.y * timeDelta, from.z + v.z * timeDelta);
+	return sweep(from, to, M_RADIUS, owner < 0, owner >= 0, stats, candidates);
+}
+
+// what bullet i can touch this step: the ball where it is, or the box its step sweeps
+HitboxQuery CWorld::bulletQuery(int i, double timeDelta) const {
+	const Vec3 from = m_projectiles.getCenter(i);
+	Vec3 to = from;
+	if (m_continuous) {
+		const Vec3 v = m_projectiles.getVelocity(i);
+		to = Vec3(from.x + v.x * timeDelta, from.y + v.y * timeDelta, from.z + v.z * timeDelta);
+	}
+	HitboxQuery q;
+	q.lo[0] = (float)((from.x < to.x ? from.x : to.x) - M_RADIUS);	q.hi[0] = (float)((from.x < to.x ? to.x : from.x) + M_RADIUS);
+	q.lo[1] = (float)((from.y < to.y ? from.y : to.y) - M_RADIUS);	q.hi[1] = (float)((from.y < to.y ? to.y : from.y) + M_RADIUS);
+	q.lo[2] = (float)((from.z < to.z ? from.z : to.z) - M_RADIUS);	q.hi[2] = (float)((from.z < to.z ? to.z : from.z) + M_RADIUS);
+	q.projectile = i;
+	return q;
+}
+
+// read phase: every bullet is tested against the world as it was before any of them hit,
+// in parallel. Write phase: the hits are carried out one bullet at a time in pool order, as
+// the serial loop did; the only earlier hit that can change a later answer is a kill, so a
+// bullet whose precomputed hit is an enemy killed in this pass is tested again.
+void CWorld::collideBullets(double timeDelta) {
+	PROFILE_SCOPE("bullets");
+	const int n = m_projectiles.size();
+	m_bulletHits.resize(n);
+	prepareChunks(n, BULLET_GRAIN);
+	const bool batch = m_useBatch && playerBulletsInFlight() && (int)m_hitboxes.size() <= HITBOX_BATCH_MAX;
+	if (batch) m_hitboxBatch.build(m_hitboxes.data(), m_hitboxOff.data(), (int)m_hitboxes.size());
+	auto read = [this, timeDelta, batch](int chunk, int begin, int end) {
+		ChunkEvents& events = m_chunks[chunk];
+		CollisionStats& stats = events.stats;
+		if (batch) {
+			// the chunk's player bullets against every live hitbox at once; the pairs come
+			// back in bullet order
+			events.queries.clear();
+			events.hits.clear();
+			for (int i = begin; i < end; i++) {
+				if (m_projectiles.getAge(i) < BULLETLIFETIME && m_projectiles.getOwner(i) < 0) events.queries.push_back(bulletQuery(i, timeDelta));
+			}
+			m_hitboxBatch.overlaps(events.queries.data(), (int)events.queries.size(), events.hits);
+			stats.box_tests += events.queries.size() * m_hitboxBatch.size();
+		}
+		size_t next = 0;
+		for (int i = begin; i < end; i++) {
+			if (m_projectiles.getAge(i) >= BULLETLIFETIME) continue;
+			if (!batch || m_projectiles.getOwner(i) >= 0) {
+				m_bulletHits[i] = bulletHit(i, timeDelta, stats);
+				continue;
+			}
+			HitboxCandidates candidates;
+			candidates.hits = events.hits.data() + next;
+			candidates.count = 0;
+			for (; next < events.hits.size() && events.hits[next].projectile == i; next++) candidates.count++;
+			m_bulletHits[i] = bulletHit(i, timeDelta, stats, &candidates);
+		}
+	};
+	m_jobs.parallelFor(n, BULLET_GRAIN, read);
+	for (int c = 0; c < CJobSystem::chunksFor(n, BULLET_GRAIN); c++) m_stats.add(m_chunks[c].stats);
+
+	m_bulletSlot.resize(n);
+	for (int i = 0; i < n; i++) m_bulletSlot[i] = i;
+	for (int i = 0; i < m_projectiles.size(); ) {
+		// retiring moves the last bullet into slot i
+		const int last = m_bulletSlot[m_projectiles.size() - 1];
+		const int owner = m_projectiles.getOwner(i);
+		if (m_projectiles.getAge(i) >= BULLETLIFETIME || (owner >= 0 && !m_enemies.isAlive(owner))) {
+			retireBullet(i);
+			m_bulletSlot[i] = last;
+			continue;
+		}
+		SweepHit hit = m_bulletHits[m_bulletSlot[i]];
+		// a target taken out earlier in this pass no longer stops the bullet; look again
+		if ((hit.type == HIT_ENEMY_HEAD || hit.type == HIT_ENEMY_BODY) && m_hitboxOff[hit.index * 2]) hit = bulletHit(i, timeDelta, m_stats);
+		else if (hit.type == HIT_PLAYER && !m_players[hit.index].isPlaying()) hit = bulletHit(i, timeDelta, m_stats);
+		if (applyHit(i, hit)) {
+			m_bulletSlot[i] = last;
+			if (m_status == GAME_LOST) return;
+			continue;
+		}
+		i++;
+	}
+}
+
+// one result buffer per chunk, cleared but not freed between passes
+void CWorld::prepareChunks(int count, int grain) {
+	const int chunks = CJobSystem::chunksFor(count, grain);
+	if ((int)m_chunks.size() < chunks) m_chunks.resize(chunks);
+	for (int c = 0; c < chunks; c++) {
+		m_chunks[c].fire.clear();
+		m_chunks[c].los.reset();
+		m_chunks[c].stats.reset();
+		m_chunks[c].regrid = false;
+	}
+}
+
+// FNV-1a over the raw bytes of everything that moves or counts down
+unsigned long long CWorld::getStateHash() const {
+	unsigned long long h = 14695981039346656037ULL;
+	auto mix = [&h](const void* data, size_t size) {
+		const unsigned char* p = (const unsigned char*)data;
+		for (size_t k = 0; k < size; k++) {
+			h ^= p[k];
+			h *= 1099511628211ULL;
+		}
+	};
+	const int status = (int)m_status;
+	mix(&m_tick, sizeof(m_tick));
+	mix(&status, sizeof(status));
+	for (size_t p = 0; p < m_players.size(); p++) {
+		const Player& pl = m_players[p];
+		mix(&pl.pos_x, sizeof(pl.pos_x));
+		mix(&pl.pos_z, sizeof(pl.pos_z));
+		// where the next shot goes
+		mix(&pl.target_x, sizeof(pl.target_x));
+		mix(&pl.target_y, sizeof(pl.target_y));
+		mix(&pl.target_z, sizeof(pl.target_z));
+		mix(&pl.life, sizeof(pl.life));
+		mix(&pl.shots, sizeof(pl.shots));
+	}
+	for (int i = 0; i < m_enemies.size(); i++) {
+		const Vec3 p = m_enemies.getPosition(i);
+		const int life = m_enemies.getLife(i), shots = m_enemies.getShots(i), alive = m_enemies.isAlive(i);
+		mix(&p.x, sizeof(p.x));
+		mix(&p.z, sizeof(p.z));
+		mix(&life, sizeof(life));
+		mix(&shots, sizeof(shots));
+		mix(&alive, sizeof(alive));
+	}
+	for (int i = 0; i < m_projectiles.size(); i++) {
+		const Vec3 c = m_projectiles.getCenter(i), v = m_projectiles.getVelocity(i);
+		const int owner = m_projectiles.getOwner(i);
+		const double age = m_projectiles.getAge(i);     // when it retires
+		mix(&c, sizeof(c));
+		mix(&v, sizeof(v));
+		mix(&age, sizeof(age));
+		mix(&owner, sizeof(owner));
+	}
+	return h;
+}
+
+void CWorld::saveState(std::vector<unsigned char>& out) const {
+	PROFILE_SCOPE("save state");
+	WorldStateHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, WORLD_STATE_MAGIC, 4);
+	h.version = WORLD_STATE_VERSION;
+	h.cols = (uint32_t)m_cols;
+	h.rows = (uint32_t)m_rows;
+	h.wall_count = (uint32_t)m_walls.size();
+	h.spawn_count = m_level.isOpen() ? (uint32_t)m_level.getSpawnCount() : 0;
+	h.player_count = (uint32_t)m_players.size();
+	h.enemy_count = (uint32_t)m_enemies.size();
+	h.bullet_count = (uint32_t)m_projectiles.size();
+	h.status = (int32_t)m_status;
+	h.tick = m_tick;
+	h.size = sizeof(h) + h.player_count * sizeof(PlayerRecord) + h.enemy_count * sizeof(EnemyRecord) +
+		CProjectilePool::stateBytes(m_projectiles.size());
+
+	out.resize((size_t)h.size);
+	unsigned char* p = out.data();
+	memcpy(p, &h, sizeof(h));
+	p += sizeof(h);
+	for (size_t i = 0; i < m_players.size(); i++, p += sizeof(PlayerRecord)) {
+		const Player& pl = m_players[i];
+		PlayerRecord r = { pl.pos_x, pl.pos_z, pl.target_x, pl.target_y, pl.target_z, pl.life, pl.shots, pl.active, 0 };
+		memcpy(p, &r, sizeof(r));
+	}
+	for (int i = 0; i < m_enemies.size(); i++, p += sizeof(EnemyRecord)) {
+		const Vec3 c = m_enemies.getPosition(i);
+		EnemyRecord r = { c.x, c.z, m_enemies.getLife(i), m_enemies.getShots(i), m_enemies.isAlive(i), 0 };
+		memcpy(p, &r, sizeof(r));
+	}
+	m_projectiles.save(p);
+}
+
+// everything is checked before anything is written. The hitboxes and their grid follow
+// from the enemies (the grid is only rebuilt when a box changed cells), the flow field
+// and the sight cache only depend on the level.
+bool CWorld::loadState(const void* data, size_t size) {
+	PROFILE_SCOPE("load state");
+	WorldStateHeader h;
+	if (!m_level.isOpen() || size < sizeof(h)) return false;
+	memcpy(&h, data, sizeof(h));
+	if (memcmp(h.magic, WORLD_STATE_MAGIC, 4) != 0 || h.version != WORLD_STATE_VERSION || h.size != size) return false;
+	if (h.cols != (uint32_t)m_cols || h.rows != (uint32_t)m_rows || h.wall_count != (uint32_t)m_walls.size() ||
+		h.spawn_count != (uint32_t)m_level.getSpawnCount() || h.enemy_count != (uint32_t)m_enemies.size()) return false;
+	if (h.player_count == 0 || h.player_count > MAX_PLAYERS || h.bullet_count > (uint32_t)m_projectiles.capacity()) return false;
+	if (h.status < GAME_RUNNING || h.status > GAME_LOST) return false;
+	if (size != sizeof(h) + h.player_count * sizeof(PlayerRecord) + h.enemy_count * sizeof(EnemyRecord) +
+		CProjectilePool::stateBytes((int)h.bullet_count)) return false;
+
+	// every bullet belongs to a player or enemy of the state, and each shots count is
+	// exactly the bullets its owner has in the air; retireBullet() relies on both
+	const unsigned char* records = (const unsigned char*)data + sizeof(h);
+	const unsigned char* owners = records + h.player_count * sizeof(PlayerRecord) + h.enemy_count * sizeof(EnemyRecord) +
+		CProjectilePool::ownersOffset((int)h.bullet_count);
+	std::vector<int> inFlight(h.player_count + h.enemy_count, 0);     // players, then enemies
+	for (uint32_t k = 0; k < h.bullet_count; k++) {
+		int32_t owner;
+		memcpy(&owner, owners + k * sizeof(owner), sizeof(owner));
+		if (owner < 0 && ownerPlayer(owner) < (int)h.player_count) inFlight[ownerPlayer(owner)]++;
+		else if (owner >= 0 && owner < (int)h.enemy_count) inFlight[h.player_count + owner]++;
+		else return false;
+	}
+	for (uint32_t i = 0; i < h.player_count + h.enemy_count; i++) {
+		int32_t shots;
+		if (i < h.player_count) memcpy(&shots, records + i * sizeof(PlayerRecord) + offsetof(PlayerRecord, shots), sizeof(shots));
+		else memcpy(&shots, records + h.player_count * sizeof(PlayerRecord) + (i - h.player_count) * sizeof(EnemyRecord) +
+			offsetof(EnemyRecord, shots), sizeof(shots));
+		if (shots != inFlight[i]) return false;
+	}
+
+	const unsigned char* p = records;
+	m_players.resize(h.player_count);
+	for (size_t i = 0; i < m_players.size(); i++, p += sizeof(PlayerRecord)) {
+		PlayerRecord r;
+		memcpy(&r, p, sizeof(r));
+		Player& pl = m_players[i];
+		pl.pos_x = r.pos_x;
+		pl.pos_z = r.pos_z;
+		pl.target_x = r.target_x;
+		pl.target_y = r.target_y;
+		pl.target_z = r.target_z;
+		pl.life = r.life;
+		pl.shots = r.shots;
+		pl.active = r.active != 0;
+	}
+	bool regrid = false;
+	for (int i = 0; i < m_enemies.size(); i++, p += sizeof(EnemyRecord)) {
+		EnemyRecord r;
+		memcpy(&r, p, sizeof(r));
+		m_enemies.restore(i, r.pos_x, r.pos_z, r.life, r.shots, r.alive != 0);
+		const CWall body = enemyBody(r.pos_x, r.pos_z), head = enemyHead(r.pos_x, r.pos_z);
+		if (!m_hitboxGrid.sameCells(m_hitboxes[i * 2], body) ||
+			!m_hitboxGrid.sameCells(m_hitboxes[i * 2 + 1], head)) regrid = true;
+		m_hitboxes[i * 2] = body;
+		m_hitboxes[i * 2 + 1] = head;
+		m_hitboxOff[i * 2] = m_hitboxOff[i * 2 + 1] = m_enemies.isAlive(i) ? 0 : 1;
+	}
+	m_projectiles.load(p, (int)h.bullet_count);
+	if (regrid) m_hitboxGrid.build(m_hitboxes.data(), (int)m_hitboxes.size(), m_hitboxGrid.getCols(), m_hitboxGrid.getRows(), m_origin_x, m_origin_z, m_hitboxCell);
+	m_status = (GameStatus)h.status;
+	m_tick = (unsigned long)h.tick;
+	return true;
+}
+
+}
@@ -0,0 +1,318 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: gameSim.h
+//
+// Desc: Renderer independent game simulation (map, player, enemies, bullets, collision,
+//       win/lose). Nothing in here may include d3dx9.h, so the same code runs inside the
+//       Direct3D client and in the headless runner.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __gameSimH__
+#define __gameSimH__
+
+#include "simShapes.h"
+#include "arena.h"
+#include "collisionGrid.h"
+#include "hitboxBatch.h"
+#include "projectilePool.h"
+#include "enemyPool.h"
+#include "levelFile.h"
+#include "visibility.h"
+#include "lineOfSight.h"
+#include "flowField.h"
+#include "jobSystem.h"
+#include <cmath>
+#include <vector>
+
+#define PLAYERHEIGHT 2.0f
+#define ENEMYSIZE 0.6f
+#define WALKSPEED 0.9f       // world units per second
+#define LOOKAROUNDSPEED 0.3f
+#define MAP_SIZE 30          // size of the built-in level; loaded levels bring their own
+#define WORLD_SIZE 2
+#define WALL_HEIGHT 6
+#define BULLETSPEED 400.0f
+#define ENEMYSPEED 2.0f      // world units per second while chasing
+#define CHASE_RANGE 48       // cells of walking distance from which enemies start chasing
+#define BULLETLIFETIME 3.0f   // seconds before a bullet that hit nothing is dropped
+#define ENEMY_GRAIN 256       // enemies per job of the parallel enemy update
+#define BULLET_GRAIN 256      // bullets per job of the parallel collision pass
+#define HITBOX_BATCH_MAX 256  // hitboxes up to which a batch test of all of them beats the grid
+#define MAX_PLAYERS 32        // players in one match, the local one included
+
+namespace sim
+{
+	class CWorld;
+
+	enum HitType { HIT_NONE, HIT_WALL, HIT_FLOOR, HIT_CEILING, HIT_ENEMY_HEAD, HIT_ENEMY_BODY, HIT_PLAYER };
+
+	// result of a continuous query: what was touched first and when (0..1 along the step)
+	struct SweepHit
+	{
+		SweepHit() : type(HIT_NONE), index(-1), t(1) {}
+
+		HitType type;
+		int index;      // wall or enemy index
+		double t;
+	};
+
+	// the pairs the hitbox batch found for one bullet
+	struct HitboxCandidates
+	{
+		const HitboxHit* hits;
+		int count;
+	};
+
+	// the boxes an enemy standing at (x, z) is hit in; the enemy state itself is in CEnemyPool
+	CWall enemyBody(double x, double z);
+	CWall enemyHead(double x, double z);
+
+	// -----------------------------------------------------------------------------
+	// Input : everything the player did during one tick
+	// -----------------------------------------------------------------------------
+
+	struct Input
+	{
+		Input() : forward(false), back(false), left(false), right(false), fire(false), look_h(0), look_v(0) {}
+
+		bool forward, back, left, right;
+		bool fire;
+		int look_h, look_v;     // mouse delta in pixels, positive = left / up
+	};
+
+	enum GameStatus { GAME_RUNNING, GAME_WON, GAME_LOST };
+
+	// -----------------------------------------------------------------------------
+	// Player : one person in the match; slot 0 is the local player
+	// -----------------------------------------------------------------------------
+
+	struct Player
+	{
+		double pos_x, pos_z;
+		double target_x, target_y, target_z;    // unit look direction
+		int life;       // out of the match at 0
+		int shots;      // this player's bullets in the pool
+		bool active;    // false for a slot given back with removePlayer()
+
+		bool isPlaying() const { return active && life > 0; }
+	};
+
+	// -----------------------------------------------------------------------------
+	// CWorld : owns the level and every moving object
+	// -----------------------------------------------------------------------------
+
+	class CWorld {
+	public:
+		CWorld(void);
+
+		// builds the level from MAP_SIZE rows of MAP_SIZE characters
+		// ('1' wall, 'e' enemy, 'F' flag, 'P' player start)
+		bool load(const char (*rows)[MAP_SIZE + 1]);
+		bool load(void);
+		// maps a binary level (levelFile.h) of any size
+		bool loadFile(const char* path);
+		// starts the current level over
+		bool restart();
+
+		void tick(double timeDelta, const Input& input) { tick(timeDelta, &input, 1); }
+		// one input per player slot; slots from count on stand still
+		void tick(double timeDelta, const Input* inputs, int count);
+
+		bool goable(double pos_x, double pos_z) const;
+		bool win(int player = 0) const;
+		void damagePlayer(int player = 0);
+
+		// more players for a hosted match. A new one takes the lowest free slot and starts
+		// at the level's player start; -1 when MAX_PLAYERS are in. The match is won when
+		// anyone reaches the flag and lost when everybody in it is out.
+		int addPlayer();
+		void removePlayer(int player);
+		// slots, including ones given back
+		int getPlayerCount() const { return (int)m_players.size(); }
+		const Player& getPlayer(int player) const { return m_players[player]; }
+		Vec3 getPlayerPosition(int player) const { return Vec3(m_players[player].pos_x, PLAYERHEIGHT, m_players[player].pos_z); }
+
+		// true when the bullet touches any map wall; uses the grid unless the broadphase is off
+		bool hitsWall(const CSphere& ball) { return hitsWall(ball, m_stats); }
+		void setBroadphase(bool enable) { m_broadphase = enable; }
+		bool getBroadphase() const { return m_broadphase; }
+		const CollisionStats& getStats() const { return m_stats; }
+		void resetStats() { m_stats.reset(); }
+
+		// greedy merge of wall cells into maximal boxes (default); takes effect on the next load()
+		void setMergeWalls(bool enable) { m_mergeWalls = enable; }
+		bool getMergeWalls() const { return m_mergeWalls; }
+		// '1' cells in the loaded map, against getWalls().size() boxes after merging
+		int getWallCells() const { return m_wallCells; }
+
+		// potentially visible sets: enemies the player cannot possibly see skip the line of sight
+		// and hidden geometry is not drawn (default on); the sets are computed when a level is loaded
+		void setCulling(bool enable) { m_culling = enable; }
+		bool getCulling() const { return m_culling; }
+		const CVisibility& getVisibility() const { return m_visibility; }
+		// false only when the PVS proves nothing at p can be seen from the player's cell
+		bool isPotentiallyVisible(const Vec3& p) const { return isPotentiallyVisible(getPlayerPosition(), p); }
+		// the same from any eye position; only reads what the level load built
+		bool isPotentiallyVisible(const Vec3& from, const Vec3& p) const;
+
+		// enemies only fire when a ray over the wall grid reaches the player's cell (default on)
+		void setLineOfSight(bool enable) { m_useLos = enable; }
+		bool getLineOfSight() const { return m_useLos; }
+		CLineOfSight& getLineOfSightService() { return m_los; }
+		const LosStats& getLosStats() const { return m_los.getStats(); }
+
+		// enemies walk towards the player along a shared flow field (default on)
+		void setChase(bool enable) { m_chase = enable; }
+		bool getChase() const { return m_chase; }
+		const CFlowField& getFlowField() const { return m_flow; }
+
+		// first thing a sphere moving from -> to touches: walls, floor and ceiling always,
+		// live enemy hitboxes and the player on request
+		SweepHit sweep(const Vec3& from, const Vec3& to, double radius, bool enemies, bool player) {
+			return sweep(from, to, radius, enemies, player, m_stats);
+		}
+		// continuous (swept) bullet collision instead of testing only the end position (default);
+		// the discrete test lets bullets tunnel through walls once they move more than a cell per tick
+		void setContinuous(bool enable) { m_continuous = enable; }
+		bool getContinuous() const { return m_continuous; }
+		// bullets per enemy volley (bullet-heavy modes); takes effect on the next load()
+		void setEnemyBurst(int burst) { m_burst = burst < 1 ? 1 : burst; }
+		int getEnemyBurst() const { return m_burst; }
+		// player bullets test every live enemy hitbox in one SIMD batch instead of walking the
+		// hitbox grid while the level has at most HITBOX_BATCH_MAX of them (default on);
+		// both give the same hits
+		void setHitboxBatch(bool enable) { m_useBatch = enable; }
+		bool getHitboxBatch() const { return m_useBatch; }
+		// spawns a bullet into the pool; false when the pool is full
+		bool spawnBullet(const Vec3& center, const Vec3& velocity, int owner);
+
+		// threads for the enemy update and the bullet collision, 0 for one per core (default 1);
+		// every thread count gives the same results as the single threaded run
+		void setThreads(int threads) { m_jobs.start(threads); }
+		int getThreads() const { return m_jobs.getThreads(); }
+		const CJobSystem& getJobSystem() const { return m_jobs; }
+		// FNV-1a over the player, enemies and bullets, to compare runs
+		unsigned long long getStateHash() const;
+		// everything getStateHash() covers as a binary state (worldState.h); out is reused,
+		// so saving every tick does not allocate
+		void saveState(std::vector<unsigned char>& out) const;
+		// false, with the world unchanged, for a malformed state or one of another level
+		bool loadState(const void* data, size_t size);
+
+		GameStatus getStatus() const { return m_status; }
+		unsigned long getTick() const { return m_tick; }
+
+		// the local player
+		Vec3 getPlayerPosition(void) const { return getPlayerPosition(0); }
+		Vec3 getLookDirection(void) const { return Vec3(m_players[0].target_x, m_players[0].target_y, m_players[0].target_z); }
+		int getLife() const { return m_players[0].life; }
+		bool isShooting() const { return m_players[0].shots > 0; }
+		const CProjectilePool& getProjectiles() const { return m_projectiles; }
+
+		const CLevel& getLevel() const { return m_level; }
+		int getCols() const { return m_cols; }
+		int getRows() const { return m_rows; }
+		const CArenaArray<CWall>& getWalls() const { return m_walls; }
+		const CEnemyPool& getEnemies() const { return m_enemies; }
+		// body of enemy i at 2 * i, its head at 2 * i + 1
+		const CArenaArray<CWall>& getHitboxes() const { return m_hitboxes; }
+		// holds the walls, enemies, hitboxes and bullets of the loaded level
+		const CArena& getArena() const { return m_arena; }
+		const CWall& getFlag() const { return m_flag; }
+		const CWall& getPlane() const { return m_plane; }
+		const CWall& getCeiling() const { return m_ceiling; }
+
+	private:
+		bool make_map();
+		void updateEnemies();
+		void chase(double timeDelta);
+		void locate_enemy();
+		// the const queries below only read the world, so they can run on any thread
+		// without candidates the enemy hitboxes are looked up in the hitbox grid
+		SweepHit sweep(const Vec3& from, const Vec3& to, double radius, bool enemies, bool player, CollisionStats& stats,
+			const HitboxCandidates* candidates = NULL) const;
+		bool hitsWall(const CSphere& ball, CollisionStats& stats) const;
+		SweepHit probe(const CSphere& ball, int owner, CollisionStats& stats, const HitboxCandidates* candidates = NULL) const;
+		SweepHit bulletHit(int i, double timeDelta, CollisionStats& stats, const HitboxCandidates* candidates = NULL) const;
+		HitboxQuery bulletQuery(int i, double timeDelta) const;
+		void collideBullets(double timeDelta);
+		void prepareChunks(int count, int grain);
+		bool applyHit(int i, const SweepHit& hit);
+		void retireBullet(int i);
+		void shootEnemy(int i, bool headShot);
+		void fireEnemy(int i, int player);
+		void look(int player, int dh, int dv);
+		void fire(int player);
+		void walk(int player, const Input& input, double timeDelta);
+		void resetPlayer(Player& player) const;
+		bool playerBulletsInFlight() const;
+		int nearestPlayer(const Vec3& p) const;
+
+		// grid is centered on the origin, rows run towards -z
+		double cellX(int col) const { return m_origin_x + (col + 0.5) * WORLD_SIZE; }
+		double cellZ(int row) const { return m_origin_z - (row + 0.5) * WORLD_SIZE; }
+		int colAt(double x) const { return (int)floor((x - m_origin_x) / WORLD_SIZE); }
+		int rowAt(double z) const { return (int)floor((m_origin_z - z) / WORLD_SIZE); }
+
+		CLevel				m_level;
+		CArena				m_arena;        // reset on every (re)load, declared before what lives in it
+		CVisibility			m_visibility;
+		bool				m_culling;
+		CLineOfSight		m_los;
+		bool				m_useLos;
+		std::vector<LosQuery>	m_losQueries;   // one slot per enemy
+		std::vector<unsigned char>	m_losVisible;
+		CFlowField			m_flow;
+		bool				m_chase;
+		int					m_cols, m_rows;
+		double				m_origin_x, m_origin_z;     // world position of the grid's top left corner
+		CArenaArray<CWall>	m_walls;
+		int					m_wallCells;
+		bool				m_mergeWalls;
+		CEnemyPool			m_enemies;
+		CWall				m_flag;
+		CWall				m_plane;
+		CWall				m_ceiling;
+		CCollisionGrid		m_wallGrid;
+		bool				m_broadphase;
+		bool				m_continuous;
+		CollisionStats		m_stats;
+
+		CArenaArray<CWall>	m_hitboxes;     // body, head of every enemy
+		CArenaArray<unsigned char> m_hitboxOff;
+		CCollisionGrid		m_hitboxGrid;
+		double				m_hitboxCell;   // coarser than a map cell on big maps
+		CHitboxBatch		m_hitboxBatch;
+		bool				m_useBatch;
+
+		CProjectilePool		m_projectiles;
+		int					m_burst;
+
+		// what one job of a parallel pass produced, merged in chunk order afterwards
+		struct ChunkEvents
+		{
+			std::vector<int>	fire;       // enemies that get to fire, in index order
+			LosStats			los;
+			CollisionStats		stats;
+			bool				regrid;
+			std::vector<HitboxQuery>	queries;    // the chunk's player bullets
+			std::vector<HitboxHit>	hits;
+		};
+		CJobSystem			m_jobs;
+		std::vector<ChunkEvents>	m_chunks;
+		std::vector<SweepHit>	m_bulletHits;   // per bullet, against the state before any hit landed
+		std::vector<int>	m_bulletSlot;   // pool slot -> bullet index of m_bulletHits
+
+		std::vector<Player>	m_players;
+		std::vector<int>	m_targetRows, m_targetCols;     // cells of the players in the match
+		std::vector<int>	m_enemyTarget;  // player each enemy aims at this tick, -1 for none
+
+		GameStatus			m_status;
+		unsigned long		m_tick;
+	};
+
+	extern const char builtin_map[MAP_SIZE][MAP_SIZE + 1];
+}
+
+#endif // __gameSimH__
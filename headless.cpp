@@ -0,0 +1,599 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: headless.cpp
+//
+// Desc: Runs the game simulation without a renderer at a fixed timestep, driven by a
+//       seeded scripted player, and reports the tick rate. Used for load tests and
+//       profiling on machines without a Direct3D device. With --render every tick is
+//       also drawn into a recording backend to count draw calls and state changes, and
+//       the level's lights are baked on --threads threads (--no-bake skips it).
+//       --realtime runs the simulation on its own thread at the tick rate for the
+//       given number of ticks worth of wall time, while this thread draws blended
+//       snapshots as fast as it can. --record writes every tick's input to a log and
+//       --replay runs a log again as fast as possible, checking the state hash of
+//       every tick. --reload loads levels over and over before the run (alternating
+//       with the built-in level when --level is given) to check that reloading neither
+//       allocates nor grows the process. --serve hosts the world for network clients
+//       over UDP on localhost and --connect plays against such a server with the
+//       scripted player; --clients runs a server and N scripted clients in this process
+//       in lockstep over loopback, for each N in the list, and reports the bandwidth per
+//       client and the server's cost per tick. --rollback saves the world after every
+//       tick and every STATE_RING_TICKS ticks goes back that far and runs them again,
+//       checking that the rerun gives the same state hashes.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gameSim.h"
+#include "recordingBackend.h"
+#include "sceneRenderer.h"
+#include "snapshot.h"
+#include "inputLog.h"
+#include "profiler.h"
+#include "netServer.h"
+#include "netClient.h"
+#include "worldState.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// -----------------------------------------------------------------------------
+// Scripted player: holds a random action for a random number of ticks
+// -----------------------------------------------------------------------------
+
+class CBot {
+public:
+	CBot(unsigned int seed) : m_state(seed ? seed : 1), m_hold(0) {}
+
+	sim::Input next() {
+		if (m_hold-- <= 0) {
+			unsigned int r = rand32();
+			m_action = sim::Input();
+			m_action.forward = (r & 3) != 0;
+			m_action.back = (r & 3) == 0;
+			m_action.left = (r & 12) == 4;
+			m_action.right = (r & 12) == 8;
+			m_action.look_h = (int)((r >> 4) % 41) - 20;
+			m_action.look_v = (int)((r >> 10) % 5) - 2;
+			m_hold = 10 + (int)((r >> 16) % 50);
+		}
+		sim::Input input = m_action;
+		input.fire = (rand32() & 7) == 0;
+		return input;
+	}
+
+private:
+	unsigned int rand32() {
+		m_state ^= m_state << 13;
+		m_state ^= m_state >> 17;
+		m_state ^= m_state << 5;
+		return m_state;
+	}
+
+	unsigned int m_state;
+	int m_hold;
+	sim::Input m_action;
+};
+
+// simulation thread at hz, frames drawn here until the time is up or the game ends
+static int runRealtime(sim::CWorld& world, render::CSceneRenderer* renderer, CBot& bot, double hz, long ticks, sim::CInputLog* log) {
+	sim::CSimThread simThread;
+	sim::Snapshot prev, curr, frame;
+	long frames = 0;
+	double sum_alpha = 0;
+
+	simThread.setRecorder(log);
+	simThread.start(world, hz);
+	const double seconds = ticks / hz, start = simThread.now();
+	while (simThread.now() - start < seconds && simThread.isRunning()) {
+		simThread.addInput(bot.next());
+		simThread.getSnapshots().read(prev, curr);
+		const double alpha = simThread.getAlpha(prev, curr);
+		sim::interpolateSnapshots(prev, curr, alpha, frame);
+		if (renderer) renderer->drawFrame(world, frame);
+		sum_alpha += alpha;
+		frames++;
+	}
+	simThread.stop();
+	const double elapsed = simThread.now() - start;
+
+	printf("realtime     %lu ticks in %.2f s (%.1f Hz), %lu dropped\n", simThread.getTicks(), elapsed,
+		elapsed > 0 ? simThread.getTicks() / elapsed : 0.0, simThread.getDroppedTicks());
+	printf("frames       %ld drawn (%.0f per second), blend %.2f on average\n", frames, elapsed > 0 ? frames / elapsed : 0.0,
+		frames ? sum_alpha / frames : 0.0);
+	printf("status       %s\n", world.getStatus() == sim::GAME_RUNNING ? "running" : world.getStatus() == sim::GAME_WON ? "won" : "lost");
+	return 0;
+}
+
+// reruns a recorded session with its settings and level; restarts where the recording
+// did, i.e. after any tick that ended the game
+static int runReplay(const char* path, const char* levelPath, int threads) {
+	sim::CInputLog log;
+	if (!log.open(path)) {
+		fprintf(stderr, "replay(%s) - FAILED\n", path);
+		return 1;
+	}
+	sim::CWorld world;
+	log.apply(world);
+	world.setThreads(threads);
+	if (levelPath == NULL && !log.getLevel().empty()) levelPath = log.getLevel().c_str();
+	if (levelPath ? !world.loadFile(levelPath) : !world.load()) {
+		fprintf(stderr, "load(%s) - FAILED\n", levelPath ? levelPath : "");
+		return 1;
+	}
+	srand(log.getSeed());
+
+	const double timeDelta = 1.0 / log.getHz();
+	int diverged = -1;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int t = 0; t < log.getTicks(); t++) {
+		world.tick(timeDelta, log.getInput(t));
+		if (sim::CInputLog::foldHash(world.getStateHash()) != log.getHash(t)) {
+			diverged = t;
+			break;
+		}
+		if (world.getStatus() != sim::GAME_RUNNING) world.restart();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("replay       %s, %d ticks @ %.1f Hz (seed %u), %.2f bytes per tick\n", path, log.getTicks(), log.getHz(),
+		log.getSeed(), log.getTicks() ? (double)log.getRecordBytes() / log.getTicks() : 0.0);
+	printf("level        %s, %d x %d cells\n", levelPath ? levelPath : "built-in", world.getCols(), world.getRows());
+	if (diverged >= 0) printf("state        DIVERGED at tick %d\n", diverged);
+	else printf("state        every tick matches\n");
+	printf("elapsed      %.3f s\n", seconds);
+	printf("ticks/sec    %.0f\n", seconds > 0 ? (diverged >= 0 ? diverged + 1 : log.getTicks()) / seconds : 0.0);
+	return diverged >= 0 ? 2 : 0;
+}
+
+static double clockSeconds() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void printServerStats(const sim::NetServerStats& stats, int clients) {
+	const unsigned long ticks = stats.ticks ? stats.ticks : 1;
+	printf("server       %lu ticks, %.3f ms simulating and %.3f ms sending per tick\n", stats.ticks,
+		1000 * stats.tick_seconds / ticks, 1000 * stats.encode_seconds / ticks);
+	printf("snapshots    %lu sent (%lu full), %lu failed, %.1f bytes each\n", stats.snapshots, stats.full_snapshots,
+		stats.send_failures, stats.snapshots ? (double)stats.bytes_sent / stats.snapshots : 0.0);
+	printf("clients      %d connected at the end\n", clients);
+}
+
+// hosts the world on localhost at hz for the given number of ticks
+static int runServer(sim::CWorld& world, int port, double hz, long ticks) {
+	sim::CNetServer server;
+	if (port <= 0 || port > 65535 || !server.open(world, NET_LOOPBACK, (uint16_t)port, hz)) {
+		fprintf(stderr, "serve(%d) - FAILED\n", port);
+		return 1;
+	}
+	printf("serving      127.0.0.1:%d at %.1f Hz for %ld ticks\n", server.getPort(), hz, ticks);
+	fflush(stdout);
+	double due = clockSeconds();
+	for (long t = 0; t < ticks; t++) {
+		const double wait = due - clockSeconds();
+		if (wait > 0) std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+		due += 1.0 / hz;
+		server.receive();
+		server.tick();
+	}
+	printServerStats(server.getStats(), server.getClientCount());
+	return 0;
+}
+
+// the scripted player against a server, one input per tick of the server's rate
+static int runClient(const char* address, CBot& bot, long ticks) {
+	sim::NetAddress server;
+	sim::CNetClient client;
+	if (!sim::parseAddress(address, server) || !client.connect(server)) {
+		fprintf(stderr, "connect(%s) - FAILED\n", address);
+		return 1;
+	}
+	sim::Snapshot view;
+	long views = 0;
+	int seen = 0;
+	double due = clockSeconds();
+	for (long t = 0; t < ticks && !client.wasRefused(); t++) {
+		const double wait = due - clockSeconds();
+		if (wait > 0) std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+		due += 1.0 / client.getHz();
+		client.sendInput(bot.next());
+		client.receive(clockSeconds());
+		if (!client.getView(clockSeconds(), view)) continue;
+		views++;
+		int active = 0;
+		for (size_t p = 0; p < view.players.size(); p++) active += view.players[p].active;
+		if (active > seen) seen = active;
+	}
+	if (client.wasRefused()) {
+		fprintf(stderr, "connect(%s) - server full\n", address);
+		return 1;
+	}
+	const sim::NetClientStats& stats = client.getStats();
+	printf("client       slot %d, %ld frames drawn from %lu snapshots (%lu full, %lu dropped)\n", client.getSlot(), views,
+		stats.snapshots, stats.full_snapshots, stats.dropped);
+	printf("traffic      %.1f KB down, %.1f KB up, up to %d players seen\n", stats.bytes_received / 1024.0,
+		stats.bytes_sent / 1024.0, seen);
+	return 0;
+}
+
+// for each client count: a fresh match, every client connected, then the ticks run in
+// lockstep (all inputs, one server tick, all snapshots read) so the numbers do not depend
+// on scheduling
+static int runNetBench(sim::CWorld& world, const char* list, double hz, long ticks, unsigned int seed) {
+	printf("net          loopback, %.1f Hz, %ld ticks per row\n", hz, ticks);
+	printf("  players  bytes/tick  KB/s down  KB/s up  full  tick ms  send ms  client ms\n");
+	for (const char* p = list; *p; ) {
+		const int count = atoi(p);
+		while (*p && *p != ',') p++;
+		if (*p) p++;
+		if (count <= 0 || count > MAX_PLAYERS) {
+			fprintf(stderr, "clients(%d) - must be 1 to %d\n", count, MAX_PLAYERS);
+			return 1;
+		}
+
+		world.restart();
+		sim::CNetServer server;
+		if (!server.open(world, NET_LOOPBACK, 0, hz)) {
+			fprintf(stderr, "serve(loopback) - FAILED\n");
+			return 1;
+		}
+		std::vector<sim::CNetClient> clients(count);
+		std::vector<CBot> bots;
+		for (int k = 0; k < count; k++) {
+			bots.push_back(CBot(seed + k));
+			if (!clients[k].connect(sim::NetAddress(NET_LOOPBACK, server.getPort()))) {
+				fprintf(stderr, "connect(loopback) - FAILED\n");
+				return 1;
+			}
+		}
+		for (int round = 0; round < 100 && server.getClientCount() < count; round++) {
+			server.receive();
+			for (int k = 0; k < count; k++) clients[k].receive(clockSeconds());
+			for (int k = 0; k < count; k++) if (!clients[k].isConnected()) clients[k].sendInput(sim::Input());
+		}
+		if (server.getClientCount() < count) {
+			fprintf(stderr, "clients(%d) - only %d connected\n", count, server.getClientCount());
+			return 1;
+		}
+		for (int k = 0; k < count; k++) clients[k].receive(clockSeconds());
+		server.resetStats();
+		for (int k = 0; k < count; k++) clients[k].resetStats();
+
+		sim::Snapshot view;
+		double client_seconds = 0;
+		for (long t = 0; t < ticks; t++) {
+			for (int k = 0; k < count; k++) clients[k].sendInput(bots[k].next());
+			server.receive();
+			server.tick();
+			const double start = clockSeconds();
+			for (int k = 0; k < count; k++) {
+				clients[k].receive(start);
+				clients[k].getView(start, view);
+			}
+			client_seconds += clockSeconds() - start;
+		}
+
+		const sim::NetServerStats& stats = server.getStats();
+		unsigned long long up = 0;
+		for (int k = 0; k < count; k++) up += clients[k].getStats().bytes_sent;
+		const double down_tick = (double)stats.bytes_sent / count / ticks;
+		printf("  %7d  %10.1f  %9.2f  %7.2f  %4lu  %7.3f  %7.3f  %9.3f\n", count, down_tick, down_tick * hz / 1024,
+			(double)up / count / ticks * hz / 1024, stats.full_snapshots, 1000 * stats.tick_seconds / ticks,
+			1000 * stats.encode_seconds / ticks, 1000 * client_seconds / ticks / count);
+		fflush(stdout);
+	}
+	return 0;
+}
+
+// writes the trace and prints the per-scope table when profiling
+static int finish(int result, const char* profilePath) {
+	if (profilePath == NULL) return result;
+	if (!sim::CProfiler::writeTrace(profilePath)) {
+		fprintf(stderr, "trace(%s) - FAILED\n", profilePath);
+		return 1;
+	}
+	printf("profile      %s, last %d scopes per thread\n", profilePath, PROFILE_RING);
+	sim::CProfiler::writeTable(stdout, "  ");
+	return result;
+}
+
+// resident set size in KB, -1 where it is not known
+static long residentKB() {
+#ifdef __linux__
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (f == NULL) return -1;
+	long pages = 0, resident = -1;
+	if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = -1;
+	fclose(f);
+	return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+	return -1;
+#endif
+}
+
+static void usage(const char* argv0) {
+	printf("usage: %s [--level FILE] [--ticks N] [--hz H] [--seed S] [--brute] [--discrete] [--burst B] [--no-merge] [--no-pvs] [--no-los] [--no-chase] [--threads T] [--hitboxes grid|scalar|sse2|avx2] [--realtime] [--record FILE] [--replay FILE] [--profile FILE] [--reload N] [--render] [--no-batch] [--no-bake] [--serve PORT] [--connect HOST:PORT] [--clients N,N,...] [--rollback]\n", argv0);
+}
+
+int main(int argc, char* argv[]) {
+	const char* levelPath = NULL;
+	long ticks = 100000;
+	double hz = 60.0;
+	unsigned int seed = 1;
+	bool brute = false;
+	bool ccd = true;
+	int burst = 1;
+	bool merge = true;
+	bool culling = true;
+	bool los = true;
+	bool chase = true;
+	int threads = 0;
+	const char* hitboxes = NULL;
+	bool realtime = false;
+	const char* recordPath = NULL;
+	const char* replayPath = NULL;
+	const char* profilePath = NULL;
+	int reloads = 0;
+	bool draw = false;
+	bool batching = true;
+	bool bake = true;
+	int servePort = 0;
+	const char* connectAddress = NULL;
+	const char* clientCounts = NULL;
+	bool rollback = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--level") && i + 1 < argc) levelPath = argv[++i];
+		else if (!strcmp(argv[i], "--ticks") && i + 1 < argc) ticks = atol(argv[++i]);
+		else if (!strcmp(argv[i], "--hz") && i + 1 < argc) hz = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--brute")) brute = true;
+		else if (!strcmp(argv[i], "--discrete")) ccd = false;
+		else if (!strcmp(argv[i], "--burst") && i + 1 < argc) burst = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--no-merge")) merge = false;
+		else if (!strcmp(argv[i], "--no-pvs")) culling = false;
+		else if (!strcmp(argv[i], "--no-los")) los = false;
+		else if (!strcmp(argv[i], "--no-chase")) chase = false;
+		else if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--hitboxes") && i + 1 < argc) hitboxes = argv[++i];
+		else if (!strcmp(argv[i], "--realtime")) realtime = true;
+		else if (!strcmp(argv[i], "--record") && i + 1 < argc) recordPath = argv[++i];
+		else if (!strcmp(argv[i], "--replay") && i + 1 < argc) replayPath = argv[++i];
+		else if (!strcmp(argv[i], "--profile") && i + 1 < argc) profilePath = argv[++i];
+		else if (!strcmp(argv[i], "--reload") && i + 1 < argc) reloads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--render")) draw = true;
+		else if (!strcmp(argv[i], "--no-batch")) { draw = true; batching = false; }
+		else if (!strcmp(argv[i], "--no-bake")) { draw = true; bake = false; }
+		else if (!strcmp(argv[i], "--serve") && i + 1 < argc) servePort = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--connect") && i + 1 < argc) connectAddress = argv[++i];
+		else if (!strcmp(argv[i], "--clients") && i + 1 < argc) clientCounts = argv[++i];
+		else if (!strcmp(argv[i], "--rollback")) rollback = true;
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (ticks <= 0 || hz <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+	bool hitboxBatch = true;
+	if (hitboxes) {
+		if (!strcmp(hitboxes, "grid")) hitboxBatch = false;
+		else if (!strcmp(hitboxes, "scalar")) sim::CHitboxBatch::setKernel(sim::KERNEL_SCALAR);
+		else if (!strcmp(hitboxes, "sse2")) sim::CHitboxBatch::setKernel(sim::KERNEL_SSE2);
+		else if (!strcmp(hitboxes, "avx2")) sim::CHitboxBatch::setKernel(sim::KERNEL_AVX2);
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (profilePath) {
+		sim::CProfiler::setEnabled(true);
+		sim::CProfiler::setThreadName("main");
+	}
+	if (replayPath) return finish(runReplay(replayPath, levelPath, threads), profilePath);
+	if (connectAddress) {
+		CBot bot(seed);
+		return finish(runClient(connectAddress, bot, ticks), profilePath);
+	}
+
+	sim::CWorld world;
+	world.setBroadphase(!brute);
+	world.setContinuous(ccd);
+	world.setEnemyBurst(burst);
+	world.setMergeWalls(merge);
+	world.setCulling(culling);
+	world.setLineOfSight(los);
+	world.setChase(chase);
+	world.setThreads(threads);
+	world.setHitboxBatch(hitboxBatch);
+	std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+	if (levelPath ? !world.loadFile(levelPath) : !world.load()) {
+		fprintf(stderr, "load(%s) - FAILED\n", levelPath ? levelPath : "");
+		return 1;
+	}
+	double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+
+	// the first round brings every buffer up to the size of the biggest level, after
+	// that the arena should stay at one block and the process should stop growing
+	double reloadMs = 0;
+	unsigned long reloadBlocks = 0;
+	long reloadRss = 0, reloadRssFirst = 0;
+	if (reloads > 0) {
+		const unsigned long blocksBefore = world.getArena().getBlockAllocations();
+		std::chrono::steady_clock::time_point reloadStart = std::chrono::steady_clock::now();
+		for (int k = 1; k <= reloads; k++) {
+			const bool builtin = levelPath == NULL || (k & 1);
+			if (builtin ? !world.load() : !world.loadFile(levelPath)) {
+				fprintf(stderr, "load(%s) - FAILED\n", builtin ? "" : levelPath);
+				return 1;
+			}
+			if (k == 2 || reloads == 1) reloadRssFirst = residentKB();
+		}
+		reloadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - reloadStart).count();
+		reloadBlocks = world.getArena().getBlockAllocations() - blocksBefore;
+		reloadRss = residentKB();
+	}
+
+	render::CRecordingBackend backend;
+	render::CSceneRenderer renderer;
+	renderer.setBatching(batching);
+	renderer.setCulling(culling);
+	renderer.setBakedLighting(bake);
+	renderer.setBakeThreads(threads);
+	if (draw && !renderer.create(&backend, world, 1024, 768)) {
+		fprintf(stderr, "renderer create() - FAILED\n");
+		return 1;
+	}
+	long long sum_draws = 0, sum_states = 0, sum_triangles = 0;
+	long long sum_static = 0, sum_static_total = 0, sum_transforms = 0;
+
+	sim::CInputLog log;
+	srand(seed);
+	if (recordPath && !log.create(recordPath, world, seed, hz, levelPath)) {
+		fprintf(stderr, "record(%s) - FAILED\n", recordPath);
+		return 1;
+	}
+
+	if (servePort) return finish(runServer(world, servePort, hz, ticks), profilePath);
+	if (clientCounts) return finish(runNetBench(world, clientCounts, hz, ticks, seed), profilePath);
+
+	CBot bot(seed);
+	if (realtime) return finish(runRealtime(world, draw ? &renderer : NULL, bot, hz, ticks, recordPath ? &log : NULL), profilePath);
+	const double timeDelta = 1.0 / hz;
+	int won = 0, lost = 0;
+	unsigned long long hash = 0;
+	int peak_bullets = 0;
+	double sum_bullets = 0;
+	sim::CStateRing ring;
+	sim::Input ringInputs[STATE_RING_TICKS];
+	unsigned long long ringHashes[STATE_RING_TICKS];
+	int sinceRollback = 0;
+	long rollbacks = 0, mismatches = 0, saves = 0;
+	double saveSeconds = 0, loadSeconds = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (long t = 0; t < ticks; t++) {
+		const sim::Input input = bot.next();
+		if (rollback) {
+			std::chrono::steady_clock::time_point saveStart = std::chrono::steady_clock::now();
+			ring.save(world);
+			saveSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - saveStart).count();
+			saves++;
+		}
+		world.tick(timeDelta, input);
+		if (recordPath) log.record(input, world.getStateHash());
+		if (rollback) {
+			ringInputs[t % STATE_RING_TICKS] = input;
+			ringHashes[t % STATE_RING_TICKS] = world.getStateHash();
+			// back to the state before the oldest tick in the ring, then every tick again
+			if (++sinceRollback == STATE_RING_TICKS) {
+				std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+				ring.rollback(world, STATE_RING_TICKS - 1);
+				loadSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+				for (long r = t - STATE_RING_TICKS + 1; r <= t; r++) {
+					world.tick(timeDelta, ringInputs[r % STATE_RING_TICKS]);
+					if (world.getStateHash() != ringHashes[r % STATE_RING_TICKS]) mismatches++;
+					if (r < t) ring.save(world);
+				}
+				rollbacks++;
+				sinceRollback = 0;
+			}
+		}
+		const int live = world.getProjectiles().size();
+		if (live > peak_bullets) peak_bullets = live;
+		sum_bullets += live;
+		if (draw) {
+			renderer.drawFrame(world);
+			const render::FrameStats& frame = backend.getFrameStats();
+			sum_draws += frame.draw_calls;
+			sum_states += frame.state_changes;
+			sum_triangles += frame.triangles;
+			sum_static += renderer.getCullStats().static_drawn;
+			sum_static_total += renderer.getCullStats().static_total;
+			sum_transforms += renderer.getCullStats().transforms_built;
+		}
+		if (world.getStatus() != sim::GAME_RUNNING) {
+			if (world.getStatus() == sim::GAME_WON) won++;
+			else lost++;
+			hash = hash * 31 + world.getStateHash();
+			world.restart();
+			ring.clear();
+			sinceRollback = 0;
+			if (draw) renderer.create(&backend, world, 1024, 768);
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	hash = hash * 31 + world.getStateHash();
+
+	printf("ticks        %ld @ %.1f Hz (seed %u)\n", ticks, hz, seed);
+	printf("level        %s, %d x %d cells, loaded in %.2f ms\n", levelPath ? levelPath : "built-in",
+		world.getCols(), world.getRows(), loadMs);
+	if (world.getVisibility().isBuilt()) {
+		const sim::CVisibility& pvs = world.getVisibility();
+		printf("pvs          %dx%d cell tiles, %.1f%% of the level visible on average, built in %.1f ms\n",
+			pvs.getTileSize(), pvs.getTileSize(), 100.0 * pvs.getAverageVisible(), pvs.getBuildMs());
+	}
+	if (reloads > 0) {
+		printf("reload       %d loads in %.1f ms (%.3f ms each), %lu arena blocks taken\n", reloads, reloadMs,
+			reloadMs / reloads, reloadBlocks);
+		if (reloadRss >= 0) printf("resident     %ld KB after the first round, %ld KB after the last load\n", reloadRssFirst, reloadRss);
+	}
+	const sim::CArena& arena = world.getArena();
+	printf("arena        %.1f of %.1f KB in %d block%s\n", arena.getUsed() / 1024.0, arena.getCapacity() / 1024.0,
+		arena.getBlocks(), arena.getBlocks() == 1 ? "" : "s");
+	printf("walls        %d boxes from %d wall cells%s\n", (int)world.getWalls().size(), world.getWallCells(),
+		merge ? "" : " (merging off)");
+	printf("enemies      %d\n", world.getEnemies().size());
+	printf("bullets      %.1f live on average, %d peak\n", sum_bullets / ticks, peak_bullets);
+	printf("games        %d won, %d lost\n", won, lost);
+	if (!hitboxBatch || world.getEnemies().size() * 2 > HITBOX_BATCH_MAX) printf("hitboxes     grid\n");
+	else printf("hitboxes     %s batch\n", sim::CHitboxBatch::getKernelName(sim::CHitboxBatch::getKernel()));
+	const sim::CollisionStats& stats = world.getStats();
+	printf("broadphase   %s\n", ccd ? "swept (grid traversal)" : (brute ? "off (every wall)" : "map grid"));
+	printf("box tests    %.1f per tick, %.2f per bullet query\n",
+		(double)stats.box_tests / ticks, stats.queries ? (double)stats.box_tests / stats.queries : 0.0);
+	if (ccd) printf("cells        %.2f per bullet query\n", stats.queries ? (double)stats.cells_visited / stats.queries : 0.0);
+	if (draw) {
+		printf("static       %d boxes in %d batches%s\n", renderer.getStaticBoxes(), renderer.getStaticBatches(),
+			batching ? "" : " (batching off)");
+		const render::BakeStats& baked = renderer.getBakeStats();
+		if (baked.threads) printf("lighting     %d lights baked into %lld vertices (%d quads) in %.1f ms on %d threads\n",
+			baked.lights, baked.vertices, baked.quads, baked.ms, baked.threads);
+		else printf("lighting     point light (baking off)\n");
+		printf("meshes       %d live for %d references\n", backend.getLiveMeshes(), renderer.getMeshCache().getReferences());
+		printf("culling      %.1f%% of static %s drawn%s\n", sum_static_total ? 100.0 * sum_static / sum_static_total : 0.0,
+			batching ? "batches" : "boxes", culling ? "" : " (culling off)");
+		printf("frame        %.1f draw calls, %.1f state changes, %.0f triangles on average\n",
+			(double)sum_draws / ticks, (double)sum_states / ticks, (double)sum_triangles / ticks);
+		printf("transforms   %.1f world matrices built per frame\n", (double)sum_transforms / ticks);
+	}
+	if (los) {
+		const sim::LosStats& ls = world.getLosStats();
+		printf("sight        %.1f queries per tick, %.1f%% cached, %.2f cells per march\n", (double)ls.queries / ticks,
+			ls.queries ? 100.0 * ls.cache_hits / ls.queries : 0.0,
+			ls.queries > ls.cache_hits ? (double)ls.cells_marched / (ls.queries - ls.cache_hits) : 0.0);
+	}
+	if (chase) {
+		const long long updates = world.getFlowField().getUpdates();
+		printf("chase        %lld flow field updates, one per %.1f ticks, %d cells reached\n", updates,
+			updates ? (double)ticks / updates : 0.0, world.getFlowField().getReached());
+	}
+	if (rollback) {
+		printf("rollback     %ld rollbacks of %d ticks, %ld hash mismatches\n", rollbacks, STATE_RING_TICKS - 1, mismatches);
+		printf("state        %d bytes, %.2f us to save, %.2f us to load\n", ring.size() ? (int)ring.get(0).size() : 0,
+			saves ? 1e6 * saveSeconds / saves : 0.0, rollbacks ? 1e6 * loadSeconds / rollbacks : 0.0);
+	}
+	printf("threads      %d, %lld chunks stolen\n", world.getThreads(), world.getJobSystem().getSteals());
+	printf("state hash   %016llx\n", hash);
+	printf("elapsed      %.3f s\n", seconds);
+	printf("ticks/sec    %.0f\n", seconds > 0 ? ticks / seconds : 0.0);
+	return finish(0, profilePath);
+}
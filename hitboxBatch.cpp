@@ -0,0 +1,181 @@
+#include "hitboxBatch.h"
+#include <atomic>
+#include <cfloat>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define HITBOX_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define HITBOX_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define HITBOX_TARGET_AVX2
+#endif
+
+namespace sim
+{
+
+struct BoxArrays
+{
+	const float* lox, *hix, *loy, *hiy, *loz, *hiz;
+	const int* box;
+	int padded;
+};
+
+static void emit(const HitboxQuery& q, int box, std::vector<HitboxHit>& out) {
+	HitboxHit hit;
+	hit.projectile = q.projectile;
+	hit.enemy = box / 2;
+	hit.head = (box & 1) != 0;
+	out.push_back(hit);
+}
+
+static void overlapsScalar(const BoxArrays& b, const HitboxQuery* queries, int count, std::vector<HitboxHit>& out) {
+	for (int k = 0; k < count; k++) {
+		const HitboxQuery& q = queries[k];
+		for (int i = 0; i < b.padded; i++) {
+			if (q.lo[0] < b.hix[i] && q.hi[0] > b.lox[i] && q.lo[1] < b.hiy[i] && q.hi[1] > b.loy[i] &&
+				q.lo[2] < b.hiz[i] && q.hi[2] > b.loz[i]) emit(q, b.box[i], out);
+		}
+	}
+}
+
+#ifdef HITBOX_X86
+static void overlapsSse2(const BoxArrays& b, const HitboxQuery* queries, int count, std::vector<HitboxHit>& out) {
+	for (int k = 0; k < count; k++) {
+		const HitboxQuery& q = queries[k];
+		const __m128 qlx = _mm_set1_ps(q.lo[0]), qhx = _mm_set1_ps(q.hi[0]);
+		const __m128 qly = _mm_set1_ps(q.lo[1]), qhy = _mm_set1_ps(q.hi[1]);
+		const __m128 qlz = _mm_set1_ps(q.lo[2]), qhz = _mm_set1_ps(q.hi[2]);
+		for (int i = 0; i < b.padded; i += 4) {
+			__m128 m = _mm_and_ps(_mm_cmplt_ps(qlx, _mm_loadu_ps(b.hix + i)), _mm_cmpgt_ps(qhx, _mm_loadu_ps(b.lox + i)));
+			m = _mm_and_ps(m, _mm_and_ps(_mm_cmplt_ps(qly, _mm_loadu_ps(b.hiy + i)), _mm_cmpgt_ps(qhy, _mm_loadu_ps(b.loy + i))));
+			m = _mm_and_ps(m, _mm_and_ps(_mm_cmplt_ps(qlz, _mm_loadu_ps(b.hiz + i)), _mm_cmpgt_ps(qhz, _mm_loadu_ps(b.loz + i))));
+			for (int bits = _mm_movemask_ps(m); bits; bits &= bits - 1) {
+				int lane = 0;
+				while (!(bits & (1 << lane))) lane++;
+				emit(q, b.box[i + lane], out);
+			}
+		}
+	}
+}
+
+HITBOX_TARGET_AVX2
+static void overlapsAvx2(const BoxArrays& b, const HitboxQuery* queries, int count, std::vector<HitboxHit>& out) {
+	for (int k = 0; k < count; k++) {
+		const HitboxQuery& q = queries[k];
+		const __m256 qlx = _mm256_set1_ps(q.lo[0]), qhx = _mm256_set1_ps(q.hi[0]);
+		const __m256 qly = _mm256_set1_ps(q.lo[1]), qhy = _mm256_set1_ps(q.hi[1]);
+		const __m256 qlz = _mm256_set1_ps(q.lo[2]), qhz = _mm256_set1_ps(q.hi[2]);
+		for (int i = 0; i < b.padded; i += 8) {
+			__m256 m = _mm256_and_ps(_mm256_cmp_ps(qlx, _mm256_loadu_ps(b.hix + i), _CMP_LT_OQ),
+				_mm256_cmp_ps(qhx, _mm256_loadu_ps(b.lox + i), _CMP_GT_OQ));
+			m = _mm256_and_ps(m, _mm256_and_ps(_mm256_cmp_ps(qly, _mm256_loadu_ps(b.hiy + i), _CMP_LT_OQ),
+				_mm256_cmp_ps(qhy, _mm256_loadu_ps(b.loy + i), _CMP_GT_OQ)));
+			m = _mm256_and_ps(m, _mm256_and_ps(_mm256_cmp_ps(qlz, _mm256_loadu_ps(b.hiz + i), _CMP_LT_OQ),
+				_mm256_cmp_ps(qhz, _mm256_loadu_ps(b.loz + i), _CMP_GT_OQ)));
+			for (int bits = _mm256_movemask_ps(m); bits; bits &= bits - 1) {
+				int lane = 0;
+				while (!(bits & (1 << lane))) lane++;
+				emit(q, b.box[i + lane], out);
+			}
+		}
+	}
+}
+
+static bool cpuHasAvx2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	// AVX state has to be saved by the OS as well
+	if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6) return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+static HitboxKernel bestKernel() {
+#ifdef HITBOX_X86
+	return cpuHasAvx2() ? KERNEL_AVX2 : KERNEL_SSE2;
+#else
+	return KERNEL_SCALAR;
+#endif
+}
+
+static std::atomic<int> s_kernel(KERNEL_AUTO);
+
+void CHitboxBatch::setKernel(HitboxKernel kernel) {
+	if (kernel == KERNEL_AUTO) kernel = bestKernel();
+#ifdef HITBOX_X86
+	if (kernel == KERNEL_AVX2 && !cpuHasAvx2()) kernel = KERNEL_SCALAR;
+#else
+	kernel = KERNEL_SCALAR;
+#endif
+	s_kernel = kernel;
+}
+
+HitboxKernel CHitboxBatch::getKernel() {
+	if (s_kernel == KERNEL_AUTO) s_kernel = bestKernel();
+	return (HitboxKernel)s_kernel.load();
+}
+
+const char* CHitboxBatch::getKernelName(HitboxKernel kernel) {
+	switch (kernel) {
+	case KERNEL_SCALAR: return "scalar";
+	case KERNEL_SSE2: return "sse2";
+	case KERNEL_AVX2: return "avx2";
+	default: return "auto";
+	}
+}
+
+CHitboxBatch::CHitboxBatch(void) {
+	m_count = 0;
+}
+
+void CHitboxBatch::build(const CWall* boxes, const unsigned char* off, int count) {
+	m_lox.clear();	m_hix.clear();
+	m_loy.clear();	m_hiy.clear();
+	m_loz.clear();	m_hiz.clear();
+	m_box.clear();
+	for (int i = 0; i < count; i++) {
+		if (off && off[i]) continue;
+		const Vec3 p = boxes[i].getPosition();
+		const Vec3 s = boxes[i].getSize();
+		m_lox.push_back((float)(p.x - s.x / 2) - HITBOX_MARGIN);	m_hix.push_back((float)(p.x + s.x / 2) + HITBOX_MARGIN);
+		m_loy.push_back((float)(p.y - s.y / 2) - HITBOX_MARGIN);	m_hiy.push_back((float)(p.y + s.y / 2) + HITBOX_MARGIN);
+		m_loz.push_back((float)(p.z - s.z / 2) - HITBOX_MARGIN);	m_hiz.push_back((float)(p.z + s.z / 2) + HITBOX_MARGIN);
+		m_box.push_back(i);
+	}
+	m_count = (int)m_box.size();
+
+	// empty boxes round the arrays up to a whole AVX register; nothing overlaps them
+	while (m_box.size() % 8) {
+		m_lox.push_back(FLT_MAX);	m_hix.push_back(-FLT_MAX);
+		m_loy.push_back(FLT_MAX);	m_hiy.push_back(-FLT_MAX);
+		m_loz.push_back(FLT_MAX);	m_hiz.push_back(-FLT_MAX);
+		m_box.push_back(-1);
+	}
+}
+
+void CHitboxBatch::overlaps(const HitboxQuery* queries, int count, std::vector<HitboxHit>& out) const {
+	if (m_count == 0 || count == 0) return;
+	BoxArrays b = { m_lox.data(), m_hix.data(), m_loy.data(), m_hiy.data(), m_loz.data(), m_hiz.data(), m_box.data(), (int)m_box.size() };
+	switch (getKernel()) {
+#ifdef HITBOX_X86
+	case KERNEL_AVX2: overlapsAvx2(b, queries, count, out); break;
+	case KERNEL_SSE2: overlapsSse2(b, queries, count, out); break;
+#endif
+	default: overlapsScalar(b, queries, count, out); break;
+	}
+}
+
+}
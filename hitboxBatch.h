@@ -0,0 +1,63 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: hitboxBatch.h
+//
+// Desc: Enemy hitboxes as float structure-of-arrays, tested against a batch of bullets at
+//       once with AVX2 or SSE2 (scalar elsewhere), eight or four boxes per compare. A query
+//       is the bounding box of a bullet over its step; the result is every (bullet, enemy,
+//       head / body) pair whose boxes overlap. The float bounds are widened by
+//       HITBOX_MARGIN, so the test never misses a touch the double precision tests would
+//       report; callers confirm the pairs it returns with those tests.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __hitboxBatchH__
+#define __hitboxBatchH__
+
+#include "simShapes.h"
+#include <vector>
+
+#define HITBOX_MARGIN (1.0f / 64)   // well above float rounding for coordinates up to 16k
+
+namespace sim
+{
+	enum HitboxKernel { KERNEL_AUTO, KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+
+	struct HitboxQuery
+	{
+		float lo[3], hi[3];
+		int projectile;
+	};
+
+	struct HitboxHit
+	{
+		int projectile;
+		int enemy;
+		bool head;
+	};
+
+	class CHitboxBatch {
+	public:
+		CHitboxBatch(void);
+
+		// boxes[2 * i] is enemy i's body, boxes[2 * i + 1] its head; boxes with their off[]
+		// entry set are left out
+		void build(const CWall* boxes, const unsigned char* off, int count);
+		int size() const { return m_count; }
+
+		// appends the overlapping pairs to out, by query and then by box index
+		void overlaps(const HitboxQuery* queries, int count, std::vector<HitboxHit>& out) const;
+
+		// KERNEL_AUTO picks the widest one this CPU runs; a kernel it lacks falls back to scalar
+		static void setKernel(HitboxKernel kernel);
+		static HitboxKernel getKernel();
+		static const char* getKernelName(HitboxKernel kernel);
+
+	private:
+		std::vector<float>	m_lox, m_hix, m_loy, m_hiy, m_loz, m_hiz;     // padded to 8 with empty boxes
+		std::vector<int>	m_box;
+		int					m_count;
+	};
+}
+
+#endif // __hitboxBatchH__
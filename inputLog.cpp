@@ -0,0 +1,157 @@
+#include "inputLog.h"
+#include <cstring>
+
+namespace sim
+{
+
+enum { BUTTON_FORWARD = 1, BUTTON_BACK = 2, BUTTON_LEFT = 4, BUTTON_RIGHT = 8, BUTTON_FIRE = 16, BUTTON_LOOK = 32 };
+
+static size_t putVarint(unsigned char* out, int value) {
+	uint32_t v = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);      // zigzag: small negatives stay short
+	size_t n = 0;
+	while (v >= 0x80) {
+		out[n++] = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	out[n++] = (unsigned char)v;
+	return n;
+}
+
+static bool getVarint(const unsigned char*& p, const unsigned char* end, int& value) {
+	uint32_t v = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		if (p >= end) return false;
+		const unsigned char b = *p++;
+		v |= (uint32_t)(b & 0x7f) << shift;
+		if (!(b & 0x80)) {
+			value = (int)(v >> 1) ^ -(int)(v & 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+CInputLog::CInputLog(void) {
+	m_file = NULL;
+	memset(&m_header, 0, sizeof(m_header));
+	m_recordBytes = 0;
+}
+
+CInputLog::~CInputLog(void) {
+	close();
+}
+
+bool CInputLog::create(const char* path, const CWorld& world, unsigned int seed, double hz, const char* level) {
+	close();
+	m_file = fopen(path, "wb");
+	if (m_file == NULL) return false;
+
+	m_level = level ? level : "";
+	memset(&m_header, 0, sizeof(m_header));
+	memcpy(m_header.magic, INPUT_LOG_MAGIC, 4);
+	m_header.version = INPUT_LOG_VERSION;
+	m_header.flags = (world.getBroadphase() ? LOG_BROADPHASE : 0) | (world.getContinuous() ? LOG_CONTINUOUS : 0) |
+		(world.getMergeWalls() ? LOG_MERGE_WALLS : 0) | (world.getCulling() ? LOG_CULLING : 0) |
+		(world.getLineOfSight() ? LOG_LINE_OF_SIGHT : 0) | (world.getChase() ? LOG_CHASE : 0);
+	m_header.seed = seed;
+	m_header.burst = world.getEnemyBurst();
+	m_header.hz = hz;
+	m_header.level_length = (uint32_t)m_level.size();
+	m_recordBytes = 0;
+
+	if (fwrite(&m_header, sizeof(m_header), 1, m_file) != 1 ||
+		fwrite(m_level.data(), 1, m_level.size(), m_file) != m_level.size()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void CInputLog::record(const Input& input, unsigned long long stateHash) {
+	if (m_file == NULL) return;
+	unsigned char buffer[16];
+	size_t n = 1;
+	buffer[0] = (input.forward ? BUTTON_FORWARD : 0) | (input.back ? BUTTON_BACK : 0) | (input.left ? BUTTON_LEFT : 0) |
+		(input.right ? BUTTON_RIGHT : 0) | (input.fire ? BUTTON_FIRE : 0);
+	if (input.look_h != 0 || input.look_v != 0) {
+		buffer[0] |= BUTTON_LOOK;
+		n += putVarint(buffer + n, input.look_h);
+		n += putVarint(buffer + n, input.look_v);
+	}
+	const uint32_t hash = foldHash(stateHash);
+	memcpy(buffer + n, &hash, 4);
+	n += 4;
+	fwrite(buffer, 1, n, m_file);
+	m_recordBytes += n;
+}
+
+void CInputLog::close() {
+	if (m_file == NULL) return;
+	fclose(m_file);
+	m_file = NULL;
+}
+
+bool CInputLog::open(const char* path) {
+	close();
+	m_inputs.clear();
+	m_hashes.clear();
+	m_level.clear();
+	m_recordBytes = 0;
+
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) return false;
+	std::vector<unsigned char> data;
+	unsigned char chunk[65536];
+	size_t got;
+	while ((got = fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + got);
+	fclose(f);
+
+	if (data.size() < sizeof(InputLogHeader)) return false;
+	memcpy(&m_header, &data[0], sizeof(m_header));
+	if (memcmp(m_header.magic, INPUT_LOG_MAGIC, 4) != 0 || m_header.version != INPUT_LOG_VERSION) return false;
+	if (m_header.hz <= 0 || data.size() - sizeof(m_header) < m_header.level_length) return false;
+	const unsigned char* p = &data[0] + sizeof(m_header);
+	const unsigned char* end = &data[0] + data.size();
+	m_level.assign((const char*)p, m_header.level_length);
+	p += m_header.level_length;
+	m_recordBytes = end - p;
+
+	// a record cut off at the end of the file is dropped
+	for (;;) {
+		const unsigned char* record = p;
+		if (p >= end) break;
+		const unsigned char buttons = *p++;
+		Input input;
+		input.forward = (buttons & BUTTON_FORWARD) != 0;
+		input.back = (buttons & BUTTON_BACK) != 0;
+		input.left = (buttons & BUTTON_LEFT) != 0;
+		input.right = (buttons & BUTTON_RIGHT) != 0;
+		input.fire = (buttons & BUTTON_FIRE) != 0;
+		if ((buttons & BUTTON_LOOK) && (!getVarint(p, end, input.look_h) || !getVarint(p, end, input.look_v))) {
+			m_recordBytes -= end - record;
+			break;
+		}
+		if (end - p < 4) {
+			m_recordBytes -= end - record;
+			break;
+		}
+		uint32_t hash;
+		memcpy(&hash, p, 4);
+		p += 4;
+		m_inputs.push_back(input);
+		m_hashes.push_back(hash);
+	}
+	return true;
+}
+
+void CInputLog::apply(CWorld& world) const {
+	world.setBroadphase((m_header.flags & LOG_BROADPHASE) != 0);
+	world.setContinuous((m_header.flags & LOG_CONTINUOUS) != 0);
+	world.setMergeWalls((m_header.flags & LOG_MERGE_WALLS) != 0);
+	world.setCulling((m_header.flags & LOG_CULLING) != 0);
+	world.setLineOfSight((m_header.flags & LOG_LINE_OF_SIGHT) != 0);
+	world.setChase((m_header.flags & LOG_CHASE) != 0);
+	world.setEnemyBurst(m_header.burst);
+}
+
+}
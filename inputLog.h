@@ -0,0 +1,91 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: inputLog.h
+//
+// Desc: Binary log of a play session (.vli): everything needed to run it again tick for
+//       tick, and a state hash after every tick to prove the rerun matched. A file is a
+//       fixed header, the level name, then one variable length record per tick:
+//
+//           InputLogHeader
+//           level    level_length bytes, empty for the built-in level
+//           ticks    buttons (1 byte: forward, back, left, right, fire, mouse moved)
+//                    look_h, look_v as zigzag varints, only when the mouse moved
+//                    low 32 bits of CWorld::getStateHash() (4 bytes)
+//
+//       Records are written as the game runs, so a log that was cut off is still
+//       readable up to its last whole tick. Integers are little endian.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __inputLogH__
+#define __inputLogH__
+
+#include "gameSim.h"
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace sim
+{
+	#define INPUT_LOG_MAGIC "VLIR"
+	#define INPUT_LOG_VERSION 2      // 2: the state hash covers the look direction and bullet ages
+
+	// world settings that change what a tick does
+	enum InputLogFlags
+	{
+		LOG_BROADPHASE = 1, LOG_CONTINUOUS = 2, LOG_MERGE_WALLS = 4, LOG_CULLING = 8,
+		LOG_LINE_OF_SIGHT = 16, LOG_CHASE = 32
+	};
+
+	struct InputLogHeader
+	{
+		char		magic[4];
+		uint16_t	version;
+		uint16_t	flags;          // InputLogFlags
+		uint32_t	seed;           // what srand() was given
+		int32_t		burst;
+		double		hz;
+		uint32_t	level_length;
+		uint32_t	reserved;
+	};
+
+	class CInputLog {
+	public:
+		CInputLog(void);
+		~CInputLog(void);
+
+		// writing: the header takes the world's current settings
+		bool create(const char* path, const CWorld& world, unsigned int seed, double hz, const char* level);
+		void record(const Input& input, unsigned long long stateHash);
+		void close();
+		bool isRecording() const { return m_file != NULL; }
+
+		// reading: the whole log into memory
+		bool open(const char* path);
+		// the recorded settings, to be applied before the world is loaded
+		void apply(CWorld& world) const;
+
+		int getTicks() const { return (int)m_inputs.size(); }
+		const Input& getInput(int tick) const { return m_inputs[tick]; }
+		uint32_t getHash(int tick) const { return m_hashes[tick]; }
+		static uint32_t foldHash(unsigned long long stateHash) { return (uint32_t)stateHash; }
+
+		unsigned int getSeed() const { return m_header.seed; }
+		double getHz() const { return m_header.hz; }
+		// empty for the built-in level
+		const std::string& getLevel() const { return m_level; }
+		// bytes of tick records, to see how compact the log is
+		size_t getRecordBytes() const { return m_recordBytes; }
+
+	private:
+		FILE*				m_file;
+		InputLogHeader		m_header;
+		std::string			m_level;
+		std::vector<Input>	m_inputs;
+		std::vector<uint32_t>	m_hashes;
+		size_t				m_recordBytes;
+	};
+}
+
+#endif // __inputLogH__
@@ -0,0 +1,123 @@
+#include "jobSystem.h"
+#include "profiler.h"
+#include <string>
+
+namespace sim
+{
+
+CJobSystem::CJobSystem(void) : m_threads(1), m_pending(0), m_steals(0), m_quit(false) {
+	m_queues.push_back(new Queue);
+}
+
+CJobSystem::~CJobSystem(void) {
+	stop();
+	for (size_t i = 0; i < m_queues.size(); i++) delete m_queues[i];
+}
+
+void CJobSystem::start(int threads) {
+	stop();
+	if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+	if (threads < 1) threads = 1;
+
+	m_quit = false;
+	m_threads = threads;
+	while ((int)m_queues.size() < threads) m_queues.push_back(new Queue);
+	for (int i = 1; i < threads; i++) m_workers.push_back(std::thread(&CJobSystem::workerMain, this, i));
+}
+
+void CJobSystem::stop() {
+	if (m_workers.empty()) return;
+	{
+		std::lock_guard<std::mutex> guard(m_sleepLock);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++) m_workers[i].join();
+	m_workers.clear();
+	m_threads = 1;
+}
+
+void CJobSystem::parallelFor(int count, int grain, ChunkFn fn, void* context) {
+	if (grain < 1) grain = 1;
+	const int chunks = chunksFor(count, grain);
+	if (chunks == 0) return;
+	if (chunks == 1 || m_workers.empty()) {
+		for (int c = 0; c < chunks; c++) fn(context, c, c * grain, c == chunks - 1 ? count : (c + 1) * grain);
+		return;
+	}
+
+	Task task;
+	task.fn = fn;
+	task.context = context;
+	task.count = count;
+	task.grain = grain;
+	task.remaining = chunks;
+
+	// deal the chunks out in runs, so neighbouring chunks start on the same thread
+	const int threads = getThreads();
+	for (int t = 0; t < threads; t++) {
+		const int first = chunks * t / threads, last = chunks * (t + 1) / threads;
+		std::lock_guard<std::mutex> guard(m_queues[t]->lock);
+		for (int c = first; c < last; c++) {
+			Job job = { &task, c };
+			m_queues[t]->jobs.push_front(job);
+		}
+	}
+	{
+		std::lock_guard<std::mutex> guard(m_sleepLock);
+		m_pending += chunks;
+	}
+	m_wake.notify_all();
+
+	Job job;
+	while (take(0, job)) run(job);
+	while (task.remaining.load() > 0) std::this_thread::yield();
+}
+
+// own deque from the back, then everybody else's from the front
+bool CJobSystem::take(int self, Job& job) {
+	const int threads = getThreads();
+	for (int k = 0; k < threads; k++) {
+		const int q = (self + k) % threads;
+		std::lock_guard<std::mutex> guard(m_queues[q]->lock);
+		std::deque<Job>& jobs = m_queues[q]->jobs;
+		if (jobs.empty()) continue;
+		if (k == 0) {
+			job = jobs.back();
+			jobs.pop_back();
+		}
+		else {
+			job = jobs.front();
+			jobs.pop_front();
+			m_steals++;
+		}
+		m_pending--;
+		return true;
+	}
+	return false;
+}
+
+void CJobSystem::run(const Job& job) {
+	PROFILE_SCOPE("job");
+	Task& task = *job.task;
+	const int begin = job.chunk * task.grain;
+	const int end = begin + task.grain < task.count ? begin + task.grain : task.count;
+	task.fn(task.context, job.chunk, begin, end);
+	task.remaining--;
+}
+
+void CJobSystem::workerMain(int self) {
+	CProfiler::setThreadName(("worker " + std::to_string(self)).c_str());
+	for (;;) {
+		Job job;
+		if (take(self, job)) {
+			run(job);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_sleepLock);
+		m_wake.wait(lock, [this] { return m_quit || m_pending.load() > 0; });
+		if (m_quit) return;
+	}
+}
+
+}
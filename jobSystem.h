@@ -0,0 +1,90 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: jobSystem.h
+//
+// Desc: Small work-stealing thread pool for data parallel loops. parallelFor() cuts a
+//       range into fixed chunks and deals them out over one deque per thread; a thread
+//       takes from the back of its own deque and steals from the front of the others
+//       when it runs dry. The calling thread works along and returns when every chunk
+//       is done. Chunk boundaries only depend on the count and the grain, so results
+//       written per chunk can be merged in a fixed order whatever thread ran them.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __jobSystemH__
+#define __jobSystemH__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sim
+{
+	class CJobSystem {
+	public:
+		// fn(chunk, begin, end) for one chunk of a parallelFor
+		typedef void (*ChunkFn)(void* context, int chunk, int begin, int end);
+
+		CJobSystem(void);
+		~CJobSystem(void);
+
+		// total threads including the caller, 0 for one per hardware thread; 1 runs
+		// everything on the calling thread
+		void start(int threads);
+		void stop();
+		int getThreads() const { return m_threads; }
+
+		static int chunksFor(int count, int grain) { return count <= 0 ? 0 : (count + grain - 1) / grain; }
+		// runs fn over [0, count) in chunks of grain items and waits for all of them; a
+		// range of a single chunk runs inline without waking anybody
+		void parallelFor(int count, int grain, ChunkFn fn, void* context);
+
+		template <class F>
+		void parallelFor(int count, int grain, F& body) {
+			parallelFor(count, grain, &callBody<F>, &body);
+		}
+
+		// chunks run by a thread other than the one that was dealt them
+		long long getSteals() const { return m_steals.load(); }
+
+	private:
+		struct Task
+		{
+			ChunkFn fn;
+			void* context;
+			int count, grain;
+			std::atomic<int> remaining;
+		};
+		struct Job
+		{
+			Task* task;
+			int chunk;
+		};
+		struct Queue
+		{
+			std::mutex lock;
+			std::deque<Job> jobs;
+		};
+
+		template <class F>
+		static void callBody(void* context, int chunk, int begin, int end) { (*(F*)context)(chunk, begin, end); }
+
+		void workerMain(int self);
+		bool take(int self, Job& job);
+		void run(const Job& job);
+
+		int							m_threads;      // set before the workers start, they read it
+		std::vector<std::thread>	m_workers;
+		std::vector<Queue*>			m_queues;       // [0] belongs to the calling thread
+		std::mutex					m_sleepLock;
+		std::condition_variable		m_wake;
+		std::atomic<int>			m_pending;      // queued jobs nobody has taken yet
+		std::atomic<long long>		m_steals;
+		bool						m_quit;
+	};
+}
+
+#endif // __jobSystemH__
@@ -0,0 +1,78 @@
+#include "levelBatch.h"
+#include <algorithm>
+
+namespace render
+{
+
+static const int BOX_VERTICES = 24;
+static const int MAX_BATCH_VERTICES = 65536;
+
+// one face: outward normal and the two axes spanning it
+static const float faces[6][3][3] = {
+	{ { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+	{ { -1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+	{ { 0, 1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+	{ { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+	{ { 0, 0, 1 }, { 1, 0, 0 }, { 0, 1, 0 } },
+	{ { 0, 0, -1 }, { 1, 0, 0 }, { 0, 1, 0 } },
+};
+
+// Direct3D front faces are clockwise: the winding normal has to point outwards
+void appendQuad(StaticBatch& batch, const Vertex* quad) {
+	const unsigned short base = (unsigned short)batch.vertices.size();
+	batch.vertices.insert(batch.vertices.end(), quad, quad + 4);
+	Float3 e1(quad[1].x - quad[0].x, quad[1].y - quad[0].y, quad[1].z - quad[0].z);
+	Float3 e2(quad[2].x - quad[0].x, quad[2].y - quad[0].y, quad[2].z - quad[0].z);
+	const bool outward = dot(cross(e1, e2), Float3(quad[0].nx, quad[0].ny, quad[0].nz)) > 0;
+	const unsigned short tri[6] = { 0, 1, 2, 0, 2, 3 };
+	for (int k = 0; k < 6; k++)
+		batch.indices.push_back((unsigned short)(base + (outward ? tri[k] : tri[5 - k])));
+}
+
+static void appendBox(StaticBatch& batch, const Float3& center, const Float3& size) {
+	const float h[3] = { size.x / 2, size.y / 2, size.z / 2 };
+	const float c[3] = { center.x, center.y, center.z };
+	for (int f = 0; f < 6; f++) {
+		const float* n = faces[f][0];
+		const float* u = faces[f][1];
+		const float* v = faces[f][2];
+		const float corner[4][2] = { { -1, -1 }, { -1, 1 }, { 1, 1 }, { 1, -1 } };
+		Vertex quad[4];
+		for (int k = 0; k < 4; k++) {
+			Vertex& vx = quad[k];
+			float p[3];
+			for (int a = 0; a < 3; a++) p[a] = c[a] + (n[a] + u[a] * corner[k][0] + v[a] * corner[k][1]) * h[a];
+			vx.x = p[0];	vx.y = p[1];	vx.z = p[2];
+			vx.nx = n[0];	vx.ny = n[1];	vx.nz = n[2];
+			vx.color = 0xffffffff;
+		}
+		appendQuad(batch, quad);
+	}
+}
+
+void CStaticBatcher::addBox(const Float3& center, const Float3& size, const Material& material, int chunk) {
+	if (chunk + 1 >= (int)m_byChunk.size()) m_byChunk.resize(chunk + 2);
+	std::vector<int>& candidates = m_byChunk[chunk + 1];
+	StaticBatch* batch = NULL;
+	for (size_t i = 0; i < candidates.size(); i++) {
+		StaticBatch& b = m_batches[candidates[i]];
+		if (b.material == material && b.vertices.size() + BOX_VERTICES <= (size_t)MAX_BATCH_VERTICES) batch = &b;
+	}
+	if (batch == NULL) {
+		candidates.push_back((int)m_batches.size());
+		m_batches.push_back(StaticBatch());
+		batch = &m_batches.back();
+		batch->chunk = chunk;
+		batch->material = material;
+	}
+	appendBox(*batch, center, size);
+
+	Float3& lo = batch->lo;
+	Float3& hi = batch->hi;
+	lo.x = std::min(lo.x, center.x - size.x / 2);	hi.x = std::max(hi.x, center.x + size.x / 2);
+	lo.y = std::min(lo.y, center.y - size.y / 2);	hi.y = std::max(hi.y, center.y + size.y / 2);
+	lo.z = std::min(lo.z, center.z - size.z / 2);	hi.z = std::max(hi.z, center.z + size.z / 2);
+	m_boxes++;
+}
+
+}
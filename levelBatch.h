@@ -0,0 +1,53 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: levelBatch.h
+//
+// Desc: Bakes geometry that never moves (walls, floor, flag) into a few merged
+//       vertex/index buffers at load time, one batch per material, so the level is drawn
+//       with a handful of draw calls instead of one per wall. CLightBaker (lightBaker.h)
+//       fills batches of its own whose light is already in the vertex colors.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __levelBatchH__
+#define __levelBatchH__
+
+#include "renderBackend.h"
+#include <vector>
+
+namespace render
+{
+	struct StaticBatch
+	{
+		StaticBatch() : chunk(-1), baked(false), lo(1e30f, 1e30f, 1e30f), hi(-1e30f, -1e30f, -1e30f) {}
+
+		int							chunk;          // -1 = always drawn
+		bool						baked;          // drawn unlit with its vertex colors
+		Float3						lo, hi;         // world space bounds
+		Material					material;
+		std::vector<Vertex>			vertices;
+		std::vector<unsigned short>	indices;
+	};
+
+	// two triangles over quad[0..3], wound so quad[0]'s normal faces the camera
+	void appendQuad(StaticBatch& batch, const Vertex* quad);
+
+	class CStaticBatcher {
+	public:
+		CStaticBatcher(void) : m_boxes(0) {}
+
+		// box in world space; one batch per chunk and material, split when 16 bit indices run out
+		void addBox(const Float3& center, const Float3& size, const Material& material, int chunk = -1);
+		void clear() { m_batches.clear(); m_byChunk.clear(); m_boxes = 0; }
+
+		const std::vector<StaticBatch>& getBatches() const { return m_batches; }
+		int getBoxCount() const { return m_boxes; }
+
+	private:
+		std::vector<StaticBatch>	m_batches;
+		std::vector<std::vector<int> >	m_byChunk;  // batch indices per chunk + 1
+		int							m_boxes;
+	};
+}
+
+#endif // __levelBatchH__
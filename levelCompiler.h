@@ -0,0 +1,170 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: levelCompiler.h
+//
+// Desc: Compile-time version of CLevel::fromRows() for levels built into the executable.
+//       countLevel() measures an ASCII map and checks its layout, compileLevel() turns it
+//       into a complete .lvl image (header, cells, merged wall boxes, spawns, lights) laid out
+//       byte for byte like a file, which CLevel::openImage() then uses in place:
+//
+//           constexpr LevelCounts counts = countLevel(rows);
+//           static_assert(counts.players == 1, "...");
+//           static constexpr auto image = compileLevel<counts.wall_count, counts.spawn_count,
+//               counts.light_count>(rows);
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __levelCompilerH__
+#define __levelCompilerH__
+
+#include "levelFile.h"
+#include <cstddef>
+
+namespace sim
+{
+	struct LevelCounts
+	{
+		uint32_t	wall_cells;
+		uint32_t	wall_count;     // boxes after merging
+		uint32_t	spawn_count;
+		uint32_t	light_count;
+		int			players;        // 'P' cells
+		int			flags;          // 'F' cells
+		bool		rectangular;    // no row shorter than the first
+		bool		closed;         // every border cell is a wall
+	};
+
+	// a .lvl file in memory; the arrays are padded so each section starts where the
+	// header says it does
+	template <uint32_t Cols, uint32_t Rows, uint32_t Walls, uint32_t Spawns, uint32_t Lights>
+	struct LevelImage
+	{
+		static const size_t CELL_BYTES = ((Cols + 1) / 2 * (size_t)Rows + 7) & ~(size_t)7;
+
+		LevelHeader		header;
+		unsigned char	cells[CELL_BYTES];
+		LevelRect		walls[Walls ? Walls : 1];
+		LevelCell		spawns[Spawns ? Spawns : 1];
+		LevelLight		lights[Lights ? Lights : 1];
+	};
+
+	namespace detail
+	{
+		// same boxes as mergeWalls() in levelFile.cpp: each unused '1' cell, in row order,
+		// grows right as far as it can, then down while the whole span below is wall.
+		// Returns the number of boxes, writing them to out when it is not NULL.
+		template <size_t Rows, size_t Cols>
+		constexpr uint32_t mergeWalls(const char (&rows)[Rows][Cols], LevelRect* out) {
+			const size_t cols = Cols - 1;
+			bool used[Rows * (Cols - 1)] = {};
+			uint32_t count = 0;
+			for (size_t row = 0; row < Rows; row++) {
+				for (size_t col = 0; col < cols; col++) {
+					if (rows[row][col] != '1' || used[row * cols + col]) continue;
+
+					size_t last_col = col;
+					while (last_col + 1 < cols && rows[row][last_col + 1] == '1' && !used[row * cols + last_col + 1]) last_col++;
+					size_t last_row = row;
+					for (bool grow = true; grow && last_row + 1 < Rows; ) {
+						for (size_t c = col; c <= last_col; c++) {
+							if (rows[last_row + 1][c] != '1' || used[(last_row + 1) * cols + c]) {
+								grow = false;
+								break;
+							}
+						}
+						if (grow) last_row++;
+					}
+
+					for (size_t r = row; r <= last_row; r++)
+						for (size_t c = col; c <= last_col; c++) used[r * cols + c] = true;
+
+					if (out) {
+						out[count].col = (uint32_t)col;
+						out[count].row = (uint32_t)row;
+						out[count].cols = (uint32_t)(last_col - col + 1);
+						out[count].rows = (uint32_t)(last_row - row + 1);
+					}
+					count++;
+				}
+			}
+			return count;
+		}
+	}
+
+	// Cols counts the '\0' of every row literal
+	template <size_t Rows, size_t Cols>
+	constexpr LevelCounts countLevel(const char (&rows)[Rows][Cols]) {
+		LevelCounts counts = { 0, 0, 0, 0, 0, 0, true, true };
+		const size_t cols = Cols - 1;
+		for (size_t row = 0; row < Rows; row++) {
+			if (rows[row][cols - 1] == '\0') counts.rectangular = false;
+			for (size_t col = 0; col < cols; col++) {
+				const char c = rows[row][col];
+				if (c == '1') counts.wall_cells++;
+				else if (c == 'e') counts.spawn_count++;
+				else if (c == 'L') counts.light_count++;
+				else if (c == 'P') counts.players++;
+				else if (c == 'F') counts.flags++;
+				if ((row == 0 || row == Rows - 1 || col == 0 || col == cols - 1) && c != '1') counts.closed = false;
+			}
+		}
+		counts.wall_count = detail::mergeWalls(rows, (LevelRect*)NULL);
+		return counts;
+	}
+
+	// Walls, Spawns and Lights must be the counts countLevel() gave for the same rows
+	template <uint32_t Walls, uint32_t Spawns, uint32_t Lights, size_t Rows, size_t Cols>
+	constexpr LevelImage<(uint32_t)(Cols - 1), (uint32_t)Rows, Walls, Spawns, Lights> compileLevel(const char (&rows)[Rows][Cols]) {
+		typedef LevelImage<(uint32_t)(Cols - 1), (uint32_t)Rows, Walls, Spawns, Lights> Image;
+		static_assert(sizeof(LevelHeader) % 8 == 0 && sizeof(LevelRect) % 8 == 0 && sizeof(LevelCell) % 8 == 0 &&
+			sizeof(LevelLight) % 8 == 0, "level sections would not stay 8 byte aligned");
+		static_assert(sizeof(Image) == sizeof(LevelHeader) + Image::CELL_BYTES + sizeof(LevelRect) * (Walls ? Walls : 1) +
+			sizeof(LevelCell) * (Spawns ? Spawns : 1) + sizeof(LevelLight) * (Lights ? Lights : 1),
+			"level image has padding the header does not know about");
+		Image image = {};
+		const size_t cols = Cols - 1;
+		const size_t stride = (cols + 1) / 2;
+
+		LevelHeader& h = image.header;
+		for (int i = 0; i < 4; i++) h.magic[i] = LEVEL_MAGIC[i];
+		h.version = LEVEL_VERSION;
+		h.cols = (uint32_t)cols;
+		h.rows = (uint32_t)Rows;
+		h.flag_col = h.flag_row = h.player_col = h.player_row = -1;
+		for (size_t row = 0; row < Rows; row++) {
+			for (size_t col = 0; col < cols; col++) {
+				unsigned char type = CELL_EMPTY;
+				switch (rows[row][col]) {
+				case '1': type = CELL_WALL; h.wall_cells++; break;
+				case 'e':
+					type = CELL_ENEMY;
+					image.spawns[h.spawn_count].col = (uint32_t)col;
+					image.spawns[h.spawn_count].row = (uint32_t)row;
+					h.spawn_count++;
+					break;
+				case 'F': type = CELL_FLAG; h.flag_col = (int32_t)col; h.flag_row = (int32_t)row; break;
+				case 'P': type = CELL_PLAYER; h.player_col = (int32_t)col; h.player_row = (int32_t)row; break;
+				case 'L':
+					image.lights[h.light_count].col = (uint32_t)col;
+					image.lights[h.light_count].row = (uint32_t)row;
+					image.lights[h.light_count].color = LIGHT_COLOR;
+					image.lights[h.light_count].range = LIGHT_RANGE;
+					h.light_count++;
+					break;
+				}
+				image.cells[row * stride + col / 2] |= (unsigned char)(type << ((col & 1) * 4));
+			}
+		}
+		h.wall_count = detail::mergeWalls(rows, image.walls);
+
+		// an empty table still takes one entry, which is then just padding in the file
+		h.cells_offset = sizeof(LevelHeader);
+		h.walls_offset = h.cells_offset + sizeof(image.cells);
+		h.spawns_offset = h.walls_offset + sizeof(image.walls);
+		h.lights_offset = h.spawns_offset + sizeof(image.spawns);
+		h.file_size = h.lights_offset + sizeof(image.lights);
+		return image;
+	}
+}
+
+#endif // __levelCompilerH__
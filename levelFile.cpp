@@ -0,0 +1,261 @@
+#include "levelFile.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sim
+{
+
+static size_t align8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+CLevel::CLevel(void) {
+	m_mapping = NULL;
+	m_size = 0;
+#ifdef _WIN32
+	m_fileHandle = NULL;
+	m_mapHandle = NULL;
+#endif
+	m_header = NULL;
+	m_cells = NULL;
+	m_stride = 0;
+	m_walls = NULL;
+	m_spawns = NULL;
+	m_lights = NULL;
+}
+
+CLevel::~CLevel(void) {
+	close();
+}
+
+void CLevel::close() {
+	if (m_mapping != NULL) {
+#ifdef _WIN32
+		UnmapViewOfFile(m_mapping);
+		CloseHandle((HANDLE)m_mapHandle);
+		CloseHandle((HANDLE)m_fileHandle);
+		m_mapHandle = m_fileHandle = NULL;
+#else
+		munmap(m_mapping, m_size);
+#endif
+		m_mapping = NULL;
+	}
+	m_owned.clear();
+	m_size = 0;
+	m_header = NULL;
+	m_cells = NULL;
+	m_walls = NULL;
+	m_spawns = NULL;
+	m_lights = NULL;
+}
+
+// count elements of elementSize bytes at offset lie inside size bytes; written so that
+// nothing can wrap around
+static bool fits(uint64_t offset, uint64_t count, size_t elementSize, size_t size) {
+	return offset <= size && count <= (size - offset) / elementSize;
+}
+
+// a cell of the grid, or -1, -1 for none
+static bool validCell(int32_t col, int32_t row, uint32_t cols, uint32_t rows) {
+	if (col == -1 && row == -1) return true;
+	return col >= 0 && row >= 0 && (uint32_t)col < cols && (uint32_t)row < rows;
+}
+
+// checks that the header and every table lie inside the image before anything reads them
+bool CLevel::bind(const unsigned char* data, size_t size) {
+	if (size < sizeof(LevelHeader)) return false;
+	const LevelHeader* h = (const LevelHeader*)data;
+	if (memcmp(h->magic, LEVEL_MAGIC, 4) != 0 || h->version != LEVEL_VERSION) return false;
+	if (h->cols == 0 || h->rows == 0 || h->file_size != size) return false;
+
+	const uint64_t stride = (h->cols + 1) / 2;
+	if (h->cols > INT32_MAX || h->rows > INT32_MAX) return false;
+	if (h->cells_offset < sizeof(LevelHeader) || !fits(h->cells_offset, stride * h->rows, 1, size)) return false;
+	if (h->walls_offset % 8 || !fits(h->walls_offset, h->wall_count, sizeof(LevelRect), size)) return false;
+	if (h->spawns_offset % 8 || !fits(h->spawns_offset, h->spawn_count, sizeof(LevelCell), size)) return false;
+	if (h->lights_offset % 8 || !fits(h->lights_offset, h->light_count, sizeof(LevelLight), size)) return false;
+	if (!validCell(h->flag_col, h->flag_row, h->cols, h->rows)) return false;
+	if (!validCell(h->player_col, h->player_row, h->cols, h->rows)) return false;
+	// sizes the unmerged walls; whether it matches the grid is checked when they are built
+	if (h->wall_cells > (uint64_t)h->cols * h->rows) return false;
+
+	const LevelRect* walls = (const LevelRect*)(data + h->walls_offset);
+	for (uint32_t i = 0; i < h->wall_count; i++) {
+		if (walls[i].cols == 0 || walls[i].rows == 0 ||
+			(uint64_t)walls[i].col + walls[i].cols > h->cols || (uint64_t)walls[i].row + walls[i].rows > h->rows) return false;
+	}
+	const LevelCell* spawns = (const LevelCell*)(data + h->spawns_offset);
+	for (uint32_t i = 0; i < h->spawn_count; i++) {
+		if (spawns[i].col >= h->cols || spawns[i].row >= h->rows) return false;
+	}
+	const LevelLight* lights = (const LevelLight*)(data + h->lights_offset);
+	for (uint32_t i = 0; i < h->light_count; i++) {
+		if (lights[i].col >= h->cols || lights[i].row >= h->rows || !(lights[i].range > 0)) return false;
+	}
+
+	m_header = h;
+	m_cells = data + h->cells_offset;
+	m_stride = (size_t)stride;
+	m_walls = walls;
+	m_spawns = spawns;
+	m_lights = lights;
+	m_size = size;
+	return true;
+}
+
+bool CLevel::open(const char* path) {
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (view == NULL) {
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	m_fileHandle = file;
+	m_mapHandle = mapping;
+	m_mapping = view;
+	m_size = (size_t)size.QuadPart;
+#else
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED) return false;
+	m_mapping = view;
+	m_size = (size_t)st.st_size;
+#endif
+	if (!bind((const unsigned char*)m_mapping, m_size)) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool CLevel::openImage(const void* data, size_t size) {
+	close();
+	return bind((const unsigned char*)data, size);
+}
+
+// covers the '1' cells with boxes: each unused cell, in row order, grows right as far as
+// it can, then down while the whole span below is wall (levelCompiler.h does the same)
+static void mergeWalls(const std::vector<std::string>& rows, size_t cols, std::vector<LevelRect>& out) {
+	std::vector<unsigned char> used(rows.size() * cols, 0);
+	for (size_t row = 0; row < rows.size(); row++) {
+		for (size_t col = 0; col < cols; col++) {
+			if (rows[row][col] != '1' || used[row * cols + col]) continue;
+
+			size_t last_col = col;
+			while (last_col + 1 < cols && rows[row][last_col + 1] == '1' && !used[row * cols + last_col + 1]) last_col++;
+			size_t last_row = row;
+			for (bool grow = true; grow && last_row + 1 < rows.size(); ) {
+				for (size_t c = col; c <= last_col; c++) {
+					if (rows[last_row + 1][c] != '1' || used[(last_row + 1) * cols + c]) {
+						grow = false;
+						break;
+					}
+				}
+				if (grow) last_row++;
+			}
+
+			for (size_t r = row; r <= last_row; r++)
+				memset(&used[r * cols + col], 1, last_col - col + 1);
+
+			LevelRect rect = { (uint32_t)col, (uint32_t)row, (uint32_t)(last_col - col + 1), (uint32_t)(last_row - row + 1) };
+			out.push_back(rect);
+		}
+	}
+}
+
+bool CLevel::fromRows(const std::vector<std::string>& rows) {
+	close();
+	if (rows.empty() || rows[0].empty()) return false;
+	const size_t cols = rows[0].size();
+	for (size_t r = 0; r < rows.size(); r++)
+		if (rows[r].size() != cols) return false;
+
+	LevelHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, LEVEL_MAGIC, 4);
+	h.version = LEVEL_VERSION;
+	h.cols = (uint32_t)cols;
+	h.rows = (uint32_t)rows.size();
+	h.flag_col = h.flag_row = h.player_col = h.player_row = -1;
+
+	const size_t stride = (cols + 1) / 2;
+	std::vector<unsigned char> cells(stride * rows.size(), 0);
+	std::vector<LevelCell> spawns;
+	std::vector<LevelLight> lights;
+	for (size_t r = 0; r < rows.size(); r++) {
+		for (size_t c = 0; c < cols; c++) {
+			LevelCellType type = CELL_EMPTY;
+			switch (rows[r][c]) {
+			case '1': type = CELL_WALL; h.wall_cells++; break;
+			case 'e': {
+				type = CELL_ENEMY;
+				LevelCell spawn = { (uint32_t)c, (uint32_t)r };
+				spawns.push_back(spawn);
+				break;
+			}
+			case 'F': type = CELL_FLAG; h.flag_col = (int32_t)c; h.flag_row = (int32_t)r; break;
+			case 'P': type = CELL_PLAYER; h.player_col = (int32_t)c; h.player_row = (int32_t)r; break;
+			case 'L': {
+				LevelLight light = { (uint32_t)c, (uint32_t)r, LIGHT_COLOR, LIGHT_RANGE };
+				lights.push_back(light);
+				break;
+			}
+			}
+			cells[r * stride + c / 2] |= (unsigned char)(type << ((c & 1) * 4));
+		}
+	}
+	std::vector<LevelRect> walls;
+	mergeWalls(rows, cols, walls);
+	h.wall_count = (uint32_t)walls.size();
+	h.spawn_count = (uint32_t)spawns.size();
+	h.light_count = (uint32_t)lights.size();
+
+	h.cells_offset = align8(sizeof(LevelHeader));
+	h.walls_offset = align8((size_t)h.cells_offset + cells.size());
+	h.spawns_offset = align8((size_t)h.walls_offset + walls.size() * sizeof(LevelRect));
+	h.lights_offset = align8((size_t)h.spawns_offset + spawns.size() * sizeof(LevelCell));
+	h.file_size = align8((size_t)h.lights_offset + lights.size() * sizeof(LevelLight));
+
+	m_owned.assign((size_t)h.file_size / 8, 0);
+	unsigned char* image = (unsigned char*)&m_owned[0];
+	memcpy(image, &h, sizeof(h));
+	memcpy(image + h.cells_offset, &cells[0], cells.size());
+	if (!walls.empty()) memcpy(image + h.walls_offset, &walls[0], walls.size() * sizeof(LevelRect));
+	if (!spawns.empty()) memcpy(image + h.spawns_offset, &spawns[0], spawns.size() * sizeof(LevelCell));
+	if (!lights.empty()) memcpy(image + h.lights_offset, &lights[0], lights.size() * sizeof(LevelLight));
+	return bind(image, (size_t)h.file_size);
+}
+
+bool CLevel::save(const char* path) const {
+	if (m_header == NULL) return false;
+	FILE* f = fopen(path, "wb");
+	if (f == NULL) return false;
+	bool ok = fwrite(m_header, 1, m_size, f) == m_size;
+	return fclose(f) == 0 && ok;
+}
+
+}
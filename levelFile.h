@@ -0,0 +1,143 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: levelFile.h
+//
+// Desc: Binary level format (.lvl) and the read-only view the simulation loads from.
+//       A file is a fixed header followed by a 4 bit per cell grid and the tables the
+//       loader needs (merged wall rectangles, enemy spawns, static lights), all laid out so
+//       the file can be memory-mapped and used in place without any parsing:
+//
+//           LevelHeader
+//           cells    rows * ((cols + 1) / 2) bytes, low nibble = even column
+//           walls    wall_count   x LevelRect
+//           spawns   spawn_count  x LevelCell
+//           lights   light_count  x LevelLight
+//
+//       Every section starts 8 byte aligned. Integers are little endian.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __levelFileH__
+#define __levelFileH__
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace sim
+{
+	enum LevelCellType { CELL_EMPTY = 0, CELL_WALL = 1, CELL_ENEMY = 2, CELL_FLAG = 3, CELL_PLAYER = 4 };
+
+	#define LEVEL_MAGIC "VLVL"
+	#define LEVEL_VERSION 2
+
+	struct LevelHeader
+	{
+		char		magic[4];
+		uint32_t	version;
+		uint32_t	cols, rows;
+		uint32_t	wall_cells;         // '1' cells before merging
+		uint32_t	wall_count;
+		uint32_t	spawn_count;
+		int32_t		flag_col, flag_row;     // -1 when the level has none
+		int32_t		player_col, player_row;
+		uint32_t	light_count;
+		uint64_t	cells_offset;
+		uint64_t	walls_offset;
+		uint64_t	spawns_offset;
+		uint64_t	lights_offset;
+		uint64_t	file_size;
+	};
+
+	// wall cells covered by one box, in cells
+	struct LevelRect
+	{
+		uint32_t col, row, cols, rows;
+	};
+
+	struct LevelCell
+	{
+		uint32_t col, row;
+	};
+
+	// a light hung under the ceiling over an open cell; only the renderer's baker reads it
+	#define LIGHT_COLOR 0xffffff
+	#define LIGHT_RANGE 10.0f   // cells
+
+	struct LevelLight
+	{
+		uint32_t	col, row;
+		uint32_t	color;      // 0xRRGGBB
+		float		range;      // cells
+	};
+
+	class CLevel {
+	public:
+		CLevel(void);
+		~CLevel(void);
+
+		// maps a .lvl file read-only; false if it is missing or malformed
+		bool open(const char* path);
+		// builds the same image in memory from ASCII rows of equal length
+		// ('1' wall, 'e' enemy, 'F' flag, 'P' player start, 'L' light over an empty cell,
+		// anything else empty)
+		bool fromRows(const std::vector<std::string>& rows);
+		// uses an image of a .lvl file in place, e.g. one made by compileLevel(); it must
+		// outlive the level
+		bool openImage(const void* data, size_t size);
+		bool save(const char* path) const;
+		void close();
+
+		bool isOpen() const { return m_header != NULL; }
+		bool isMapped() const { return m_mapping != NULL; }
+		int getCols() const { return (int)m_header->cols; }
+		int getRows() const { return (int)m_header->rows; }
+
+		// CELL_WALL outside the grid, so walking off the map reads as a wall
+		LevelCellType cell(int row, int col) const {
+			if (row < 0 || col < 0 || row >= (int)m_header->rows || col >= (int)m_header->cols) return CELL_WALL;
+			unsigned char b = m_cells[(size_t)row * m_stride + (col >> 1)];
+			return (LevelCellType)((col & 1) ? b >> 4 : b & 15);
+		}
+
+		int getWallCells() const { return (int)m_header->wall_cells; }
+		int getWallCount() const { return (int)m_header->wall_count; }
+		const LevelRect& getWall(int i) const { return m_walls[i]; }
+		int getSpawnCount() const { return (int)m_header->spawn_count; }
+		const LevelCell& getSpawn(int i) const { return m_spawns[i]; }
+		int getLightCount() const { return (int)m_header->light_count; }
+		const LevelLight& getLight(int i) const { return m_lights[i]; }
+		bool hasFlag() const { return m_header->flag_col >= 0; }
+		bool hasPlayer() const { return m_header->player_col >= 0; }
+		int getFlagCol() const { return m_header->flag_col; }
+		int getFlagRow() const { return m_header->flag_row; }
+		int getPlayerCol() const { return m_header->player_col; }
+		int getPlayerRow() const { return m_header->player_row; }
+
+		size_t getSize() const { return m_size; }
+
+	private:
+		CLevel(const CLevel&);
+		CLevel& operator=(const CLevel&);
+
+		bool bind(const unsigned char* data, size_t size);
+
+		std::vector<uint64_t>	m_owned;        // image built by fromRows
+		void*					m_mapping;      // or the start of the mapped file
+		size_t					m_size;
+#ifdef _WIN32
+		void*					m_fileHandle;
+		void*					m_mapHandle;
+#endif
+
+		const LevelHeader*		m_header;
+		const unsigned char*	m_cells;
+		size_t					m_stride;
+		const LevelRect*		m_walls;
+		const LevelCell*		m_spawns;
+		const LevelLight*		m_lights;
+	};
+}
+
+#endif // __levelFileH__
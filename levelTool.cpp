@@ -0,0 +1,133 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: levelTool.cpp
+//
+// Desc: Converts ASCII layouts (one row per line, '1' wall, 'e' enemy, 'F' flag,
+//       'P' player start, 'L' light) into the binary .lvl format, generates seeded mazes
+//       of any size (mazeGenerator.h) and prints what a .lvl contains.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gameSim.h"
+#include "mazeGenerator.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static void usage(const char* argv0) {
+	printf("usage: %s <layout.txt | --builtin> <out.lvl>\n", argv0);
+	printf("       %s --generate COLSxROWS [--seed S] [--density D] [--enemies N] [--lights N] [--tile T] [--threads T] <out.lvl>\n", argv0);
+	printf("       %s --info <level.lvl>\n", argv0);
+}
+
+static bool readRows(const char* path, std::vector<std::string>& rows) {
+	std::ifstream in(path);
+	if (!in) return false;
+	std::string line;
+	while (std::getline(in, line)) {
+		if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+		if (!line.empty()) rows.push_back(line);
+	}
+	return true;
+}
+
+static int info(const char* path) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	sim::CLevel level;
+	if (!level.open(path)) {
+		fprintf(stderr, "%s: not a valid level file\n", path);
+		return 1;
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	printf("size         %d x %d cells, %zu bytes\n", level.getCols(), level.getRows(), level.getSize());
+	printf("walls        %d boxes from %d wall cells\n", level.getWallCount(), level.getWallCells());
+	printf("enemies      %d\n", level.getSpawnCount());
+	printf("lights       %d\n", level.getLightCount());
+	if (level.hasPlayer()) printf("player       col %d, row %d\n", level.getPlayerCol(), level.getPlayerRow());
+	else printf("player       none\n");
+	if (level.hasFlag()) printf("flag         col %d, row %d\n", level.getFlagCol(), level.getFlagRow());
+	else printf("flag         none\n");
+	printf("open         %.3f ms\n", ms);
+	return 0;
+}
+
+static int convert(const std::vector<std::string>& rows, const char* source, const char* path) {
+	sim::CLevel level;
+	if (!level.fromRows(rows)) {
+		fprintf(stderr, "%s: rows must be non-empty and of equal length\n", source);
+		return 1;
+	}
+	if (!level.hasPlayer()) fprintf(stderr, "warning: no player start ('P')\n");
+	if (!level.save(path)) {
+		fprintf(stderr, "%s: cannot write\n", path);
+		return 1;
+	}
+	printf("%s: %d x %d, %d wall boxes from %d cells, %d enemies, %d lights\n", path, level.getCols(), level.getRows(),
+		level.getWallCount(), level.getWallCells(), level.getSpawnCount(), level.getLightCount());
+	return 0;
+}
+
+static int generate(int argc, char* argv[]) {
+	sim::MazeSettings settings;
+	int threads = 0;
+	const char* path = NULL;
+	if (sscanf(argv[2], "%dx%d", &settings.cols, &settings.rows) != 2) {
+		usage(argv[0]);
+		return 1;
+	}
+	for (int i = 3; i < argc; i++) {
+		if (!strcmp(argv[i], "--seed") && i + 1 < argc) settings.seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--density") && i + 1 < argc) settings.wall_density = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--enemies") && i + 1 < argc) settings.enemies = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--lights") && i + 1 < argc) settings.lights = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--tile") && i + 1 < argc) settings.tile = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = atoi(argv[++i]);
+		else if (i == argc - 1) path = argv[i];
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (path == NULL) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	sim::CMazeGenerator generator;
+	generator.setThreads(threads);
+	std::vector<std::string> rows;
+	if (!generator.generate(settings, rows)) {
+		fprintf(stderr, "--generate: needs at least 5 x 5 cells, a density from 0 to 1 and counts >= 0\n");
+		return 1;
+	}
+	const sim::MazeStats& stats = generator.getStats();
+	printf("generated    %d x %d, seed %u, %d tiles on %d threads in %.1f ms\n", settings.cols, settings.rows, settings.seed,
+		stats.tiles, stats.threads, stats.ms);
+	printf("walls        %.1f%% of the cells\n", 100.0 * stats.wall_cells / ((double)settings.cols * settings.rows));
+	printf("path         %d cells from P to F\n", stats.path);
+	if (stats.enemies < settings.enemies) fprintf(stderr, "warning: only room for %d enemies\n", stats.enemies);
+	if (stats.lights < settings.lights) fprintf(stderr, "warning: only room for %d lights\n", stats.lights);
+	return convert(rows, "--generate", path);
+}
+
+int main(int argc, char* argv[]) {
+	if (argc == 3 && !strcmp(argv[1], "--info")) return info(argv[2]);
+	if (argc >= 4 && !strcmp(argv[1], "--generate")) return generate(argc, argv);
+	if (argc != 3) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<std::string> rows;
+	if (!strcmp(argv[1], "--builtin")) rows.assign(sim::builtin_map, sim::builtin_map + MAP_SIZE);
+	else if (!readRows(argv[1], rows)) {
+		fprintf(stderr, "%s: cannot read\n", argv[1]);
+		return 1;
+	}
+	return convert(rows, argv[1], argv[2]);
+}
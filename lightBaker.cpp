@@ -0,0 +1,241 @@
+#include "lightBaker.h"
+#include "jobSystem.h"
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+namespace render
+{
+
+static const float AMBIENT = 0.25f;
+static const float LIGHT_DROP = 0.5f;      // lamps hang this far under the top of the walls
+static const float SHADOW_NUDGE = 0.01f;   // shadow rays end this far towards the lamp
+static const float aoLevels[4] = { 1.0f, 0.8f, 0.65f, 0.5f };  // by wall cells at a corner
+
+// a lamp in world space
+struct BakeLight
+{
+	float x, y, z;
+	float r, g, b;
+	float range;            // world units
+};
+
+struct BakeContext
+{
+	const sim::CLevel*	level;
+	int					cols, rows;
+	int					chunkCells, chunkCols;
+	double				originX, originZ;
+	float				floorY;
+	Color				color;
+	std::vector<BakeLight>	lights;
+	std::vector<std::vector<int> >	lightsByChunk;  // lamps whose range reaches the chunk
+
+	bool isWall(int row, int col) const { return level->cell(row, col) == sim::CELL_WALL; }
+	// grid coordinates: columns grow with x, rows against z
+	float worldX(double col) const { return (float)(originX + col * WORLD_SIZE); }
+	float worldZ(double row) const { return (float)(originZ - row * WORLD_SIZE); }
+};
+
+// walks the cells the segment from a lamp to (x, z) passes; false when one is a wall
+static bool reaches(const BakeContext& ctx, const BakeLight& light, float x, float z) {
+	const double c0 = (light.x - ctx.originX) / WORLD_SIZE, r0 = (ctx.originZ - light.z) / WORLD_SIZE;
+	const double c1 = (x - ctx.originX) / WORLD_SIZE, r1 = (ctx.originZ - z) / WORLD_SIZE;
+	int col = (int)floor(c0), row = (int)floor(r0);
+	const int lastCol = (int)floor(c1), lastRow = (int)floor(r1);
+	const double dc = c1 - c0, dr = r1 - r0;
+	const int stepCol = dc > 0 ? 1 : -1, stepRow = dr > 0 ? 1 : -1;
+	const double deltaCol = dc != 0 ? fabs(1 / dc) : 1e30, deltaRow = dr != 0 ? fabs(1 / dr) : 1e30;
+	double nextCol = dc > 0 ? (col + 1 - c0) / dc : dc < 0 ? (c0 - col) / -dc : 1e30;
+	double nextRow = dr > 0 ? (row + 1 - r0) / dr : dr < 0 ? (r0 - row) / -dr : 1e30;
+	for (int n = abs(lastCol - col) + abs(lastRow - row); n > 0; n--) {
+		if (nextCol < nextRow) {
+			col += stepCol;
+			nextCol += deltaCol;
+		}
+		else {
+			row += stepRow;
+			nextRow += deltaRow;
+		}
+		if (ctx.isWall(row, col)) return false;
+	}
+	return true;
+}
+
+static unsigned int toByte(float v) {
+	return v >= 1.0f ? 255u : v <= 0.0f ? 0u : (unsigned int)(v * 255.0f + 0.5f);
+}
+
+// ambient plus every lamp in range that sees the point, darkened by ao
+static unsigned int shade(const BakeContext& ctx, const std::vector<int>& lights, float x, float y, float z,
+	float nx, float ny, float nz, float ao) {
+	float r = AMBIENT, g = AMBIENT, b = AMBIENT;
+	for (size_t i = 0; i < lights.size(); i++) {
+		const BakeLight& l = ctx.lights[lights[i]];
+		const float dx = l.x - x, dy = l.y - y, dz = l.z - z;
+		const float d2 = dx * dx + dy * dy + dz * dz;
+		if (d2 >= l.range * l.range || d2 <= 0) continue;
+		const float d = sqrtf(d2);
+		const float lambert = (dx * nx + dy * ny + dz * nz) / d;
+		if (lambert <= 0) continue;
+		const float flat = sqrtf(dx * dx + dz * dz);
+		const float ex = flat > 0 ? x + dx / flat * SHADOW_NUDGE : x, ez = flat > 0 ? z + dz / flat * SHADOW_NUDGE : z;
+		if (!reaches(ctx, l, ex, ez)) continue;
+		float falloff = 1 - d / l.range;
+		falloff *= falloff * lambert;
+		r += l.r * falloff;
+		g += l.g * falloff;
+		b += l.b * falloff;
+	}
+	return 0xff000000u | toByte(r * ao * ctx.color.r) << 16 | toByte(g * ao * ctx.color.g) << 8 | toByte(b * ao * ctx.color.b);
+}
+
+static Vertex vertex(float x, float y, float z, float nx, float ny, float nz, unsigned int color) {
+	Vertex v;
+	v.x = x;	v.y = y;	v.z = z;
+	v.nx = nx;	v.ny = ny;	v.nz = nz;
+	v.color = color;
+	return v;
+}
+
+// the open sides of the chunk's wall cells and its floor cells
+static void bakeChunk(const BakeContext& ctx, int chunk, StaticBatch& batch) {
+	const std::vector<int>& lights = ctx.lightsByChunk[chunk];
+	const int row0 = chunk / ctx.chunkCols * ctx.chunkCells, col0 = chunk % ctx.chunkCols * ctx.chunkCells;
+	const int row1 = std::min(row0 + ctx.chunkCells, ctx.rows), col1 = std::min(col0 + ctx.chunkCells, ctx.cols);
+	batch.chunk = chunk;
+	batch.baked = true;
+	batch.material = Material(ctx.color);
+
+	// floor corners are shared by up to four cells, so each is shaded once
+	const int stride = col1 - col0 + 1;
+	std::vector<unsigned int> corners((size_t)stride * (row1 - row0 + 1), 0);
+	Vertex quad[4];
+	for (int row = row0; row < row1; row++) {
+		for (int col = col0; col < col1; col++) {
+			if (ctx.isWall(row, col)) continue;
+			const int cr[4] = { row, row, row + 1, row + 1 }, cc[4] = { col, col + 1, col + 1, col };
+			for (int k = 0; k < 4; k++) {
+				unsigned int& c = corners[(size_t)(cr[k] - row0) * stride + (cc[k] - col0)];
+				if (c == 0) {
+					const int walls = ctx.isWall(cr[k] - 1, cc[k] - 1) + ctx.isWall(cr[k] - 1, cc[k]) +
+						ctx.isWall(cr[k], cc[k] - 1) + ctx.isWall(cr[k], cc[k]);
+					c = shade(ctx, lights, ctx.worldX(cc[k]), ctx.floorY, ctx.worldZ(cr[k]), 0, 1, 0, aoLevels[walls]);
+				}
+				quad[k] = vertex(ctx.worldX(cc[k]), ctx.floorY, ctx.worldZ(cr[k]), 0, 1, 0, c);
+			}
+			appendQuad(batch, quad);
+		}
+	}
+
+	// a wall side is drawn when the cell in front of it is open; its corners darken towards
+	// the floor and where another wall meets it
+	static const int sides[4][2] = { { 0, 1 }, { 0, -1 }, { 1, 0 }, { -1, 0 } };     // row, col outwards
+	for (int row = row0; row < row1; row++) {
+		for (int col = col0; col < col1; col++) {
+			if (!ctx.isWall(row, col)) continue;
+			for (int s = 0; s < 4; s++) {
+				const int dr = sides[s][0], dc = sides[s][1];
+				if (ctx.isWall(row + dr, col + dc)) continue;
+				const float nx = (float)dc, nz = (float)-dr;
+				const double faceRow = row + 0.5 + dr * 0.5, faceCol = col + 0.5 + dc * 0.5;
+				for (int k = 0; k < 4; k++) {
+					const int t = (k == 0 || k == 3) ? -1 : 1;       // along the face
+					const bool bottom = k < 2;
+					const int tr = dc != 0 ? t : 0, tc = dr != 0 ? t : 0;
+					const int corner = ctx.isWall(row + dr + tr, col + dc + tc);
+					const float x = ctx.worldX(faceCol + tc * 0.5), z = ctx.worldZ(faceRow + tr * 0.5);
+					const float y = bottom ? ctx.floorY : (float)WALL_HEIGHT;
+					quad[k] = vertex(x, y, z, nx, 0, nz, shade(ctx, lights, x, y, z, nx, 0, nz, aoLevels[corner + bottom]));
+				}
+				appendQuad(batch, quad);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < batch.vertices.size(); i++) {
+		const Vertex& v = batch.vertices[i];
+		batch.lo.x = std::min(batch.lo.x, v.x);	batch.hi.x = std::max(batch.hi.x, v.x);
+		batch.lo.y = std::min(batch.lo.y, v.y);	batch.hi.y = std::max(batch.hi.y, v.y);
+		batch.lo.z = std::min(batch.lo.z, v.z);	batch.hi.z = std::max(batch.hi.z, v.z);
+	}
+}
+
+struct BakeJob
+{
+	const BakeContext* ctx;
+	StaticBatch* batches;   // one per chunk
+	void operator()(int, int begin, int end) {
+		for (int chunk = begin; chunk < end; chunk++) bakeChunk(*ctx, chunk, batches[chunk]);
+	}
+};
+
+CLightBaker::CLightBaker(void) {
+	m_threads = 0;
+	m_stats.lights = m_stats.quads = m_stats.threads = 0;
+	m_stats.vertices = 0;
+	m_stats.ms = 0;
+}
+
+void CLightBaker::bake(const sim::CWorld& world, int chunkCells, const Color& color, std::vector<StaticBatch>& out) {
+	PROFILE_SCOPE("bake lighting");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const sim::CLevel& level = world.getLevel();
+	BakeContext ctx;
+	ctx.level = &level;
+	ctx.cols = world.getCols();
+	ctx.rows = world.getRows();
+	ctx.chunkCells = chunkCells;
+	ctx.chunkCols = (ctx.cols + chunkCells - 1) / chunkCells;
+	const int chunkRows = (ctx.rows + chunkCells - 1) / chunkCells;
+	ctx.originX = -ctx.cols * WORLD_SIZE / 2.0;
+	ctx.originZ = ctx.rows * WORLD_SIZE / 2.0;
+	const sim::CWall& plane = world.getPlane();
+	ctx.floorY = (float)(plane.getPosition().y + plane.getSize().y / 2);
+	ctx.color = color;
+
+	// each lamp is listed with every chunk its range square touches
+	ctx.lightsByChunk.resize((size_t)ctx.chunkCols * chunkRows);
+	for (int i = 0; i < level.getLightCount(); i++) {
+		const sim::LevelLight& src = level.getLight(i);
+		BakeLight l;
+		l.x = ctx.worldX(src.col + 0.5);
+		l.y = (float)WALL_HEIGHT - LIGHT_DROP;
+		l.z = ctx.worldZ(src.row + 0.5);
+		l.r = ((src.color >> 16) & 255) / 255.0f;
+		l.g = ((src.color >> 8) & 255) / 255.0f;
+		l.b = (src.color & 255) / 255.0f;
+		l.range = src.range * WORLD_SIZE;
+		ctx.lights.push_back(l);
+
+		const int reach = (int)ceil(src.range);
+		const int cr0 = std::max(0, ((int)src.row - reach) / chunkCells), cr1 = std::min(chunkRows - 1, ((int)src.row + reach) / chunkCells);
+		const int cc0 = std::max(0, ((int)src.col - reach) / chunkCells), cc1 = std::min(ctx.chunkCols - 1, ((int)src.col + reach) / chunkCells);
+		for (int cr = cr0; cr <= cr1; cr++)
+			for (int cc = cc0; cc <= cc1; cc++) ctx.lightsByChunk[(size_t)cr * ctx.chunkCols + cc].push_back(i);
+	}
+
+	std::vector<StaticBatch> batches(ctx.lightsByChunk.size());
+	sim::CJobSystem jobs;
+	jobs.start(m_threads);
+	BakeJob job = { &ctx, &batches[0] };
+	jobs.parallelFor((int)batches.size(), 4, job);
+	m_stats.threads = jobs.getThreads();
+	jobs.stop();
+
+	m_stats.lights = (int)ctx.lights.size();
+	m_stats.quads = 0;
+	m_stats.vertices = 0;
+	for (size_t i = 0; i < batches.size(); i++) {
+		if (batches[i].vertices.empty()) continue;
+		m_stats.quads += (int)batches[i].vertices.size() / 4;
+		m_stats.vertices += batches[i].vertices.size();
+		out.push_back(StaticBatch());
+		std::swap(out.back(), batches[i]);
+	}
+	m_stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
@@ -0,0 +1,52 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: lightBaker.h
+//
+// Desc: Bakes the level's static lights (LevelLight) into the walls and floor at load
+//       time. Every open side of a wall cell and every floor cell becomes a quad of its
+//       own, and each corner gets the light of every lamp in range that the map grid does
+//       not hide from it, times an ambient occlusion term from the wall cells around the
+//       corner, packed into the vertex color. Chunks of the map bake independently on a
+//       CJobSystem, so the bake spreads over every core; drawing the result costs no
+//       lights at all.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __lightBakerH__
+#define __lightBakerH__
+
+#include "gameSim.h"
+#include "levelBatch.h"
+#include <vector>
+
+namespace render
+{
+	struct BakeStats
+	{
+		int			lights;
+		int			quads;
+		long long	vertices;
+		int			threads;
+		double		ms;
+	};
+
+	class CLightBaker {
+	public:
+		CLightBaker(void);
+
+		// as CJobSystem::start(): 0 for one per hardware thread
+		void setThreads(int threads) { m_threads = threads; }
+
+		// one batch per chunk of chunkCells x chunkCells map cells that has anything to draw,
+		// appended in chunk order; chunks are numbered row by row like the renderer's
+		void bake(const sim::CWorld& world, int chunkCells, const Color& color, std::vector<StaticBatch>& out);
+
+		const BakeStats& getStats() const { return m_stats; }
+
+	private:
+		int			m_threads;
+		BakeStats	m_stats;
+	};
+}
+
+#endif // __lightBakerH__
@@ -0,0 +1,94 @@
+#include "lineOfSight.h"
+#include <cmath>
+#include <cstdlib>
+
+namespace sim
+{
+
+void CLineOfSight::build(const CLevel& level) {
+	clear();
+	if (!level.isOpen()) return;
+	m_cols = level.getCols();
+	m_rows = level.getRows();
+	m_walls.resize((size_t)m_cols * m_rows);
+	for (int row = 0; row < m_rows; row++)
+		for (int col = 0; col < m_cols; col++) m_walls[(size_t)row * m_cols + col] = level.cell(row, col) == CELL_WALL;
+}
+
+void CLineOfSight::clear() {
+	m_cols = m_rows = 0;
+	m_walls.clear();
+	m_cache.clear();
+}
+
+// grid walk between the two cell centers; where the ray passes exactly through a cell
+// corner both side cells have to be open
+bool CLineOfSight::march(int fromRow, int fromCol, int toRow, int toCol, LosStats& stats) const {
+	if (fromRow < 0 || fromCol < 0 || fromRow >= m_rows || fromCol >= m_cols) return false;
+	if (toRow < 0 || toCol < 0 || toRow >= m_rows || toCol >= m_cols) return false;
+
+	const int dc = toCol - fromCol, dr = toRow - fromRow;
+	const int step_col = dc > 0 ? 1 : -1, step_row = dr > 0 ? 1 : -1;
+	// both centers sit at .5, so the first border crossing on each axis is half a cell away
+	const double t_delta_x = dc != 0 ? 1.0 / abs(dc) : 1e30;
+	const double t_delta_y = dr != 0 ? 1.0 / abs(dr) : 1e30;
+	double t_max_x = t_delta_x / 2, t_max_y = t_delta_y / 2;
+
+	int col = fromCol, row = fromRow;
+	while (col != toCol || row != toRow) {
+		stats.cells_marched++;
+		if (t_max_x < t_max_y - 1e-12) {
+			col += step_col;
+			t_max_x += t_delta_x;
+		}
+		else if (t_max_y < t_max_x - 1e-12) {
+			row += step_row;
+			t_max_y += t_delta_y;
+		}
+		else {
+			if (isWall(row, col + step_col) || isWall(row + step_row, col)) return false;
+			col += step_col;
+			row += step_row;
+			t_max_x += t_delta_x;
+			t_max_y += t_delta_y;
+		}
+		if ((col != toCol || row != toRow) && isWall(row, col)) return false;
+	}
+	return true;
+}
+
+void CLineOfSight::reserve(int slots) {
+	if ((int)m_cache.size() >= slots) return;
+	Slot empty;
+	empty.key.from_row = empty.key.from_col = empty.key.to_row = empty.key.to_col = -1;
+	empty.visible = false;
+	m_cache.resize(slots, empty);
+}
+
+void CLineOfSight::query(const LosQuery* queries, int count, unsigned char* visible) {
+	reserve(count);
+	query(queries, 0, count, visible, m_stats);
+}
+
+void CLineOfSight::query(const LosQuery* queries, int first, int count, unsigned char* visible, LosStats& stats) {
+	for (int i = first; i < first + count; i++) {
+		const LosQuery& q = queries[i];
+		Slot& slot = m_cache[i];
+		if (q.from_row < 0 || q.to_row < 0) {
+			// empty query: keep the slot for when its owner asks again
+			visible[i] = 0;
+			continue;
+		}
+		stats.queries++;
+		if (slot.key.from_row == q.from_row && slot.key.from_col == q.from_col &&
+			slot.key.to_row == q.to_row && slot.key.to_col == q.to_col) {
+			stats.cache_hits++;
+		}
+		else {
+			slot.key = q;
+			slot.visible = march(q.from_row, q.from_col, q.to_row, q.to_col, stats);
+		}
+		visible[i] = slot.visible;
+	}
+}
+}
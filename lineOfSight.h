@@ -0,0 +1,76 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: lineOfSight.h
+//
+// Desc: "Can A see B" between map cells, answered by marching a ray over the wall grid
+//       from cell center to cell center. Queries come in batches (every enemy against the
+//       player in one call); each query slot remembers its last pair of cells and answer,
+//       so a slot is only marched again when one of its two ends changes cell.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __lineOfSightH__
+#define __lineOfSightH__
+
+#include "levelFile.h"
+#include <vector>
+
+namespace sim
+{
+	struct LosQuery
+	{
+		int from_row, from_col;
+		int to_row, to_col;
+	};
+
+	struct LosStats
+	{
+		LosStats() { reset(); }
+		void reset() { queries = 0; cache_hits = 0; cells_marched = 0; }
+		void add(const LosStats& o) { queries += o.queries; cache_hits += o.cache_hits; cells_marched += o.cells_marched; }
+
+		long long queries;
+		long long cache_hits;
+		long long cells_marched;
+	};
+
+	class CLineOfSight {
+	public:
+		CLineOfSight(void) : m_cols(0), m_rows(0) {}
+
+		void build(const CLevel& level);
+		void clear();
+
+		// uncached; cells outside the grid never see anything
+		bool canSee(int fromRow, int fromCol, int toRow, int toCol) { return march(fromRow, fromCol, toRow, toCol, m_stats); }
+		// visible[i] = answer for queries[i]; slot i of the cache belongs to queries[i];
+		// a query with a negative row is skipped and answers false
+		void query(const LosQuery* queries, int count, unsigned char* visible);
+		// the same for the slots [first, first + count) only, counting into stats; disjoint
+		// ranges may run on different threads once reserve() has made room for every slot
+		void query(const LosQuery* queries, int first, int count, unsigned char* visible, LosStats& stats);
+		void reserve(int slots);
+		void resetCache() { m_cache.clear(); }
+
+		const LosStats& getStats() const { return m_stats; }
+		void addStats(const LosStats& stats) { m_stats.add(stats); }
+		void resetStats() { m_stats.reset(); }
+
+	private:
+		struct Slot
+		{
+			LosQuery key;
+			bool visible;
+		};
+
+		bool march(int fromRow, int fromCol, int toRow, int toCol, LosStats& stats) const;
+		bool isWall(int row, int col) const { return m_walls[row * m_cols + col] != 0; }
+
+		int							m_cols, m_rows;
+		std::vector<unsigned char>	m_walls;
+		std::vector<Slot>			m_cache;
+		LosStats					m_stats;
+	};
+}
+
+#endif // __lineOfSightH__
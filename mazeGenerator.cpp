@@ -0,0 +1,224 @@
+#include "mazeGenerator.h"
+#include "jobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+namespace sim
+{
+
+static const int SPAWN_CLEARANCE = 8;     // no enemy this close to the player start, in cells
+
+// splitmix64; seeded per tile and pass so the streams do not depend on the thread
+struct MazeRandom
+{
+	MazeRandom(uint32_t seed, uint64_t stream) : state(((uint64_t)seed << 32) ^ (stream * 0x9e3779b97f4a7c15ull)) {}
+
+	uint64_t next() {
+		uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+	int below(int n) { return (int)(next() % (uint64_t)n); }
+	double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+	uint64_t state;
+};
+
+enum MazePass { PASS_CARVE, PASS_THIN, PASS_DOORS, PASS_PLACE };
+
+struct MazeContext
+{
+	const MazeSettings*	settings;
+	std::vector<std::string>*	rows;
+	int					tile;
+	int					tileCols;
+	int					roomRows, roomCols;     // rooms sit on odd cells inside the border
+
+	uint64_t stream(int tileIndex, MazePass pass) const { return (uint64_t)tileIndex * 4 + pass; }
+};
+
+// a depth first walk over the tile's rooms, opening the wall between each room and the
+// one it was reached from
+static void carveTile(const MazeContext& ctx, int tileIndex) {
+	std::vector<std::string>& rows = *ctx.rows;
+	const int half = ctx.tile / 2;
+	const int ty = tileIndex / ctx.tileCols, tx = tileIndex % ctx.tileCols;
+	const int rr0 = ty * half, rc0 = tx * half;
+	const int nr = std::min(half, ctx.roomRows - rr0), nc = std::min(half, ctx.roomCols - rc0);
+	if (nr <= 0 || nc <= 0) return;
+
+	MazeRandom random(ctx.settings->seed, ctx.stream(tileIndex, PASS_CARVE));
+	std::vector<unsigned char> seen((size_t)nr * nc, 0);
+	std::vector<int> stack;
+	const int start = random.below(nr * nc);
+	seen[start] = 1;
+	stack.push_back(start);
+	rows[(rr0 + start / nc) * 2 + 1][(rc0 + start % nc) * 2 + 1] = '0';
+	static const int steps[4][2] = { { 0, 1 }, { 0, -1 }, { 1, 0 }, { -1, 0 } };
+	while (!stack.empty()) {
+		const int room = stack.back();
+		const int r = room / nc, c = room % nc;
+		int options[4], count = 0;
+		for (int s = 0; s < 4; s++) {
+			const int nr2 = r + steps[s][0], nc2 = c + steps[s][1];
+			if (nr2 >= 0 && nr2 < nr && nc2 >= 0 && nc2 < nc && !seen[nr2 * nc + nc2]) options[count++] = s;
+		}
+		if (count == 0) {
+			stack.pop_back();
+			continue;
+		}
+		const int s = options[random.below(count)];
+		const int next = (r + steps[s][0]) * nc + c + steps[s][1];
+		seen[next] = 1;
+		stack.push_back(next);
+		const int gr = (rr0 + r) * 2 + 1, gc = (rc0 + c) * 2 + 1;
+		rows[gr + steps[s][0]][gc + steps[s][1]] = '0';
+		rows[gr + steps[s][0] * 2][gc + steps[s][1] * 2] = '0';
+	}
+}
+
+// knocks out inner walls of the tile at random until about the wanted share is left;
+// taking walls away never cuts a path
+static void thinTile(const MazeContext& ctx, int tileIndex) {
+	std::vector<std::string>& rows = *ctx.rows;
+	const int height = (int)rows.size(), width = (int)rows[0].size();
+	const int ty = tileIndex / ctx.tileCols, tx = tileIndex % ctx.tileCols;
+	const int r0 = std::max(1, ty * ctx.tile), r1 = std::min(height - 1, (ty + 1) * ctx.tile);
+	const int c0 = std::max(1, tx * ctx.tile), c1 = std::min(width - 1, (tx + 1) * ctx.tile);
+	if (r1 <= r0 || c1 <= c0) return;
+
+	long long walls = 0;
+	for (int r = r0; r < r1; r++)
+		for (int c = c0; c < c1; c++) walls += rows[r][c] == '1';
+	const double target = ctx.settings->wall_density * (double)(r1 - r0) * (c1 - c0);
+	if (walls == 0 || walls <= target) return;
+	const double knockOut = (walls - target) / walls;
+
+	MazeRandom random(ctx.settings->seed, ctx.stream(tileIndex, PASS_THIN));
+	for (int r = r0; r < r1; r++)
+		for (int c = c0; c < c1; c++)
+			if (rows[r][c] == '1' && random.unit() < knockOut) rows[r][c] = '0';
+}
+
+struct MazeJob
+{
+	const MazeContext* ctx;
+	void (*pass)(const MazeContext& ctx, int tileIndex);
+	void operator()(int, int begin, int end) {
+		for (int i = begin; i < end; i++) pass(*ctx, i);
+	}
+};
+
+// breadth first from the start; walk length to (toRow, toCol) or -1 when it cannot be reached
+static int walkLength(const std::vector<std::string>& rows, int fromRow, int fromCol, int toRow, int toCol) {
+	const int height = (int)rows.size(), width = (int)rows[0].size();
+	std::vector<unsigned char> seen((size_t)height * width, 0);
+	std::vector<int> frontier(1, fromRow * width + fromCol), next;
+	seen[frontier[0]] = 1;
+	for (int steps = 0; !frontier.empty(); steps++) {
+		next.clear();
+		for (size_t i = 0; i < frontier.size(); i++) {
+			const int r = frontier[i] / width, c = frontier[i] % width;
+			if (r == toRow && c == toCol) return steps;
+			const int around[4] = { frontier[i] - width, frontier[i] + width, frontier[i] - 1, frontier[i] + 1 };
+			for (int k = 0; k < 4; k++) {
+				const int n = around[k];
+				if (seen[n] || rows[n / width][n % width] == '1') continue;
+				seen[n] = 1;
+				next.push_back(n);
+			}
+		}
+		frontier.swap(next);
+	}
+	return -1;
+}
+
+// puts count copies of what on open cells away from the player start
+static int place(std::vector<std::string>& rows, MazeRandom& random, char what, int count, long long open, int startRow, int startCol) {
+	const int height = (int)rows.size(), width = (int)rows[0].size();
+	int placed = 0;
+	for (long long tries = 0; placed < count && tries < 8 * open + 1000; tries++) {
+		const int r = random.below(height), c = random.below(width);
+		if (rows[r][c] != '0') continue;
+		if (what == 'e' && abs(r - startRow) <= SPAWN_CLEARANCE && abs(c - startCol) <= SPAWN_CLEARANCE) continue;
+		rows[r][c] = what;
+		placed++;
+	}
+	return placed;
+}
+
+CMazeGenerator::CMazeGenerator(void) {
+	m_threads = 0;
+	m_stats.tiles = m_stats.threads = 0;
+	m_stats.wall_cells = 0;
+	m_stats.enemies = m_stats.lights = 0;
+	m_stats.path = -1;
+	m_stats.ms = 0;
+}
+
+bool CMazeGenerator::generate(const MazeSettings& settings, std::vector<std::string>& rows) {
+	rows.clear();
+	if (settings.cols < 5 || settings.rows < 5 || settings.tile < 2 || settings.enemies < 0 || settings.lights < 0) return false;
+	if (!(settings.wall_density >= 0 && settings.wall_density <= 1)) return false;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	MazeContext ctx;
+	ctx.settings = &settings;
+	ctx.rows = &rows;
+	ctx.tile = (settings.tile + 1) & ~1;
+	ctx.tileCols = (settings.cols + ctx.tile - 1) / ctx.tile;
+	const int tileRows = (settings.rows + ctx.tile - 1) / ctx.tile;
+	ctx.roomRows = (settings.rows - 1) / 2;
+	ctx.roomCols = (settings.cols - 1) / 2;
+	rows.assign(settings.rows, std::string(settings.cols, '1'));
+
+	CJobSystem jobs;
+	jobs.start(m_threads);
+	const int tiles = ctx.tileCols * tileRows;
+	MazeJob carve = { &ctx, &carveTile };
+	jobs.parallelFor(tiles, 1, carve);
+
+	// one door from each tile into its right and lower neighbour joins all the mazes
+	MazeRandom doors(settings.seed, ctx.stream(tiles, PASS_DOORS));
+	const int half = ctx.tile / 2;
+	for (int ty = 0; ty < tileRows; ty++) {
+		for (int tx = 0; tx < ctx.tileCols; tx++) {
+			const int rr0 = ty * half, rc0 = tx * half;
+			const int nr = std::min(half, ctx.roomRows - rr0), nc = std::min(half, ctx.roomCols - rc0);
+			if (nr <= 0 || nc <= 0) continue;
+			if (rc0 + half < ctx.roomCols) rows[(rr0 + doors.below(nr)) * 2 + 1][(rc0 + half) * 2] = '0';
+			if (rr0 + half < ctx.roomRows) rows[(rr0 + half) * 2][(rc0 + doors.below(nc)) * 2 + 1] = '0';
+		}
+	}
+
+	MazeJob thin = { &ctx, &thinTile };
+	jobs.parallelFor(tiles, 1, thin);
+	m_stats.threads = jobs.getThreads();
+	jobs.stop();
+
+	const int startRow = 1, startCol = 1;
+	const int flagRow = (ctx.roomRows - 1) * 2 + 1, flagCol = (ctx.roomCols - 1) * 2 + 1;
+	m_stats.path = walkLength(rows, startRow, startCol, flagRow, flagCol);
+	if (m_stats.path < 0) {
+		rows.clear();
+		return false;
+	}
+	rows[startRow][startCol] = 'P';
+	rows[flagRow][flagCol] = 'F';
+
+	long long open = 0;
+	for (size_t r = 0; r < rows.size(); r++) open += std::count(rows[r].begin(), rows[r].end(), '0');
+	MazeRandom random(settings.seed, ctx.stream(tiles, PASS_PLACE));
+	m_stats.enemies = place(rows, random, 'e', settings.enemies, open, startRow, startCol);
+	m_stats.lights = place(rows, random, 'L', settings.lights, open, startRow, startCol);
+
+	m_stats.tiles = tiles;
+	m_stats.wall_cells = 0;
+	for (size_t r = 0; r < rows.size(); r++) m_stats.wall_cells += std::count(rows[r].begin(), rows[r].end(), '1');
+	m_stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+}
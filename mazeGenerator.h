@@ -0,0 +1,66 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: mazeGenerator.h
+//
+// Desc: Seeded generator of maze levels of any size, as ASCII rows for CLevel::fromRows().
+//       The map is cut into square tiles that are carved on a CJobSystem in parallel: each
+//       tile is a perfect maze of its own (a depth first walk over the odd cells) and gets
+//       one door into its right and lower neighbours, so every open cell is connected and
+//       the flag can always be reached from the player start. Walls are then knocked out at
+//       random down to the wanted density. Every tile draws from its own random stream
+//       seeded from the seed and where the tile is, so the same settings give the same
+//       level on any number of threads.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __mazeGeneratorH__
+#define __mazeGeneratorH__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace sim
+{
+	struct MazeSettings
+	{
+		MazeSettings() : cols(256), rows(256), seed(1), wall_density(0.5), enemies(0), lights(0), tile(64) {}
+
+		int			cols, rows;         // at least 5 x 5
+		uint32_t	seed;
+		double		wall_density;       // share of wall cells; a perfect maze has about half, more is not possible
+		int			enemies;
+		int			lights;
+		int			tile;               // cells per tile side, rounded up to even
+	};
+
+	struct MazeStats
+	{
+		int			tiles;
+		int			threads;
+		long long	wall_cells;
+		int			enemies, lights;    // placed; fewer than asked when the maze is full
+		int			path;               // shortest walk from 'P' to 'F' in cells
+		double		ms;
+	};
+
+	class CMazeGenerator {
+	public:
+		CMazeGenerator(void);
+
+		// as CJobSystem::start(): 0 for one per hardware thread
+		void setThreads(int threads) { m_threads = threads; }
+
+		// '1' wall, '0' open, 'P' top left, 'F' bottom right, 'e' and 'L' on random open
+		// cells; false when the settings make no sense
+		bool generate(const MazeSettings& settings, std::vector<std::string>& rows);
+
+		const MazeStats& getStats() const { return m_stats; }
+
+	private:
+		int			m_threads;
+		MazeStats	m_stats;
+	};
+}
+
+#endif // __mazeGeneratorH__
@@ -0,0 +1,72 @@
+#include "meshCache.h"
+
+namespace render
+{
+
+enum { SHAPE_BOX, SHAPE_SPHERE };
+
+int sphereLodFor(float pixels) {
+	for (int i = 0; i < SPHERE_LODS - 1; i++)
+		if (pixels >= sphereLods[i].min_pixels) return i;
+	return SPHERE_LODS - 1;
+}
+
+bool CMeshCache::Key::operator<(const Key& o) const {
+	if (shape != o.shape) return shape < o.shape;
+	if (a != o.a) return a < o.a;
+	if (b != o.b) return b < o.b;
+	if (c != o.c) return c < o.c;
+	if (slices != o.slices) return slices < o.slices;
+	return stacks < o.stacks;
+}
+
+MeshHandle CMeshCache::box(float width, float height, float depth) {
+	Key key = { SHAPE_BOX, width, height, depth, 0, 0 };
+	return acquire(key);
+}
+
+MeshHandle CMeshCache::sphere(float radius, int slices, int stacks) {
+	Key key = { SHAPE_SPHERE, radius, 0, 0, slices, stacks };
+	return acquire(key);
+}
+
+MeshHandle CMeshCache::acquire(const Key& key) {
+	std::map<Key, Entry>::iterator it = m_entries.find(key);
+	if (it != m_entries.end()) {
+		it->second.refs++;
+		m_references++;
+		return it->second.mesh;
+	}
+	if (m_backend == NULL) return -1;
+
+	Entry e;
+	e.mesh = key.shape == SHAPE_BOX ? m_backend->createBox(key.a, key.b, key.c)
+		: m_backend->createSphere(key.a, key.slices, key.stacks);
+	if (e.mesh < 0) return -1;
+	e.refs = 1;
+	m_entries[key] = e;
+	m_keys[e.mesh] = key;
+	m_references++;
+	return e.mesh;
+}
+
+void CMeshCache::release(MeshHandle mesh) {
+	std::map<MeshHandle, Key>::iterator k = m_keys.find(mesh);
+	if (k == m_keys.end()) return;
+	std::map<Key, Entry>::iterator it = m_entries.find(k->second);
+	m_references--;
+	if (--it->second.refs > 0) return;
+	m_backend->releaseMesh(mesh);
+	m_entries.erase(it);
+	m_keys.erase(k);
+}
+
+void CMeshCache::clear() {
+	for (std::map<Key, Entry>::iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+		m_backend->releaseMesh(it->second.mesh);
+	m_entries.clear();
+	m_keys.clear();
+	m_references = 0;
+}
+
+}
@@ -0,0 +1,78 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: meshCache.h
+//
+// Desc: Reference counted meshes keyed by shape and dimensions, so every enemy body, wall
+//       box or bullet sphere of the same size shares one backend mesh. Also picks a sphere
+//       tessellation from the size the sphere covers on screen.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __meshCacheH__
+#define __meshCacheH__
+
+#include "renderBackend.h"
+#include <map>
+
+namespace render
+{
+	// sphere tessellations, finest first; a level is used while the sphere covers at
+	// least min_pixels across
+	struct SphereLod
+	{
+		int slices, stacks;
+		float min_pixels;
+	};
+
+	static const int SPHERE_LODS = 4;
+	static const SphereLod sphereLods[SPHERE_LODS] = {
+		{ 50, 50, 64.0f },
+		{ 24, 24, 16.0f },
+		{ 12, 12, 4.0f },
+		{ 6, 6, 0.0f },
+	};
+
+	// index into sphereLods for a sphere whose diameter covers `pixels` on screen
+	int sphereLodFor(float pixels);
+
+	class CMeshCache {
+	public:
+		CMeshCache(void) : m_backend(NULL), m_references(0) {}
+
+		void setBackend(IRenderBackend* backend) { m_backend = backend; }
+
+		// each call takes a reference; equal dimensions give back the same handle
+		MeshHandle box(float width, float height, float depth);
+		MeshHandle sphere(float radius, int slices, int stacks);
+		void release(MeshHandle mesh);
+		void clear();       // drops every mesh whatever its count
+
+		int getMeshes() const { return (int)m_entries.size(); }
+		int getReferences() const { return m_references; }
+
+	private:
+		struct Key
+		{
+			int shape;
+			float a, b, c;
+			int slices, stacks;
+
+			bool operator<(const Key& o) const;
+		};
+
+		struct Entry
+		{
+			MeshHandle mesh;
+			int refs;
+		};
+
+		MeshHandle acquire(const Key& key);
+
+		IRenderBackend*			m_backend;
+		std::map<Key, Entry>	m_entries;
+		std::map<MeshHandle, Key>	m_keys;
+		int						m_references;
+	};
+}
+
+#endif // __meshCacheH__
@@ -0,0 +1,129 @@
+#include "netClient.h"
+#include <utility>
+
+namespace sim
+{
+
+CNetClient::CNetClient(void) {
+	m_slot = -1;
+	m_refused = false;
+	m_hz = 60;
+	m_sequence = 0;
+	m_latest = 0;
+	m_received = 0;
+}
+
+CNetClient::~CNetClient(void) {
+	close();
+}
+
+bool CNetClient::connect(const NetAddress& server) {
+	close();
+	if (!m_socket.open(0, 0)) return false;
+	m_server = server;
+	m_slot = -1;
+	m_refused = false;
+	m_sequence = 0;
+	m_latest = 0;
+	m_received = 0;
+	m_history.clear();
+	m_buffer.resize(NET_MAX_DATAGRAM);
+	m_stats.reset();
+
+	m_out.clear();
+	m_out.putByte(NET_CONNECT);
+	m_out.putVarint(NET_PROTOCOL_VERSION);
+	send();
+	return true;
+}
+
+void CNetClient::close() {
+	if (m_socket.isOpen() && isConnected()) {
+		m_out.clear();
+		m_out.putByte(NET_DISCONNECT);
+		send();
+	}
+	m_socket.close();
+	m_slot = -1;
+}
+
+void CNetClient::send() {
+	if (m_socket.send(m_server, m_out.data(), m_out.size())) m_stats.bytes_sent += m_out.size();
+}
+
+void CNetClient::sendInput(const Input& input) {
+	if (!m_socket.isOpen() || m_refused) return;
+	m_out.clear();
+	if (!isConnected()) {
+		m_out.putByte(NET_CONNECT);
+		m_out.putVarint(NET_PROTOCOL_VERSION);
+	}
+	else writeInput(m_out, ++m_sequence, m_latest, input);
+	send();
+}
+
+bool CNetClient::receive(double now) {
+	const unsigned long before = m_stats.snapshots;
+	NetAddress from;
+	int size;
+	while ((size = m_socket.receive(from, m_buffer.data(), m_buffer.size())) > 0) {
+		if (from != m_server) continue;
+		m_stats.bytes_received += size;
+		CNetReader in(m_buffer.data(), (size_t)size);
+		const unsigned int type = in.getByte();
+		if (type == NET_WELCOME) {
+			const uint32_t version = in.getVarint(), slot = in.getVarint(), mhz = in.getVarint();
+			if (!in.isOk() || version != NET_PROTOCOL_VERSION || slot >= MAX_PLAYERS || mhz == 0) continue;
+			m_slot = (int)slot;
+			m_hz = mhz / 1000.0;
+		}
+		else if (type == NET_SNAPSHOT && isConnected()) handleSnapshot(in, now);
+		else if (type == NET_DISCONNECT) {
+			m_refused = !isConnected();
+			m_slot = -1;
+			m_socket.close();
+			break;
+		}
+	}
+	return m_stats.snapshots != before;
+}
+
+// a delta on a state this client no longer has, or one older than the newest, is dropped;
+// the acks keep naming the newest, so the next snapshot is built on that
+void CNetClient::handleSnapshot(CNetReader& in, double now) {
+	const uint32_t sequence = in.getVarint(), base_sequence = in.getVarint(), slot = in.getVarint();
+	if (!in.isOk() || sequence <= m_latest) {
+		m_stats.dropped++;
+		return;
+	}
+	const NetState* base = base_sequence ? m_history.find(base_sequence) : NULL;
+	if ((base_sequence && base == NULL) || !decodeState(in, base, m_decoded) || !in.atEnd()) {
+		m_stats.dropped++;
+		return;
+	}
+	m_decoded.sequence = sequence;
+	std::swap(m_history.add(sequence), m_decoded);
+	m_latest = sequence;
+	m_slot = (int)slot;
+	m_stats.snapshots++;
+	if (base == NULL) m_stats.full_snapshots++;
+
+	std::swap(m_prev, m_curr);
+	netStateToSnapshot(*m_history.find(sequence), m_slot, now, m_curr);
+	if (m_received < 2) m_received++;
+}
+
+bool CNetClient::getView(double now, Snapshot& out) const {
+	if (m_received < 2) return false;
+	// same rule as CSimThread::getAlpha(): one tick behind, so there is a newer snapshot to
+	// blend towards
+	double alpha = 1;
+	if (m_curr.time > m_prev.time) {
+		alpha = (now - 1.0 / m_hz - m_prev.time) / (m_curr.time - m_prev.time);
+		alpha = alpha < 0 ? 0 : alpha > 1 ? 1 : alpha;
+	}
+	interpolateSnapshots(m_prev, m_curr, alpha, out);
+	return true;
+}
+
+}
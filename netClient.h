@@ -0,0 +1,87 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: netClient.h
+//
+// Desc: Client end of the server protocol. Sends one input per tick (which also
+//       acknowledges the newest snapshot it has), rebuilds each snapshot from its delta
+//       and the base it names, and draws the world a tick behind the newest snapshot,
+//       blending the last two so the other players move smoothly between server ticks.
+//       There is no prediction; the own player is shown where the server last put it.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __netClientH__
+#define __netClientH__
+
+#include "netProtocol.h"
+#include "udpSocket.h"
+#include <vector>
+
+namespace sim
+{
+	struct NetClientStats
+	{
+		NetClientStats() { reset(); }
+		void reset() {
+			snapshots = full_snapshots = dropped = 0;
+			bytes_sent = bytes_received = 0;
+		}
+
+		unsigned long snapshots;
+		unsigned long full_snapshots;
+		unsigned long dropped;          // late, malformed or based on a state already gone
+		unsigned long long bytes_sent;
+		unsigned long long bytes_received;
+	};
+
+	class CNetClient {
+	public:
+		CNetClient(void);
+		~CNetClient(void);
+
+		// opens a socket and asks for a slot; sendInput() asks again until the server answers
+		bool connect(const NetAddress& server);
+		// tells the server when still connected
+		void close();
+
+		bool isConnected() const { return m_slot >= 0; }
+		bool wasRefused() const { return m_refused; }
+		int getSlot() const { return m_slot; }
+		double getHz() const { return m_hz; }
+
+		void sendInput(const Input& input);
+		// handles every datagram waiting, stamping new snapshots with now (seconds on any
+		// steady clock); true when one arrived
+		bool receive(double now);
+
+		// the newest state, NULL before the first
+		const NetState* getLatest() const { return m_history.find(m_latest); }
+		// the world as of one tick before now, blended between the last two snapshots;
+		// false until two have arrived
+		bool getView(double now, Snapshot& out) const;
+
+		const NetClientStats& getStats() const { return m_stats; }
+		void resetStats() { m_stats.reset(); }
+
+	private:
+		void send();
+		void handleSnapshot(CNetReader& in, double now);
+
+		CUdpSocket			m_socket;
+		NetAddress			m_server;
+		int					m_slot;
+		bool				m_refused;
+		double				m_hz;
+		uint32_t			m_sequence;     // of the last input sent
+		uint32_t			m_latest;       // newest snapshot decoded
+		CNetHistory			m_history;
+		NetState			m_decoded;
+		Snapshot			m_prev, m_curr;
+		int					m_received;     // snapshots turned into m_curr so far, up to 2
+		std::vector<unsigned char> m_buffer;
+		CNetWriter			m_out;
+		NetClientStats		m_stats;
+	};
+}
+
+#endif // __netClientH__
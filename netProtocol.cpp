@@ -0,0 +1,261 @@
+#include "netProtocol.h"
+#include <cmath>
+
+namespace sim
+{
+
+static int32_t quantize(double value, double scale) {
+	return (int32_t)floor(value * scale + 0.5);
+}
+
+void captureNetState(const CWorld& world, uint32_t sequence, NetState& out) {
+	out.sequence = sequence;
+	out.tick = (uint32_t)world.getTick();
+	out.status = (int32_t)world.getStatus();
+
+	out.players.resize((size_t)world.getPlayerCount() * NET_PLAYER_FIELDS);
+	for (int p = 0; p < world.getPlayerCount(); p++) {
+		const Player& player = world.getPlayer(p);
+		int32_t* r = &out.players[(size_t)p * NET_PLAYER_FIELDS];
+		r[NP_X] = quantize(player.pos_x, NET_POSITION_SCALE);
+		r[NP_Z] = quantize(player.pos_z, NET_POSITION_SCALE);
+		r[NP_LOOK_X] = quantize(player.target_x, NET_LOOK_SCALE);
+		r[NP_LOOK_Y] = quantize(player.target_y, NET_LOOK_SCALE);
+		r[NP_LOOK_Z] = quantize(player.target_z, NET_LOOK_SCALE);
+		r[NP_LIFE] = player.life;
+		r[NP_ACTIVE] = player.active;
+	}
+
+	const CEnemyPool& enemies = world.getEnemies();
+	out.enemies.resize((size_t)enemies.size() * NET_ENEMY_FIELDS);
+	for (int i = 0; i < enemies.size(); i++) {
+		const Vec3 p = enemies.getPosition(i);
+		int32_t* r = &out.enemies[i * NET_ENEMY_FIELDS];
+		r[NE_X] = quantize(p.x, NET_POSITION_SCALE);
+		r[NE_Z] = quantize(p.z, NET_POSITION_SCALE);
+		r[NE_LIFE] = enemies.getLife(i);
+		r[NE_ALIVE] = enemies.isAlive(i);
+	}
+
+	const CProjectilePool& bullets = world.getProjectiles();
+	out.bullets.resize((size_t)bullets.size() * NET_BULLET_FIELDS);
+	for (int k = 0; k < bullets.size(); k++) {
+		const Vec3 c = bullets.getCenter(k), v = bullets.getVelocity(k);
+		int32_t* r = &out.bullets[(size_t)k * NET_BULLET_FIELDS];
+		r[NB_X] = quantize(c.x, NET_POSITION_SCALE);
+		r[NB_Y] = quantize(c.y, NET_POSITION_SCALE);
+		r[NB_Z] = quantize(c.z, NET_POSITION_SCALE);
+		r[NB_VX] = quantize(v.x, NET_VELOCITY_SCALE);
+		r[NB_VY] = quantize(v.y, NET_VELOCITY_SCALE);
+		r[NB_VZ] = quantize(v.z, NET_VELOCITY_SCALE);
+		r[NB_OWNER] = bullets.getOwner(k);
+	}
+}
+
+// enemy boxes are rebuilt from the centre with enemyBody() and enemyHead(), as the world does
+void netStateToSnapshot(const NetState& state, int slot, double time, Snapshot& out) {
+	out.tick = state.tick;
+	out.time = time;
+	out.status = (GameStatus)state.status;
+
+	const size_t players = state.players.size() / NET_PLAYER_FIELDS;
+	out.players.resize(players);
+	for (size_t p = 0; p < players; p++) {
+		const int32_t* r = &state.players[p * NET_PLAYER_FIELDS];
+		PlayerState& s = out.players[p];
+		s.position = Vec3(r[NP_X] / NET_POSITION_SCALE, PLAYERHEIGHT, r[NP_Z] / NET_POSITION_SCALE);
+		s.look = Vec3(r[NP_LOOK_X] / NET_LOOK_SCALE, r[NP_LOOK_Y] / NET_LOOK_SCALE, r[NP_LOOK_Z] / NET_LOOK_SCALE);
+		s.life = r[NP_LIFE];
+		s.active = r[NP_ACTIVE] != 0;
+	}
+	if (slot >= 0 && slot < (int)players) {
+		out.eye = out.players[slot].position;
+		out.look = out.players[slot].look;
+		out.life = out.players[slot].life;
+	}
+
+	const size_t enemies = state.enemies.size() / NET_ENEMY_FIELDS;
+	out.enemies.resize(enemies);
+	for (size_t i = 0; i < enemies; i++) {
+		const int32_t* r = &state.enemies[i * NET_ENEMY_FIELDS];
+		const double x = r[NE_X] / NET_POSITION_SCALE, z = r[NE_Z] / NET_POSITION_SCALE;
+		EnemyState& e = out.enemies[i];
+		e.body = enemyBody(x, z).getPosition();
+		e.head = enemyHead(x, z).getPosition();
+		e.life = r[NE_LIFE];
+		e.alive = r[NE_ALIVE] != 0;
+	}
+
+	const size_t bullets = state.bullets.size() / NET_BULLET_FIELDS;
+	out.bullets.resize(bullets);
+	for (size_t k = 0; k < bullets; k++) {
+		const int32_t* r = &state.bullets[k * NET_BULLET_FIELDS];
+		BulletState& b = out.bullets[k];
+		b.center = Vec3(r[NB_X] / NET_POSITION_SCALE, r[NB_Y] / NET_POSITION_SCALE, r[NB_Z] / NET_POSITION_SCALE);
+		b.velocity = Vec3(r[NB_VX] / NET_VELOCITY_SCALE, r[NB_VY] / NET_VELOCITY_SCALE, r[NB_VZ] / NET_VELOCITY_SCALE);
+		b.owner = r[NB_OWNER];
+	}
+}
+
+// -----------------------------------------------------------------------------
+// CNetHistory
+// -----------------------------------------------------------------------------
+
+void CNetHistory::clear() {
+	for (int k = 0; k < NET_HISTORY; k++) m_states[k].sequence = 0;
+}
+
+NetState& CNetHistory::add(uint32_t sequence) {
+	NetState& state = m_states[sequence % NET_HISTORY];
+	state.sequence = sequence;
+	return state;
+}
+
+const NetState* CNetHistory::find(uint32_t sequence) const {
+	const NetState& state = m_states[sequence % NET_HISTORY];
+	return sequence != 0 && state.sequence == sequence ? &state : NULL;
+}
+
+// -----------------------------------------------------------------------------
+// CNetWriter / CNetReader
+// -----------------------------------------------------------------------------
+
+void CNetWriter::putVarint(uint32_t value) {
+	while (value >= 0x80) {
+		m_data.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	m_data.push_back((unsigned char)value);
+}
+
+unsigned int CNetReader::getByte() {
+	if (m_p >= m_end) {
+		m_ok = false;
+		return 0;
+	}
+	return *m_p++;
+}
+
+uint32_t CNetReader::getVarint() {
+	uint32_t v = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		const unsigned int b = getByte();
+		v |= (uint32_t)(b & 0x7f) << shift;
+		if (!(b & 0x80)) return v;
+	}
+	m_ok = false;
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+// state deltas
+// -----------------------------------------------------------------------------
+
+// records past the end of the base are compared with zeros. Per table: count, number of
+// changed records, then for each of those the gap since the previous one, a bit per field
+// and the differences of the fields that have their bit set.
+static void encodeTable(const std::vector<int32_t>& table, const std::vector<int32_t>* base, int fields, CNetWriter& out) {
+	const size_t count = table.size() / fields;
+	const size_t base_count = base ? base->size() / fields : 0;
+	static const int32_t zeros[8] = { 0 };
+
+	size_t changed = 0;
+	for (size_t i = 0; i < count; i++) {
+		const int32_t* b = i < base_count ? &(*base)[i * fields] : zeros;
+		for (int f = 0; f < fields; f++) {
+			if (table[i * fields + f] != b[f]) {
+				changed++;
+				break;
+			}
+		}
+	}
+
+	out.putVarint((uint32_t)count);
+	out.putVarint((uint32_t)changed);
+	size_t previous = 0;
+	for (size_t i = 0; i < count && changed > 0; i++) {
+		const int32_t* r = &table[i * fields];
+		const int32_t* b = i < base_count ? &(*base)[i * fields] : zeros;
+		unsigned int mask = 0;
+		for (int f = 0; f < fields; f++) {
+			if (r[f] != b[f]) mask |= 1u << f;
+		}
+		if (mask == 0) continue;
+		out.putVarint((uint32_t)(i - previous));
+		out.putByte(mask);
+		for (int f = 0; f < fields; f++) {
+			if (mask & (1u << f)) out.putSigned((int32_t)((uint32_t)r[f] - (uint32_t)b[f]));
+		}
+		previous = i;
+		changed--;
+	}
+}
+
+static bool decodeTable(CNetReader& in, const std::vector<int32_t>* base, int fields, std::vector<int32_t>& table) {
+	const uint32_t count = in.getVarint();
+	uint32_t changed = in.getVarint();
+	if (!in.isOk() || count > NET_MAX_RECORDS || changed > count) return false;
+	const size_t base_count = base ? base->size() / fields : 0;
+
+	table.assign((size_t)count * fields, 0);
+	const size_t kept = (count < base_count ? count : base_count) * fields;
+	for (size_t k = 0; k < kept; k++) table[k] = (*base)[k];
+
+	size_t i = 0;
+	for (; changed > 0; changed--) {
+		i += in.getVarint();
+		const unsigned int mask = in.getByte();
+		if (!in.isOk() || i >= count || mask >= (1u << fields)) return false;
+		int32_t* r = &table[i * fields];
+		for (int f = 0; f < fields; f++) {
+			if (mask & (1u << f)) r[f] = (int32_t)((uint32_t)r[f] + (uint32_t)in.getSigned());
+		}
+	}
+	return in.isOk();
+}
+
+void encodeState(const NetState& state, const NetState* base, CNetWriter& out) {
+	out.putVarint(state.tick);
+	out.putSigned(state.status);
+	encodeTable(state.players, base ? &base->players : NULL, NET_PLAYER_FIELDS, out);
+	encodeTable(state.enemies, base ? &base->enemies : NULL, NET_ENEMY_FIELDS, out);
+	encodeTable(state.bullets, base ? &base->bullets : NULL, NET_BULLET_FIELDS, out);
+}
+
+bool decodeState(CNetReader& in, const NetState* base, NetState& out) {
+	out.tick = in.getVarint();
+	out.status = in.getSigned();
+	return decodeTable(in, base ? &base->players : NULL, NET_PLAYER_FIELDS, out.players) &&
+		decodeTable(in, base ? &base->enemies : NULL, NET_ENEMY_FIELDS, out.enemies) &&
+		decodeTable(in, base ? &base->bullets : NULL, NET_BULLET_FIELDS, out.bullets);
+}
+
+// -----------------------------------------------------------------------------
+// input
+// -----------------------------------------------------------------------------
+
+void writeInput(CNetWriter& out, uint32_t sequence, uint32_t ack, const Input& input) {
+	out.putByte(NET_INPUT);
+	out.putVarint(sequence);
+	out.putVarint(ack);
+	out.putByte((input.forward ? 1 : 0) | (input.back ? 2 : 0) | (input.left ? 4 : 0) | (input.right ? 8 : 0) | (input.fire ? 16 : 0));
+	out.putSigned(input.look_h);
+	out.putSigned(input.look_v);
+}
+
+// after the type byte
+bool readInput(CNetReader& in, uint32_t& sequence, uint32_t& ack, Input& input) {
+	sequence = in.getVarint();
+	ack = in.getVarint();
+	const unsigned int buttons = in.getByte();
+	input.forward = (buttons & 1) != 0;
+	input.back = (buttons & 2) != 0;
+	input.left = (buttons & 4) != 0;
+	input.right = (buttons & 8) != 0;
+	input.fire = (buttons & 16) != 0;
+	input.look_h = in.getSigned();
+	input.look_v = in.getSigned();
+	return in.isOk() && in.atEnd();
+}
+
+}
@@ -0,0 +1,125 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: netProtocol.h
+//
+// Desc: Messages between the game server and its clients, one per UDP datagram. The first
+//       byte is the NetMessage type, integers after it are varints (signed ones zigzag):
+//
+//           CONNECT      version
+//           WELCOME      version, slot, tick rate in mHz
+//           INPUT        sequence, acked snapshot, buttons (forward, back, left, right,
+//                        fire), look_h, look_v
+//           SNAPSHOT     sequence, base sequence (0 = none), slot, state
+//           DISCONNECT
+//
+//       A state is the world quantized to integers (NetState), sent as a delta against the
+//       last snapshot the client acknowledged: per table the record count, then only the
+//       records that changed, each with a field mask and the differences of those fields.
+//       Inputs are not acknowledged; a lost one is a lost tick of movement, like a dropped
+//       frame.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __netProtocolH__
+#define __netProtocolH__
+
+#include "gameSim.h"
+#include "snapshot.h"
+#include <stdint.h>
+#include <vector>
+
+namespace sim
+{
+	#define NET_PROTOCOL_VERSION 1
+	#define NET_HISTORY 64      // snapshots each side keeps to build deltas on; older acks get a full one
+	#define NET_MAX_RECORDS (1 << 20)     // per table; a bigger count is a malformed message
+
+	#define NET_POSITION_SCALE 256.0    // 1/256 of a unit
+	#define NET_VELOCITY_SCALE 16.0
+	#define NET_LOOK_SCALE 32767.0
+
+	enum NetMessage { NET_CONNECT = 1, NET_WELCOME, NET_INPUT, NET_SNAPSHOT, NET_DISCONNECT };
+
+	enum NetPlayerField { NP_X, NP_Z, NP_LOOK_X, NP_LOOK_Y, NP_LOOK_Z, NP_LIFE, NP_ACTIVE, NET_PLAYER_FIELDS };
+	enum NetEnemyField { NE_X, NE_Z, NE_LIFE, NE_ALIVE, NET_ENEMY_FIELDS };
+	enum NetBulletField { NB_X, NB_Y, NB_Z, NB_VX, NB_VY, NB_VZ, NB_OWNER, NET_BULLET_FIELDS };
+
+	// records of NET_*_FIELDS values each, one after the other; bullets by pool slot
+	struct NetState
+	{
+		NetState() : sequence(0), tick(0), status(GAME_LOST) {}
+
+		uint32_t sequence;      // the server's snapshot number; the world tick restarts with the level
+		uint32_t tick;
+		int32_t status;
+		std::vector<int32_t> players, enemies, bullets;
+	};
+
+	void captureNetState(const CWorld& world, uint32_t sequence, NetState& out);
+	// reuses the vectors of out; the eye is player slot's, time stamps the snapshot for
+	// interpolateSnapshots()
+	void netStateToSnapshot(const NetState& state, int slot, double time, Snapshot& out);
+
+	// the last NET_HISTORY states by sequence
+	class CNetHistory {
+	public:
+		CNetHistory(void) { clear(); }
+
+		void clear();
+		NetState& add(uint32_t sequence);
+		// NULL once it has been written over
+		const NetState* find(uint32_t sequence) const;
+
+	private:
+		NetState m_states[NET_HISTORY];
+	};
+
+	// -----------------------------------------------------------------------------
+	// CNetWriter / CNetReader : one datagram
+	// -----------------------------------------------------------------------------
+
+	class CNetWriter {
+	public:
+		CNetWriter(void) { m_data.reserve(1024); }
+
+		void clear() { m_data.clear(); }
+		void putByte(unsigned int value) { m_data.push_back((unsigned char)value); }
+		void putVarint(uint32_t value);
+		void putSigned(int32_t value) { putVarint(((uint32_t)value << 1) ^ (uint32_t)(value >> 31)); }
+		void putBytes(const unsigned char* data, size_t size) { m_data.insert(m_data.end(), data, data + size); }
+
+		const unsigned char* data() const { return m_data.data(); }
+		size_t size() const { return m_data.size(); }
+
+	private:
+		std::vector<unsigned char> m_data;
+	};
+
+	// reads past the end fail and stick, so a message is checked once at the end
+	class CNetReader {
+	public:
+		CNetReader(const unsigned char* data, size_t size) : m_p(data), m_end(data + size), m_ok(true) {}
+
+		unsigned int getByte();
+		uint32_t getVarint();
+		int32_t getSigned() { const uint32_t v = getVarint(); return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+		bool isOk() const { return m_ok; }
+		bool atEnd() const { return m_p == m_end; }
+
+	private:
+		const unsigned char* m_p;
+		const unsigned char* m_end;
+		bool m_ok;
+	};
+
+	// base NULL writes every field in full
+	void encodeState(const NetState& state, const NetState* base, CNetWriter& out);
+	// base must be the state the encoder used; false on a malformed message
+	bool decodeState(CNetReader& in, const NetState* base, NetState& out);
+
+	void writeInput(CNetWriter& out, uint32_t sequence, uint32_t ack, const Input& input);
+	bool readInput(CNetReader& in, uint32_t& sequence, uint32_t& ack, Input& input);
+}
+
+#endif // __netProtocolH__
@@ -0,0 +1,202 @@
+#include "netServer.h"
+#include "profiler.h"
+#include <chrono>
+
+namespace sim
+{
+
+static double seconds(std::chrono::steady_clock::time_point since) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+CNetServer::CNetServer(void) {
+	m_world = NULL;
+	m_hz = 60;
+	m_ticks = 0;
+	m_sequence = 0;
+}
+
+CNetServer::~CNetServer(void) {
+	close();
+}
+
+bool CNetServer::open(CWorld& world, uint32_t ip, uint16_t port, double hz) {
+	close();
+	if (!m_socket.open(ip, port)) return false;
+	m_world = &world;
+	m_hz = hz;
+	m_ticks = 0;
+	m_sequence = 0;
+	m_history.clear();
+	m_buffer.resize(NET_MAX_DATAGRAM);
+	m_stats.reset();
+	for (int p = 0; p < world.getPlayerCount(); p++) world.removePlayer(p);
+	return true;
+}
+
+void CNetServer::close() {
+	if (m_socket.isOpen()) {
+		m_out.clear();
+		m_out.putByte(NET_DISCONNECT);
+		for (size_t c = 0; c < m_clients.size(); c++) m_socket.send(m_clients[c].address, m_out.data(), m_out.size());
+	}
+	m_socket.close();
+	m_clients.clear();
+	m_world = NULL;
+}
+
+CNetServer::Client* CNetServer::find(const NetAddress& address) {
+	for (size_t c = 0; c < m_clients.size(); c++) {
+		if (m_clients[c].address == address) return &m_clients[c];
+	}
+	return NULL;
+}
+
+void CNetServer::sendWelcome(const Client& client) {
+	m_out.clear();
+	m_out.putByte(NET_WELCOME);
+	m_out.putVarint(NET_PROTOCOL_VERSION);
+	m_out.putVarint((uint32_t)client.slot);
+	m_out.putVarint((uint32_t)(m_hz * 1000 + 0.5));
+	if (m_socket.send(client.address, m_out.data(), m_out.size())) m_stats.bytes_sent += m_out.size();
+}
+
+// a repeated connect only gets the welcome again; a full server says goodbye instead
+void CNetServer::join(const NetAddress& address) {
+	Client* known = find(address);
+	if (known) {
+		sendWelcome(*known);
+		return;
+	}
+	const int slot = m_world->addPlayer();
+	if (slot < 0) {
+		m_out.clear();
+		m_out.putByte(NET_DISCONNECT);
+		m_socket.send(address, m_out.data(), m_out.size());
+		return;
+	}
+	Client client;
+	client.address = address;
+	client.slot = slot;
+	client.acked = 0;
+	client.input = 0;
+	client.heard = m_ticks;
+	m_clients.push_back(client);
+	sendWelcome(client);
+}
+
+void CNetServer::leave(size_t client) {
+	m_world->removePlayer(m_clients[client].slot);
+	m_clients.erase(m_clients.begin() + client);
+}
+
+void CNetServer::receive() {
+	PROFILE_SCOPE("net receive");
+	NetAddress from;
+	int size;
+	while ((size = m_socket.receive(from, m_buffer.data(), m_buffer.size())) > 0) {
+		m_stats.bytes_received += size;
+		CNetReader in(m_buffer.data(), (size_t)size);
+		const unsigned int type = in.getByte();
+		if (type == NET_CONNECT) {
+			if (in.getVarint() == NET_PROTOCOL_VERSION && in.isOk()) join(from);
+			continue;
+		}
+		Client* client = find(from);
+		if (client == NULL) continue;
+		client->heard = m_ticks;
+		if (type == NET_DISCONNECT) {
+			leave(client - &m_clients[0]);
+			continue;
+		}
+		uint32_t sequence, ack;
+		Input input;
+		if (type != NET_INPUT || !readInput(in, sequence, ack, input)) continue;
+		if (ack > client->acked && ack <= m_sequence) client->acked = ack;
+		if (sequence <= client->input) continue;       // late or repeated
+		client->input = sequence;
+
+		// as CSimThread::addInput(): held keys are replaced, mouse movement adds up and a
+		// click is kept until a tick has seen it
+		Input& pending = client->pending;
+		pending.forward = input.forward;
+		pending.back = input.back;
+		pending.left = input.left;
+		pending.right = input.right;
+		pending.fire = pending.fire || input.fire;
+		pending.look_h += input.look_h;
+		pending.look_v += input.look_v;
+	}
+}
+
+void CNetServer::tick() {
+	if (m_world == NULL) return;
+	CWorld& world = *m_world;
+	m_ticks++;
+
+	const uint32_t timeout = (uint32_t)(NET_TIMEOUT * m_hz);
+	for (size_t c = m_clients.size(); c-- > 0; ) {
+		if (m_ticks - m_clients[c].heard > timeout) leave(c);
+	}
+
+	m_inputs.assign(world.getPlayerCount(), Input());
+	for (size_t c = 0; c < m_clients.size(); c++) {
+		Input& pending = m_clients[c].pending;
+		m_inputs[m_clients[c].slot] = pending;
+		pending.fire = false;
+		pending.look_h = pending.look_v = 0;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (world.getStatus() != GAME_RUNNING) world.restart();
+	world.tick(1.0 / m_hz, m_inputs.data(), (int)m_inputs.size());
+	m_stats.tick_seconds += seconds(start);
+	m_stats.ticks++;
+
+	start = std::chrono::steady_clock::now();
+	sendSnapshots();
+	m_stats.encode_seconds += seconds(start);
+}
+
+// the body of a snapshot only depends on its base, so each base is encoded once and the
+// clients get their own header in front of it
+void CNetServer::sendSnapshots() {
+	PROFILE_SCOPE("net snapshots");
+	m_sequence++;
+	NetState& state = m_history.add(m_sequence);
+	captureNetState(*m_world, m_sequence, state);
+
+	m_encodings.clear();
+	m_bodies.clear();
+	for (size_t c = 0; c < m_clients.size(); c++) {
+		Client& client = m_clients[c];
+		const NetState* base = m_history.find(client.acked);
+		const uint32_t base_sequence = base ? client.acked : 0;
+
+		size_t e = 0;
+		while (e < m_encodings.size() && m_encodings[e].base != base_sequence) e++;
+		if (e == m_encodings.size()) {
+			m_out.clear();
+			encodeState(state, base, m_out);
+			Encoding encoding = { base_sequence, m_bodies.size(), m_out.size() };
+			m_bodies.insert(m_bodies.end(), m_out.data(), m_out.data() + m_out.size());
+			m_encodings.push_back(encoding);
+		}
+
+		m_out.clear();
+		m_out.putByte(NET_SNAPSHOT);
+		m_out.putVarint(m_sequence);
+		m_out.putVarint(base_sequence);
+		m_out.putVarint((uint32_t)client.slot);
+		m_out.putBytes(&m_bodies[m_encodings[e].offset], m_encodings[e].size);
+		if (!m_socket.send(client.address, m_out.data(), m_out.size())) {
+			m_stats.send_failures++;
+			continue;
+		}
+		m_stats.bytes_sent += m_out.size();
+		m_stats.snapshots++;
+		if (base == NULL) m_stats.full_snapshots++;
+	}
+}
+
+}
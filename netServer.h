@@ -0,0 +1,101 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: netServer.h
+//
+// Desc: Authoritative game server. Owns a loaded world whose player slots all belong to
+//       remote clients; every tick it reads what arrived, runs the world once with each
+//       client's input and sends each client a snapshot delta-compressed against the
+//       last one that client acknowledged. Clients on the same base share one encoding.
+//       The caller drives the clock: tick() is one fixed step, whatever the wall time.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __netServerH__
+#define __netServerH__
+
+#include "netProtocol.h"
+#include "udpSocket.h"
+#include <vector>
+
+namespace sim
+{
+	#define NET_TIMEOUT 5.0     // seconds without a word before a client loses its slot
+
+	struct NetServerStats
+	{
+		NetServerStats() { reset(); }
+		void reset() {
+			ticks = snapshots = full_snapshots = send_failures = 0;
+			bytes_sent = bytes_received = 0;
+			tick_seconds = encode_seconds = 0;
+		}
+
+		unsigned long ticks;
+		unsigned long snapshots;
+		unsigned long full_snapshots;   // no acknowledged base to delta against
+		unsigned long send_failures;    // too big for a datagram or the send buffer was full
+		unsigned long long bytes_sent;
+		unsigned long long bytes_received;
+		double tick_seconds;            // in CWorld::tick()
+		double encode_seconds;          // capturing, encoding and sending snapshots
+	};
+
+	class CNetServer {
+	public:
+		CNetServer(void);
+		~CNetServer(void);
+
+		// binds to ip:port (port 0 takes any); the world's local player gives up its slot
+		bool open(CWorld& world, uint32_t ip, uint16_t port, double hz);
+		void close();
+		uint16_t getPort() const { return m_socket.getPort(); }
+
+		// handles every datagram waiting: joins, inputs, leaves
+		void receive();
+		// restarts a finished game, runs one tick and sends the snapshots
+		void tick();
+
+		int getClientCount() const { return (int)m_clients.size(); }
+		const NetServerStats& getStats() const { return m_stats; }
+		void resetStats() { m_stats.reset(); }
+
+	private:
+		struct Client
+		{
+			NetAddress	address;
+			int			slot;
+			uint32_t	acked;          // newest snapshot the client has, 0 before the first
+			uint32_t	input;          // sequence of the newest input taken
+			uint32_t	heard;          // server tick count at the last datagram
+			Input		pending;        // merged inputs since the last tick
+		};
+
+		struct Encoding
+		{
+			uint32_t	base;
+			size_t		offset, size;   // in m_bodies
+		};
+
+		Client* find(const NetAddress& address);
+		void join(const NetAddress& address);
+		void leave(size_t client);
+		void sendWelcome(const Client& client);
+		void sendSnapshots();
+
+		CWorld*					m_world;
+		CUdpSocket				m_socket;
+		double					m_hz;
+		uint32_t				m_ticks;
+		uint32_t				m_sequence;
+		std::vector<Client>		m_clients;
+		std::vector<Input>		m_inputs;       // by slot
+		CNetHistory				m_history;
+		std::vector<Encoding>	m_encodings;    // this tick's, one per base
+		std::vector<unsigned char> m_bodies;
+		std::vector<unsigned char> m_buffer;
+		CNetWriter				m_out;
+		NetServerStats			m_stats;
+	};
+}
+
+#endif // __netServerH__
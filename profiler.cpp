@@ -0,0 +1,165 @@
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace sim
+{
+
+struct ProfileEvent
+{
+	const char* name;
+	int64_t start, duration;
+};
+
+// written by its thread only; readers copy it and drop what was overwritten meanwhile
+struct ThreadRing
+{
+	int id;
+	std::string name;
+	std::atomic<uint64_t> head;     // only ever moved by the owner thread
+	std::atomic<uint64_t> base;     // events below it were cleared; moved by clear() under s_ringsLock
+	ProfileEvent events[PROFILE_RING];
+};
+
+static std::atomic<bool> s_enabled(false);
+static const std::chrono::steady_clock::time_point s_epoch = std::chrono::steady_clock::now();
+static std::mutex s_ringsLock;                  // only taken when a thread records for the first time
+static std::vector<ThreadRing*> s_rings;        // never freed, rings outlive their threads
+static thread_local ThreadRing* t_ring = NULL;
+
+// the same literal may sit at different addresses in different files
+struct NameLess
+{
+	bool operator()(const char* a, const char* b) const { return strcmp(a, b) < 0; }
+};
+
+static ThreadRing* threadRing() {
+	if (t_ring) return t_ring;
+	ThreadRing* ring = new ThreadRing;
+	ring->head = 0;
+	ring->base = 0;
+	std::lock_guard<std::mutex> guard(s_ringsLock);
+	ring->id = (int)s_rings.size() + 1;
+	s_rings.push_back(ring);
+	t_ring = ring;
+	return ring;
+}
+
+// the events of a ring that are still there, oldest first
+static void copyRing(const ThreadRing& ring, std::vector<ProfileEvent>& out) {
+	out.clear();
+	const uint64_t head = ring.head.load(std::memory_order_acquire);
+	const uint64_t first = std::max(head > PROFILE_RING ? head - PROFILE_RING : 0, ring.base.load(std::memory_order_relaxed));
+	for (uint64_t i = first; i < head; i++) out.push_back(ring.events[i & (PROFILE_RING - 1)]);
+	// a record() may be writing event now, over event now - PROFILE_RING
+	const uint64_t now = ring.head.load(std::memory_order_acquire);
+	const uint64_t lost = now + 1 > PROFILE_RING + first ? now + 1 - PROFILE_RING - first : 0;
+	out.erase(out.begin(), out.begin() + (size_t)std::min<uint64_t>(lost, out.size()));
+}
+
+void CProfiler::setEnabled(bool enable) {
+	s_enabled = enable;
+}
+
+bool CProfiler::isEnabled() {
+	return s_enabled.load(std::memory_order_relaxed);
+}
+
+void CProfiler::setThreadName(const char* name) {
+	ThreadRing* ring = threadRing();
+	std::lock_guard<std::mutex> guard(s_ringsLock);
+	ring->name = name;
+}
+
+int64_t CProfiler::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_epoch).count();
+}
+
+void CProfiler::record(const char* name, int64_t start, int64_t end) {
+	ThreadRing* ring = threadRing();
+	const uint64_t i = ring->head.load(std::memory_order_relaxed);
+	ProfileEvent& e = ring->events[i & (PROFILE_RING - 1)];
+	e.name = name;
+	e.start = start;
+	e.duration = end - start;
+	ring->head.store(i + 1, std::memory_order_release);
+}
+
+void CProfiler::summarize(std::vector<PhaseSummary>& out) {
+	std::map<const char*, std::vector<int64_t>, NameLess> byName;
+	std::vector<ProfileEvent> events;
+	{
+		std::lock_guard<std::mutex> guard(s_ringsLock);
+		for (size_t r = 0; r < s_rings.size(); r++) {
+			copyRing(*s_rings[r], events);
+			for (size_t k = 0; k < events.size(); k++) byName[events[k].name].push_back(events[k].duration);
+		}
+	}
+
+	out.clear();
+	for (std::map<const char*, std::vector<int64_t>, NameLess>::iterator it = byName.begin(); it != byName.end(); ++it) {
+		std::vector<int64_t>& d = it->second;
+		std::sort(d.begin(), d.end());
+		int64_t total = 0;
+		for (size_t k = 0; k < d.size(); k++) total += d[k];
+		PhaseSummary s;
+		s.name = it->first;
+		s.count = (int)d.size();
+		s.min_ms = d.front() / 1e6;
+		s.avg_ms = total / 1e6 / d.size();
+		s.p99_ms = d[(d.size() * 99 + 99) / 100 - 1] / 1e6;     // nearest rank
+		s.total_ms = total / 1e6;
+		out.push_back(s);
+	}
+	std::sort(out.begin(), out.end(), [](const PhaseSummary& a, const PhaseSummary& b) { return a.total_ms > b.total_ms; });
+}
+
+void CProfiler::writeTable(FILE* f, const char* indent) {
+	std::vector<PhaseSummary> phases;
+	summarize(phases);
+	fprintf(f, "%s%-16s %8s %10s %10s %10s %12s\n", indent, "scope", "count", "min ms", "avg ms", "p99 ms", "total ms");
+	for (size_t i = 0; i < phases.size(); i++) {
+		fprintf(f, "%s%-16s %8d %10.3f %10.3f %10.3f %12.1f\n", indent, phases[i].name, phases[i].count, phases[i].min_ms,
+			phases[i].avg_ms, phases[i].p99_ms, phases[i].total_ms);
+	}
+}
+
+// complete ("X") events in microseconds, plus a name for every thread
+bool CProfiler::writeTrace(const char* path) {
+	FILE* f = fopen(path, "w");
+	if (f == NULL) return false;
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	std::vector<ProfileEvent> events;
+	std::lock_guard<std::mutex> guard(s_ringsLock);
+	for (size_t r = 0; r < s_rings.size(); r++) {
+		const ThreadRing& ring = *s_rings[r];
+		char name[64];
+		if (ring.name.empty()) snprintf(name, sizeof(name), "thread %d", ring.id);
+		else snprintf(name, sizeof(name), "%s", ring.name.c_str());
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", ring.id, name);
+		first = false;
+
+		copyRing(ring, events);
+		for (size_t k = 0; k < events.size(); k++) {
+			fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", events[k].name, ring.id,
+				events[k].start / 1e3, events[k].duration / 1e3);
+		}
+	}
+	fprintf(f, "\n]}\n");
+	return fclose(f) == 0;
+}
+
+void CProfiler::clear() {
+	std::lock_guard<std::mutex> guard(s_ringsLock);
+	// the owner threads keep counting from where they are; readers skip what came before
+	for (size_t r = 0; r < s_rings.size(); r++) s_rings[r]->base.store(s_rings[r]->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+}
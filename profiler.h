@@ -0,0 +1,71 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: profiler.h
+//
+// Desc: Scoped timing markers. PROFILE_SCOPE("name") times the rest of the enclosing
+//       block and appends it to a ring buffer owned by the calling thread, so recording
+//       takes no lock and costs two clock reads. The rings hold the last PROFILE_RING
+//       scopes of every thread; they can be written out at any time as Chrome trace_event
+//       JSON (chrome://tracing, ui.perfetto.dev) or reduced to a min / avg / p99 table per
+//       scope name. Names must be string literals, only the pointer is stored.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __profilerH__
+#define __profilerH__
+
+#include <cstdio>
+#include <stdint.h>
+#include <vector>
+
+#define PROFILE_RING 16384      // scopes kept per thread, a power of two
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) sim::CProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+
+namespace sim
+{
+	struct PhaseSummary
+	{
+		const char* name;
+		int count;
+		double min_ms, avg_ms, p99_ms, total_ms;
+	};
+
+	class CProfiler {
+	public:
+		// off by default; a disabled scope only tests the flag
+		static void setEnabled(bool enable);
+		static bool isEnabled();
+		// shown as the thread's name in the trace
+		static void setThreadName(const char* name);
+
+		// nanoseconds since the profiler was first used
+		static int64_t now();
+		static void record(const char* name, int64_t start, int64_t end);
+
+		// scopes still in the rings, by total time; the window rolls as the rings wrap
+		static void summarize(std::vector<PhaseSummary>& out);
+		// summarize() as a text table, every line starting with indent
+		static void writeTable(FILE* f, const char* indent);
+		static bool writeTrace(const char* path);
+		// drops everything recorded so far
+		static void clear();
+	};
+
+	class CProfileScope {
+	public:
+		explicit CProfileScope(const char* name) : m_name(name), m_start(CProfiler::isEnabled() ? CProfiler::now() : -1) {}
+		~CProfileScope() { if (m_start >= 0) CProfiler::record(m_name, m_start, CProfiler::now()); }
+
+	private:
+		CProfileScope(const CProfileScope&);
+		CProfileScope& operator=(const CProfileScope&);
+
+		const char* m_name;
+		int64_t m_start;
+	};
+}
+
+#endif // __profilerH__
@@ -0,0 +1,76 @@
+#include "projectilePool.h"
+#include <cstring>
+
+namespace sim
+{
+
+CProjectilePool::CProjectilePool(void) {
+	m_px = m_py = m_pz = NULL;
+	m_vx = m_vy = m_vz = NULL;
+	m_age = NULL;
+	m_owner = NULL;
+	m_count = 0;
+	m_capacity = 0;
+}
+
+void CProjectilePool::reserve(CArena& arena, int capacity) {
+	m_count = 0;
+	m_capacity = capacity;
+	m_px = arena.allocateArray<double>(capacity);	m_py = arena.allocateArray<double>(capacity);	m_pz = arena.allocateArray<double>(capacity);
+	m_vx = arena.allocateArray<double>(capacity);	m_vy = arena.allocateArray<double>(capacity);	m_vz = arena.allocateArray<double>(capacity);
+	m_age = arena.allocateArray<double>(capacity);
+	m_owner = arena.allocateArray<int>(capacity);
+}
+
+int CProjectilePool::spawn(const Vec3& center, const Vec3& velocity, int owner) {
+	if (m_count >= capacity()) return -1;
+	const int i = m_count++;
+	m_px[i] = center.x;		m_py[i] = center.y;		m_pz[i] = center.z;
+	m_vx[i] = velocity.x;	m_vy[i] = velocity.y;	m_vz[i] = velocity.z;
+	m_age[i] = 0;
+	m_owner[i] = owner;
+	return i;
+}
+
+void CProjectilePool::retire(int i) {
+	const int last = --m_count;
+	if (i == last) return;
+	m_px[i] = m_px[last];	m_py[i] = m_py[last];	m_pz[i] = m_pz[last];
+	m_vx[i] = m_vx[last];	m_vy[i] = m_vy[last];	m_vz[i] = m_vz[last];
+	m_age[i] = m_age[last];
+	m_owner[i] = m_owner[last];
+}
+
+void CProjectilePool::save(unsigned char* out) const {
+	double* const arrays[STATE_DOUBLES] = { m_px, m_py, m_pz, m_vx, m_vy, m_vz, m_age };
+	for (int k = 0; k < STATE_DOUBLES; k++, out += m_count * sizeof(double)) memcpy(out, arrays[k], m_count * sizeof(double));
+	memcpy(out, m_owner, m_count * sizeof(int));
+}
+
+bool CProjectilePool::load(const unsigned char* in, int count) {
+	if (count < 0 || count > m_capacity) return false;
+	m_count = count;
+	double* const arrays[STATE_DOUBLES] = { m_px, m_py, m_pz, m_vx, m_vy, m_vz, m_age };
+	for (int k = 0; k < STATE_DOUBLES; k++, in += count * sizeof(double)) memcpy(arrays[k], in, count * sizeof(double));
+	memcpy(m_owner, in, count * sizeof(int));
+	return true;
+}
+
+// one straight loop over separate arrays; restrict on the parameters lets the compiler vectorize it
+static void integrateArrays(int n, double timeDelta,
+	double* __restrict px, double* __restrict py, double* __restrict pz,
+	const double* __restrict vx, const double* __restrict vy, const double* __restrict vz,
+	double* __restrict age) {
+	for (int i = 0; i < n; i++) {
+		px[i] += vx[i] * timeDelta;
+		py[i] += vy[i] * timeDelta;
+		pz[i] += vz[i] * timeDelta;
+		age[i] += timeDelta;
+	}
+}
+
+void CProjectilePool::integrate(double timeDelta) {
+	integrateArrays(m_count, timeDelta, m_px, m_py, m_pz, m_vx, m_vy, m_vz, m_age);
+}
+
+}
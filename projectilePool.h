@@ -0,0 +1,71 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: projectilePool.h
+//
+// Desc: Fixed capacity pool of bullets stored as parallel arrays (position, velocity, age,
+//       owner) taken from the level's arena. Spawning and retiring never allocate, live
+//       bullets are always packed in [0, size()) and integrate() moves all of them in one
+//       pass over contiguous memory.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __projectilePoolH__
+#define __projectilePoolH__
+
+#include "simShapes.h"
+#include "arena.h"
+
+#define OWNER_PLAYER -1     // owners >= 0 are enemy indices, OWNER_PLAYER - p is player p
+
+namespace sim
+{
+	inline int playerOwner(int player) { return OWNER_PLAYER - player; }
+	inline int ownerPlayer(int owner) { return OWNER_PLAYER - owner; }
+
+	class CProjectilePool {
+	public:
+		CProjectilePool(void);
+
+		// the only call that takes memory; it stays valid until the arena is reset
+		void reserve(CArena& arena, int capacity);
+		void clear() { m_count = 0; }
+
+		// returns the slot of the new bullet, -1 when the pool is full
+		int spawn(const Vec3& center, const Vec3& velocity, int owner);
+		// moves the last bullet into slot i, so slots are only stable until the next retire
+		void retire(int i);
+		void integrate(double timeDelta);
+
+		int size() const { return m_count; }
+		int capacity() const { return m_capacity; }
+
+		Vec3 getCenter(int i) const { return Vec3(m_px[i], m_py[i], m_pz[i]); }
+		Vec3 getVelocity(int i) const { return Vec3(m_vx[i], m_vy[i], m_vz[i]); }
+		int getOwner(int i) const { return m_owner[i]; }
+		double getAge(int i) const { return m_age[i]; }
+
+		// the live bullets as the arrays one after the other (the doubles, then the
+		// owners), for world snapshots; load() fails when count is over the capacity
+		static size_t stateBytes(int count) { return ownersOffset(count) + (size_t)count * sizeof(int); }
+		// where the owners start in the saved arrays of count bullets
+		static size_t ownersOffset(int count) { return (size_t)count * STATE_DOUBLES * sizeof(double); }
+		void save(unsigned char* out) const;
+		bool load(const unsigned char* in, int count);
+
+		const double* getX() const { return m_px; }
+		const double* getY() const { return m_py; }
+		const double* getZ() const { return m_pz; }
+
+	private:
+		enum { STATE_DOUBLES = 7 };     // position, velocity, age
+
+		double*				m_px, *m_py, *m_pz;
+		double*				m_vx, *m_vy, *m_vz;
+		double*				m_age;
+		int*				m_owner;
+		int					m_count;
+		int					m_capacity;
+	};
+}
+
+#endif // __projectilePoolH__
@@ -0,0 +1,94 @@
+#include "recordingBackend.h"
+
+namespace render
+{
+
+CRecordingBackend::CRecordingBackend(void) {
+	m_hasMaterial = false;
+	m_frames = 0;
+	m_liveMeshes = 0;
+	m_liveBuffers = 0;
+}
+
+// triangle counts of the meshes D3DXCreateBox / D3DXCreateSphere would build
+MeshHandle CRecordingBackend::createBox(float, float, float) {
+	m_meshTriangles.push_back(12);
+	m_liveMeshes++;
+	return (MeshHandle)m_meshTriangles.size() - 1;
+}
+
+MeshHandle CRecordingBackend::createSphere(float, int slices, int stacks) {
+	m_meshTriangles.push_back(2 * slices * (stacks - 1));
+	m_liveMeshes++;
+	return (MeshHandle)m_meshTriangles.size() - 1;
+}
+
+BufferHandle CRecordingBackend::createStaticBuffer(const Vertex*, int, const unsigned short*, int indexCount) {
+	m_bufferTriangles.push_back(indexCount / 3);
+	m_liveBuffers++;
+	return (BufferHandle)m_bufferTriangles.size() - 1;
+}
+
+void CRecordingBackend::releaseMesh(MeshHandle mesh) {
+	if (mesh < 0 || mesh >= (int)m_meshTriangles.size() || m_meshTriangles[mesh] < 0) return;
+	m_meshTriangles[mesh] = -1;
+	m_liveMeshes--;
+}
+
+void CRecordingBackend::releaseBuffer(BufferHandle buffer) {
+	if (buffer < 0 || buffer >= (int)m_bufferTriangles.size() || m_bufferTriangles[buffer] < 0) return;
+	m_bufferTriangles[buffer] = -1;
+	m_liveBuffers--;
+}
+
+long long CRecordingBackend::getMeshTriangles() const {
+	long long sum = 0;
+	for (size_t i = 0; i < m_meshTriangles.size(); i++)
+		if (m_meshTriangles[i] > 0) sum += m_meshTriangles[i];
+	return sum;
+}
+
+bool CRecordingBackend::beginFrame(unsigned int) {
+	m_commands.clear();
+	m_current.reset();
+	m_hasMaterial = false;
+	return true;
+}
+
+void CRecordingBackend::endFrame() {
+	m_last = m_current;
+	m_frames++;
+}
+
+void CRecordingBackend::record(CommandType type, int handle) {
+	Command c;
+	c.type = type;
+	c.handle = handle;
+	m_commands.push_back(c);
+	if (type == CMD_DRAW_MESH || type == CMD_DRAW_BUFFER) m_current.draw_calls++;
+	else m_current.state_changes++;
+}
+
+void CRecordingBackend::setCamera(const Mat4&, const Mat4&) { record(CMD_CAMERA, -1); }
+void CRecordingBackend::setLight(int index, const PointLight&) { record(CMD_LIGHT, index); }
+void CRecordingBackend::setLighting(bool enable) { record(CMD_LIGHTING, enable ? 1 : 0); }
+void CRecordingBackend::setTransform(const Mat4&) { record(CMD_TRANSFORM, -1); }
+
+void CRecordingBackend::setMaterial(const Material& material) {
+	if (m_hasMaterial && m_material == material) m_current.redundant_materials++;
+	m_material = material;
+	m_hasMaterial = true;
+	record(CMD_MATERIAL, -1);
+}
+
+void CRecordingBackend::drawMesh(MeshHandle mesh) {
+	record(CMD_DRAW_MESH, mesh);
+	if (mesh >= 0 && mesh < (int)m_meshTriangles.size() && m_meshTriangles[mesh] > 0) m_current.triangles += m_meshTriangles[mesh];
+}
+
+void CRecordingBackend::drawBuffer(BufferHandle buffer) {
+	record(CMD_DRAW_BUFFER, buffer);
+	if (buffer >= 0 && buffer < (int)m_bufferTriangles.size() && m_bufferTriangles[buffer] > 0) m_current.triangles += m_bufferTriangles[buffer];
+}
+
+}
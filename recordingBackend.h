@@ -0,0 +1,83 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: recordingBackend.h
+//
+// Desc: IRenderBackend that draws nothing. It keeps the command list of the last frame and
+//       counts draw calls, state changes and triangles, for headless runs and for checking
+//       how much work a frame submits.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __recordingBackendH__
+#define __recordingBackendH__
+
+#include "renderBackend.h"
+#include <vector>
+
+namespace render
+{
+	enum CommandType { CMD_CAMERA, CMD_LIGHT, CMD_LIGHTING, CMD_TRANSFORM, CMD_MATERIAL, CMD_DRAW_MESH, CMD_DRAW_BUFFER };
+
+	struct Command
+	{
+		CommandType type;
+		int handle;         // mesh / buffer / light index, 1 / 0 for lighting on / off, -1 otherwise
+	};
+
+	struct FrameStats
+	{
+		FrameStats() { reset(); }
+		void reset() { draw_calls = 0; state_changes = 0; redundant_materials = 0; triangles = 0; }
+
+		int draw_calls;
+		int state_changes;      // camera, light, lighting, transform and material sets
+		int redundant_materials;    // material sets equal to the one already set this frame
+		long long triangles;
+	};
+
+	class CRecordingBackend : public IRenderBackend {
+	public:
+		CRecordingBackend(void);
+
+		virtual MeshHandle createBox(float width, float height, float depth);
+		virtual MeshHandle createSphere(float radius, int slices, int stacks);
+		virtual BufferHandle createStaticBuffer(const Vertex* vertices, int vertexCount,
+			const unsigned short* indices, int indexCount);
+		virtual void releaseMesh(MeshHandle mesh);
+		virtual void releaseBuffer(BufferHandle buffer);
+
+		virtual bool beginFrame(unsigned int clearColor);
+		virtual void endFrame();
+		virtual void setCamera(const Mat4& view, const Mat4& proj);
+		virtual void setLight(int index, const PointLight& light);
+		virtual void setLighting(bool enable);
+
+		virtual void setTransform(const Mat4& world);
+		virtual void setMaterial(const Material& material);
+		virtual void drawMesh(MeshHandle mesh);
+		virtual void drawBuffer(BufferHandle buffer);
+
+		const FrameStats& getFrameStats() const { return m_last; }
+		const std::vector<Command>& getCommands() const { return m_commands; }
+		int getFrames() const { return m_frames; }
+		int getLiveMeshes() const { return m_liveMeshes; }
+		int getLiveBuffers() const { return m_liveBuffers; }
+		long long getMeshTriangles() const;
+
+	private:
+		void record(CommandType type, int handle);
+
+		std::vector<int>		m_meshTriangles;    // < 0 once released
+		std::vector<int>		m_bufferTriangles;
+		std::vector<Command>	m_commands;
+		FrameStats				m_current;
+		FrameStats				m_last;
+		Material				m_material;
+		bool					m_hasMaterial;      // set since beginFrame()
+		int						m_frames;
+		int						m_liveMeshes;
+		int						m_liveBuffers;
+	};
+}
+
+#endif // __recordingBackendH__
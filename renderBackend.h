@@ -0,0 +1,79 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: renderBackend.h
+//
+// Desc: The draw call stream of a frame. The game renders through IRenderBackend only;
+//       CD3DBackend (d3dBackend.h) turns it into Direct3D 9 calls and CRecordingBackend
+//       (recordingBackend.h) records it, so frames can be inspected without a GPU.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __renderBackendH__
+#define __renderBackendH__
+
+#include "renderMath.h"
+
+namespace render
+{
+	// position + normal + color, the layout of D3DFVF_XYZ | D3DFVF_NORMAL | D3DFVF_DIFFUSE;
+	// the color is only used while lighting is off, for light baked into the vertices
+	struct Vertex
+	{
+		float x, y, z;
+		float nx, ny, nz;
+		unsigned int color;     // 0xAARRGGBB
+	};
+
+	// fixed function material: ambient, diffuse and specular all take the color
+	struct Material
+	{
+		Material() : power(5.0f) {}
+		Material(const Color& c, float p = 5.0f) : color(c), power(p) {}
+
+		bool operator==(const Material& o) const { return color == o.color && power == o.power; }
+		bool operator!=(const Material& o) const { return !(*this == o); }
+
+		Color color;
+		float power;
+	};
+
+	struct PointLight
+	{
+		Float3 position;
+		Color diffuse, specular, ambient;
+		float range;
+		float attenuation0, attenuation1, attenuation2;
+	};
+
+	typedef int MeshHandle;         // -1 = creation failed
+	typedef int BufferHandle;
+
+	class IRenderBackend {
+	public:
+		virtual ~IRenderBackend() {}
+
+		// resources
+		virtual MeshHandle createBox(float width, float height, float depth) = 0;
+		virtual MeshHandle createSphere(float radius, int slices, int stacks) = 0;
+		virtual BufferHandle createStaticBuffer(const Vertex* vertices, int vertexCount,
+			const unsigned short* indices, int indexCount) = 0;
+		virtual void releaseMesh(MeshHandle mesh) = 0;
+		virtual void releaseBuffer(BufferHandle buffer) = 0;
+
+		// frame
+		virtual bool beginFrame(unsigned int clearColor) = 0;
+		virtual void endFrame() = 0;
+		virtual void setCamera(const Mat4& view, const Mat4& proj) = 0;
+		virtual void setLight(int index, const PointLight& light) = 0;
+		// on by default; off draws vertex colors as they are and ignores lights and material
+		virtual void setLighting(bool enable) = 0;
+
+		// state + draws
+		virtual void setTransform(const Mat4& world) = 0;
+		virtual void setMaterial(const Material& material) = 0;
+		virtual void drawMesh(MeshHandle mesh) = 0;
+		virtual void drawBuffer(BufferHandle buffer) = 0;
+	};
+}
+
+#endif // __renderBackendH__
@@ -0,0 +1,144 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: renderMath.h
+//
+// Desc: Just enough matrix math for the renderer without d3dx9.h. Mat4 has the memory
+//       layout of D3DXMATRIX (row major, row vectors) and the helpers follow the D3DX
+//       left-handed conventions, so matrices can be handed to Direct3D unchanged.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __renderMathH__
+#define __renderMathH__
+
+#include <cmath>
+
+namespace render
+{
+	struct Color
+	{
+		Color() : r(0), g(0), b(0), a(1) {}
+		Color(float ir, float ig, float ib, float ia = 1.0f) : r(ir), g(ig), b(ib), a(ia) {}
+
+		bool operator==(const Color& o) const { return r == o.r && g == o.g && b == o.b && a == o.a; }
+		bool operator!=(const Color& o) const { return !(*this == o); }
+
+		float r, g, b, a;
+	};
+
+	inline Color rgb(int r, int g, int b) { return Color(r / 255.0f, g / 255.0f, b / 255.0f); }
+
+	const Color WHITE(1, 1, 1);
+	const Color BLACK(0, 0, 0);
+	const Color RED(1, 0, 0);
+	const Color GREEN(0, 1, 0);
+	const Color BLUE(0, 0, 1);
+	const Color YELLOW(1, 1, 0);
+	const Color CYAN(0, 1, 1);
+
+	struct Float3
+	{
+		Float3() : x(0), y(0), z(0) {}
+		Float3(float ix, float iy, float iz) : x(ix), y(iy), z(iz) {}
+
+		float x, y, z;
+	};
+
+	inline Float3 operator-(const Float3& a, const Float3& b) { return Float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	inline float dot(const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline Float3 cross(const Float3& a, const Float3& b) {
+		return Float3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+	inline Float3 normalize(const Float3& v) {
+		float l = sqrtf(dot(v, v));
+		return l > 0 ? Float3(v.x / l, v.y / l, v.z / l) : v;
+	}
+
+	struct Mat4
+	{
+		float m[4][4];
+
+		static Mat4 identity() {
+			Mat4 r;
+			for (int i = 0; i < 4; i++)
+				for (int j = 0; j < 4; j++) r.m[i][j] = i == j ? 1.0f : 0.0f;
+			return r;
+		}
+
+		static Mat4 translation(float x, float y, float z) {
+			Mat4 r = identity();
+			r.m[3][0] = x;	r.m[3][1] = y;	r.m[3][2] = z;
+			return r;
+		}
+
+		// D3DXMatrixLookAtLH
+		static Mat4 lookAtLH(const Float3& eye, const Float3& at, const Float3& up) {
+			Float3 zaxis = normalize(at - eye);
+			Float3 xaxis = normalize(cross(up, zaxis));
+			Float3 yaxis = cross(zaxis, xaxis);
+			Mat4 r = identity();
+			r.m[0][0] = xaxis.x;	r.m[0][1] = yaxis.x;	r.m[0][2] = zaxis.x;
+			r.m[1][0] = xaxis.y;	r.m[1][1] = yaxis.y;	r.m[1][2] = zaxis.y;
+			r.m[2][0] = xaxis.z;	r.m[2][1] = yaxis.z;	r.m[2][2] = zaxis.z;
+			r.m[3][0] = -dot(xaxis, eye);
+			r.m[3][1] = -dot(yaxis, eye);
+			r.m[3][2] = -dot(zaxis, eye);
+			return r;
+		}
+
+		// D3DXMatrixPerspectiveFovLH
+		static Mat4 perspectiveFovLH(float fovy, float aspect, float zn, float zf) {
+			float ys = 1.0f / tanf(fovy / 2);
+			Mat4 r;
+			for (int i = 0; i < 4; i++)
+				for (int j = 0; j < 4; j++) r.m[i][j] = 0;
+			r.m[0][0] = ys / aspect;
+			r.m[1][1] = ys;
+			r.m[2][2] = zf / (zf - zn);
+			r.m[2][3] = 1;
+			r.m[3][2] = -zn * zf / (zf - zn);
+			return r;
+		}
+
+		Mat4 operator*(const Mat4& o) const {
+			Mat4 r;
+			for (int i = 0; i < 4; i++)
+				for (int j = 0; j < 4; j++)
+					r.m[i][j] = m[i][0] * o.m[0][j] + m[i][1] * o.m[1][j] + m[i][2] * o.m[2][j] + m[i][3] * o.m[3][j];
+			return r;
+		}
+	};
+
+	// the six clip planes of a view * projection matrix, pointing inwards
+	struct Frustum
+	{
+		float plane[6][4];
+
+		static Frustum fromMatrix(const Mat4& m) {
+			Frustum f;
+			for (int i = 0; i < 4; i++) {
+				f.plane[0][i] = m.m[i][3] + m.m[i][0];     // left
+				f.plane[1][i] = m.m[i][3] - m.m[i][0];     // right
+				f.plane[2][i] = m.m[i][3] + m.m[i][1];     // bottom
+				f.plane[3][i] = m.m[i][3] - m.m[i][1];     // top
+				f.plane[4][i] = m.m[i][2];                 // near
+				f.plane[5][i] = m.m[i][3] - m.m[i][2];     // far
+			}
+			return f;
+		}
+
+		// false only when the box lies entirely outside one plane
+		bool intersects(const Float3& lo, const Float3& hi) const {
+			for (int k = 0; k < 6; k++) {
+				const float* p = plane[k];
+				float x = p[0] >= 0 ? hi.x : lo.x;
+				float y = p[1] >= 0 ? hi.y : lo.y;
+				float z = p[2] >= 0 ? hi.z : lo.z;
+				if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0) return false;
+			}
+			return true;
+		}
+	};
+}
+
+#endif // __renderMathH__
@@ -0,0 +1,116 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: renderTest.cpp
+//
+// Desc: Draws the built-in level through CRecordingBackend while the player turns and
+//       fires, and checks the work every frame submits: the draw calls stay within the
+//       static batches plus the live enemies and bullets, every mesh gets exactly one
+//       transform, no material is set again to the one already set, and drawing the
+//       level box by box takes more calls than batching it. Run by CTest; prints what
+//       failed and exits with 1.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gameSim.h"
+#include "recordingBackend.h"
+#include "sceneRenderer.h"
+#include <cstdio>
+
+static const int FRAMES = 600;
+
+static int g_failures = 0;
+
+static void check(bool ok, int frame, const char* what) {
+	if (ok) return;
+	if (g_failures < 20) printf("FAIL frame %d: %s\n", frame, what);
+	g_failures++;
+}
+
+// draws up to FRAMES frames; the average draw calls per frame
+static double run(bool batching) {
+	sim::CWorld world;
+	if (!world.load()) {
+		printf("FAIL: the built-in level does not load\n");
+		g_failures++;
+		return 0;
+	}
+	render::CRecordingBackend backend;
+	render::CSceneRenderer renderer;
+	renderer.setBatching(batching);
+	if (!renderer.create(&backend, world, 1024, 768)) {
+		printf("FAIL: create() with batching %s\n", batching ? "on" : "off");
+		g_failures++;
+		return 0;
+	}
+
+	long long draws = 0;
+	int frames = 0, withBullets = 0, withEnemies = 0;
+	sim::Input input;
+	input.fire = true;
+	input.look_h = 1;
+	for (int frame = 0; frame < FRAMES && world.getStatus() == sim::GAME_RUNNING; frame++) {
+		world.tick(1.0 / 60, input);
+		if (!renderer.drawFrame(world)) {
+			check(false, frame, "drawFrame() failed");
+			break;
+		}
+
+		const render::FrameStats& stats = backend.getFrameStats();
+		const std::vector<render::Command>& commands = backend.getCommands();
+		int cameras = 0, transforms = 0, materials = 0, meshes = 0, buffers = 0;
+		bool materialSinceDraw = false, repeatedMaterial = false;
+		for (size_t i = 0; i < commands.size(); i++) {
+			switch (commands[i].type) {
+			case render::CMD_CAMERA: cameras++; break;
+			case render::CMD_TRANSFORM: transforms++; break;
+			case render::CMD_MATERIAL:
+				if (materialSinceDraw) repeatedMaterial = true;
+				materialSinceDraw = true;
+				materials++;
+				break;
+			case render::CMD_DRAW_MESH: meshes++; materialSinceDraw = false; break;
+			case render::CMD_DRAW_BUFFER: buffers++; materialSinceDraw = false; break;
+			default: break;
+			}
+		}
+
+		int liveEnemies = 0;
+		for (int i = 0; i < world.getEnemies().size(); i++) liveEnemies += world.getEnemies().isAlive(i);
+		const int statics = batching ? renderer.getStaticBatches() : renderer.getStaticBoxes();
+		// two boxes per enemy, plus the aim point and the light
+		const int bound = statics + liveEnemies * 2 + world.getProjectiles().size() + 2;
+
+		check(stats.draw_calls == meshes + buffers, frame, "draw calls do not match the commands");
+		check(stats.draw_calls <= bound, frame, "more draw calls than static geometry, enemies and bullets");
+		check(buffers <= renderer.getStaticBatches(), frame, "a static batch drawn twice");
+		check(cameras == 1, frame, "camera set more than once");
+		// batched statics share one identity transform, everything else has its own
+		check(transforms == meshes + (batching ? 1 : 0), frame, "not one transform per mesh");
+		check(!repeatedMaterial, frame, "material set twice without a draw in between");
+		check(stats.redundant_materials == 0, frame, "material set again to the one already set");
+		check(materials <= stats.draw_calls, frame, "more material changes than draw calls");
+		check(stats.state_changes <= stats.draw_calls * 3 + 4, frame, "too many state changes");
+		draws += stats.draw_calls;
+		frames++;
+		withBullets += renderer.getCullStats().bullets_drawn > 0;
+		withEnemies += renderer.getCullStats().enemies_drawn > 0;
+	}
+	// the counts above only mean something when there was something to draw
+	check(withBullets > 0 && withEnemies > 0, frames, "no bullets or no enemies were ever drawn");
+	renderer.destroy();
+	check(backend.getLiveMeshes() == 0 && backend.getLiveBuffers() == 0, FRAMES, "meshes or buffers left after destroy()");
+	return frames ? (double)draws / frames : 0;
+}
+
+int main() {
+	const double batched = run(true);
+	const double boxes = run(false);
+	printf("draw calls   %.1f per frame batched, %.1f box by box\n", batched, boxes);
+	check(batched > 0 && boxes > batched, FRAMES, "batching does not save draw calls");
+	if (g_failures) {
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
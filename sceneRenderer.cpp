@@ -0,0 +1,399 @@
+#include "sceneRenderer.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace render
+{
+
+static const Color headHit[2] = { rgb(192, 32, 0), rgb(128, 128, 0) };
+static const Color bodyHit[2] = { rgb(192, 16, 16), rgb(128, 64, 64) };
+static const unsigned int CLEAR_COLOR = 0x00afafaf;
+static const int CHUNK_CELLS = 8;      // static geometry chunks are CHUNK_CELLS x CHUNK_CELLS map cells
+
+static Float3 toFloat3(const sim::Vec3& v) { return Float3((float)v.x, (float)v.y, (float)v.z); }
+
+CSceneRenderer::CSceneRenderer(void) {
+	m_backend = NULL;
+	m_batching = true;
+	m_staticBoxes = 0;
+	m_lightMesh = -1;
+	m_bullet.radius = m_aimPoint.radius = 0.0f;
+	for (int i = 0; i < SPHERE_LODS; i++) m_bullet.lod[i] = m_aimPoint.lod[i] = -1;
+	m_view = m_proj = Mat4::identity();
+	m_pixelScale = 0.0f;
+	m_culling = true;
+	m_chunkCols = m_chunkRows = 0;
+	m_originX = m_originZ = 0;
+	m_pvsTile = -2;
+	m_frustum = Frustum::fromMatrix(Mat4::identity());
+	m_cull.static_drawn = m_cull.static_total = m_cull.enemies_drawn = m_cull.bullets_drawn = m_cull.transforms_built = 0;
+	m_hasMaterial = false;
+	m_lighting = true;
+	m_bakeLighting = true;
+	m_bakeStats = BakeStats();
+}
+
+int CSceneRenderer::chunkOf(double x, double z) const {
+	int col = (int)floor((x - m_originX) / (CHUNK_CELLS * WORLD_SIZE));
+	int row = (int)floor((m_originZ - z) / (CHUNK_CELLS * WORLD_SIZE));
+	if (col < 0) col = 0;
+	if (col >= m_chunkCols) col = m_chunkCols - 1;
+	if (row < 0) row = 0;
+	if (row >= m_chunkRows) row = m_chunkRows - 1;
+	return row * m_chunkCols + col;
+}
+
+// split = cut the box at chunk borders so each piece can be culled with its chunk;
+// unsplit boxes are never culled by the PVS
+bool CSceneRenderer::addStatic(const sim::CWall& wall, const Material& material, CStaticBatcher& batcher, bool split) {
+	const sim::Vec3 p = wall.getPosition();
+	const sim::Vec3 size = wall.getSize();
+	if (!split) return addPiece(toFloat3(p), toFloat3(size), material, -1, batcher);
+
+	const double chunk = CHUNK_CELLS * WORLD_SIZE;
+	const double x0 = p.x - size.x / 2, x1 = p.x + size.x / 2;
+	const double z0 = p.z - size.z / 2, z1 = p.z + size.z / 2;
+	const int c0 = (int)floor((x0 - m_originX) / chunk), c1 = (int)ceil((x1 - m_originX) / chunk) - 1;
+	const int r0 = (int)floor((m_originZ - z1) / chunk), r1 = (int)ceil((m_originZ - z0) / chunk) - 1;
+	for (int r = r0; r <= r1; r++) {
+		for (int c = c0; c <= c1; c++) {
+			const double lx = std::max(x0, m_originX + c * chunk), hx = std::min(x1, m_originX + (c + 1) * chunk);
+			const double hz = std::min(z1, m_originZ - r * chunk), lz = std::max(z0, m_originZ - (r + 1) * chunk);
+			if (hx <= lx || hz <= lz) continue;
+			Float3 center((float)((lx + hx) / 2), (float)p.y, (float)((lz + hz) / 2));
+			Float3 piece((float)(hx - lx), (float)size.y, (float)(hz - lz));
+			if (!addPiece(center, piece, material, chunkOf(center.x, center.z), batcher)) return false;
+		}
+	}
+	return true;
+}
+
+bool CSceneRenderer::addPiece(const Float3& center, const Float3& size, const Material& material, int chunk, CStaticBatcher& batcher) {
+	m_staticBoxes++;
+	if (m_batching) {
+		batcher.addBox(center, size, material, chunk);
+		return true;
+	}
+	Box box;
+	box.mesh = m_cache.box(size.x, size.y, size.z);
+	box.transform = Mat4::translation(center.x, center.y, center.z);
+	box.material = material;
+	box.chunk = chunk;
+	box.lo = Float3(center.x - size.x / 2, center.y - size.y / 2, center.z - size.z / 2);
+	box.hi = Float3(center.x + size.x / 2, center.y + size.y / 2, center.z + size.z / 2);
+	m_boxes.push_back(box);
+	return box.mesh >= 0;
+}
+
+bool CSceneRenderer::addBatches(const std::vector<StaticBatch>& batches) {
+	for (size_t i = 0; i < batches.size(); i++) {
+		Batch b;
+		b.material = batches[i].material;
+		b.chunk = batches[i].chunk;
+		b.baked = batches[i].baked;
+		b.lo = batches[i].lo;
+		b.hi = batches[i].hi;
+		b.buffer = m_backend->createStaticBuffer(&batches[i].vertices[0], (int)batches[i].vertices.size(),
+			&batches[i].indices[0], (int)batches[i].indices.size());
+		if (b.buffer < 0) return false;
+		m_batches.push_back(b);
+	}
+	return true;
+}
+
+bool CSceneRenderer::create(IRenderBackend* backend, const sim::CWorld& world, int width, int height) {
+	destroy();
+	m_backend = backend;
+	if (m_backend == NULL) return false;
+	m_cache.setBackend(m_backend);
+
+	m_chunkCols = (world.getCols() + CHUNK_CELLS - 1) / CHUNK_CELLS;
+	m_chunkRows = (world.getRows() + CHUNK_CELLS - 1) / CHUNK_CELLS;
+	m_originX = -world.getCols() * WORLD_SIZE / 2.0;
+	m_originZ = world.getRows() * WORLD_SIZE / 2.0;
+	m_visibleChunks.assign(m_chunkCols * m_chunkRows, 1);
+	m_pvsTile = -2;
+
+	// static level: walls, floor and flag; the ceiling only exists for collision
+	CStaticBatcher batcher;
+	std::vector<StaticBatch> baked;
+	m_bakeStats = BakeStats();
+	if (m_batching && m_bakeLighting) {
+		m_baker.bake(world, CHUNK_CELLS, WHITE, baked);
+		m_bakeStats = m_baker.getStats();
+	}
+	else {
+		const sim::CArenaArray<sim::CWall>& walls = world.getWalls();
+		for (size_t i = 0; i < walls.size(); i++) {
+			if (!addStatic(walls[i], Material(WHITE), batcher, true)) return false;
+		}
+		if (!addStatic(world.getPlane(), Material(WHITE), batcher, false)) return false;
+	}
+	if (!addStatic(world.getFlag(), Material(YELLOW), batcher, true)) return false;
+	if (!addBatches(baked) || !addBatches(batcher.getBatches())) return false;
+
+	// dynamic objects; the box sizes are kept so drawing never reads the live hitboxes
+	const sim::CArenaArray<sim::CWall>& boxes = world.getHitboxes();
+	for (size_t i = 0; i < boxes.size(); i++) {
+		const sim::Vec3 size = boxes[i].getSize();
+		m_enemySizes.push_back(toFloat3(size));
+		m_enemyMeshes.push_back(m_cache.box((float)size.x, (float)size.y, (float)size.z));
+		if (m_enemyMeshes[i] < 0) return false;
+	}
+	m_enemyPlacements.assign(m_enemyMeshes.size(), Placement());
+	m_aimPlacement = m_lightPlacement = Placement();
+	if (!createSphere(m_bullet, (float)M_RADIUS)) return false;
+	if (!createSphere(m_aimPoint, 0.001f)) return false;
+	if ((m_lightMesh = m_cache.sphere(0.1f, 10, 10)) < 0) return false;
+
+	// one point light above the middle of the map, raised and brightened with its longer side
+	const int span = std::max(world.getCols(), world.getRows());
+	m_light.position = Float3(0.0f, WORLD_SIZE * span / 2, 0.0f);
+	m_light.diffuse = WHITE;
+	const float boost = (float)(WORLD_SIZE * span / 5);
+	m_light.specular = Color(boost, boost, boost, boost);
+	m_light.ambient = Color(boost, boost, boost, boost);
+	m_light.range = WORLD_SIZE * span * 10;
+	m_light.attenuation0 = 0.0f;
+	m_light.attenuation1 = 0.9f;
+	m_light.attenuation2 = 0.0f;
+	m_backend->setLight(0, m_light);
+
+	m_proj = Mat4::perspectiveFovLH(3.14159265f / 4, (float)width / (float)height, 0.1f, 100.0f);
+	m_pixelScale = m_proj.m[1][1] * height / 2;
+	return true;
+}
+
+bool CSceneRenderer::createSphere(LodSphere& sphere, float radius) {
+	sphere.radius = radius;
+	for (int i = 0; i < SPHERE_LODS; i++) {
+		sphere.lod[i] = m_cache.sphere(radius, sphereLods[i].slices, sphereLods[i].stacks);
+		if (sphere.lod[i] < 0) return false;
+	}
+	return true;
+}
+
+void CSceneRenderer::releaseSphere(LodSphere& sphere) {
+	for (int i = 0; i < SPHERE_LODS; i++) {
+		m_cache.release(sphere.lod[i]);
+		sphere.lod[i] = -1;
+	}
+}
+
+void CSceneRenderer::destroy() {
+	if (m_backend != NULL) {
+		for (size_t i = 0; i < m_batches.size(); i++) m_backend->releaseBuffer(m_batches[i].buffer);
+		for (size_t i = 0; i < m_boxes.size(); i++) m_cache.release(m_boxes[i].mesh);
+		for (size_t i = 0; i < m_enemyMeshes.size(); i++) m_cache.release(m_enemyMeshes[i]);
+		releaseSphere(m_bullet);
+		releaseSphere(m_aimPoint);
+		m_cache.release(m_lightMesh);
+		m_cache.clear();
+	}
+	m_batches.clear();
+	m_boxes.clear();
+	m_enemyMeshes.clear();
+	m_enemySizes.clear();
+	m_enemyPlacements.clear();
+	m_staticBoxes = 0;
+	m_lightMesh = -1;
+	m_backend = NULL;
+}
+
+// skips material and lighting sets that would not change anything
+void CSceneRenderer::setMaterial(const Material& material) {
+	if (m_hasMaterial && m_lastMaterial == material) return;
+	m_backend->setMaterial(material);
+	m_lastMaterial = material;
+	m_hasMaterial = true;
+}
+
+void CSceneRenderer::setLighting(bool enable) {
+	if (m_lighting == enable) return;
+	m_backend->setLighting(enable);
+	m_lighting = enable;
+}
+
+// bullets move every tick and change slots, so theirs is built on the spot
+void CSceneRenderer::drawAt(MeshHandle mesh, const sim::Vec3& position) {
+	m_backend->setTransform(Mat4::translation((float)position.x, (float)position.y, (float)position.z));
+	m_backend->drawMesh(mesh);
+	m_cull.transforms_built++;
+}
+
+// standing enemies and the light keep their matrix from frame to frame; whatever is
+// culled is never looked at, however far it moved
+void CSceneRenderer::drawAt(MeshHandle mesh, Placement& placement, const sim::Vec3& position) {
+	const Float3 p((float)position.x, (float)position.y, (float)position.z);
+	if (!placement.valid || p.x != placement.position.x || p.y != placement.position.y || p.z != placement.position.z) {
+		placement.position = p;
+		placement.transform = Mat4::translation(p.x, p.y, p.z);
+		placement.valid = true;
+		m_cull.transforms_built++;
+	}
+	m_backend->setTransform(placement.transform);
+	m_backend->drawMesh(mesh);
+}
+
+// tessellation from the projected diameter; spheres closer than the near plane count as huge
+void CSceneRenderer::drawSphere(const LodSphere& sphere, const sim::Vec3& position, const sim::Vec3& eye, Placement* placement) {
+	const double dx = position.x - eye.x, dy = position.y - eye.y, dz = position.z - eye.z;
+	const float distance = (float)sqrt(dx * dx + dy * dy + dz * dz);
+	const float pixels = distance > 0.1f ? 2 * sphere.radius * m_pixelScale / distance : 1e9f;
+	const MeshHandle mesh = sphere.lod[sphereLodFor(pixels)];
+	if (placement != NULL) drawAt(mesh, *placement, position);
+	else drawAt(mesh, position);
+}
+
+// recomputed only when the player enters another PVS tile
+void CSceneRenderer::updateVisibleChunks(const sim::CWorld& world, const sim::Vec3& eye) {
+	const sim::CVisibility& pvs = world.getVisibility();
+	const int from = pvs.isBuilt() ? pvs.tileOf((int)floor((m_originZ - eye.z) / WORLD_SIZE), (int)floor((eye.x - m_originX) / WORLD_SIZE)) : -1;
+	if (from == m_pvsTile) return;
+	m_pvsTile = from;
+
+	const int step = pvs.isBuilt() ? pvs.getTileSize() : CHUNK_CELLS;
+	for (int cr = 0; cr < m_chunkRows; cr++) {
+		for (int cc = 0; cc < m_chunkCols; cc++) {
+			bool seen = from < 0;
+			for (int r = cr * CHUNK_CELLS; !seen && r < (cr + 1) * CHUNK_CELLS && r < world.getRows(); r += step)
+				for (int c = cc * CHUNK_CELLS; !seen && c < (cc + 1) * CHUNK_CELLS && c < world.getCols(); c += step)
+					seen = pvs.isVisible(from, pvs.tileOf(r, c));
+			m_visibleChunks[cr * m_chunkCols + cc] = seen;
+		}
+	}
+}
+
+bool CSceneRenderer::isVisible(int chunk, const Float3& lo, const Float3& hi) const {
+	if (!m_culling) return true;
+	if (chunk >= 0 && !m_visibleChunks[chunk]) return false;
+	return m_frustum.intersects(lo, hi);
+}
+
+bool CSceneRenderer::drawFrame(const sim::CWorld& world) {
+	sim::captureSnapshot(world, 0, m_current);
+	return drawFrame(world, m_current);
+}
+
+bool CSceneRenderer::drawFrame(const sim::CWorld& world, const sim::Snapshot& state) {
+	PROFILE_SCOPE("draw");
+	if (m_backend == NULL) return false;
+	{
+		PROFILE_SCOPE("clear");
+		if (!m_backend->beginFrame(CLEAR_COLOR)) return false;
+	}
+	m_hasMaterial = false;
+	m_lighting = true;
+	m_cull.transforms_built = 0;
+
+	const sim::Vec3 eye = state.eye;
+	const sim::Vec3 look = state.look;
+	m_view = Mat4::lookAtLH(toFloat3(eye), Float3((float)(eye.x + look.x), (float)(eye.y + look.y), (float)(eye.z + look.z)),
+		Float3(0.0f, 2.0f, 0.0f));
+	m_backend->setCamera(m_view, m_proj);
+	if (m_culling) {
+		m_frustum = Frustum::fromMatrix(m_view * m_proj);
+		updateVisibleChunks(world, eye);
+	}
+
+	drawStatic();
+	drawEnemies(world, state);
+	drawBullets(world, state);
+
+	setMaterial(Material(BLUE));
+	drawSphere(m_aimPoint, sim::Vec3(eye.x + look.x * 0.125, eye.y + look.y * 0.125, eye.z + look.z * 0.125), eye, &m_aimPlacement);
+
+	setMaterial(Material(WHITE, 2.0f));
+	drawAt(m_lightMesh, m_lightPlacement, sim::Vec3(m_light.position.x, m_light.position.y, m_light.position.z));
+
+	PROFILE_SCOPE("present");
+	m_backend->endFrame();
+	return true;
+}
+
+void CSceneRenderer::drawStatic() {
+	PROFILE_SCOPE("draw static");
+	m_cull.static_drawn = 0;
+	if (m_batching) {
+		m_cull.static_total = (int)m_batches.size();
+		m_backend->setTransform(Mat4::identity());
+		for (size_t i = 0; i < m_batches.size(); i++) {
+			if (!isVisible(m_batches[i].chunk, m_batches[i].lo, m_batches[i].hi)) continue;
+			setLighting(!m_batches[i].baked);
+			if (!m_batches[i].baked) setMaterial(m_batches[i].material);
+			m_backend->drawBuffer(m_batches[i].buffer);
+			m_cull.static_drawn++;
+		}
+		setLighting(true);
+	}
+	else {
+		m_cull.static_total = (int)m_boxes.size();
+		for (size_t i = 0; i < m_boxes.size(); i++) {
+			if (!isVisible(m_boxes[i].chunk, m_boxes[i].lo, m_boxes[i].hi)) continue;
+			m_backend->setTransform(m_boxes[i].transform);
+			setMaterial(m_boxes[i].material);
+			m_backend->drawMesh(m_boxes[i].mesh);
+			m_cull.static_drawn++;
+		}
+	}
+}
+
+// bodies then heads so equal materials follow each other; the box sizes are the ones the
+// meshes were made with, so only the snapshot is read here
+void CSceneRenderer::drawEnemies(const sim::CWorld& world, const sim::Snapshot& state) {
+	PROFILE_SCOPE("draw enemies");
+	const sim::Vec3 eye = state.eye;
+	const std::vector<sim::EnemyState>& enemies = state.enemies;
+	m_enemyShown.assign(enemies.size(), 0);
+	m_cull.enemies_drawn = 0;
+	for (size_t i = 0; i < enemies.size() && i * 2 < m_enemySizes.size(); i++) {
+		if (!enemies[i].alive) continue;
+		if (m_culling) {
+			const sim::Vec3 bp = enemies[i].body, hp = enemies[i].head;
+			if (!world.isPotentiallyVisible(eye, bp)) continue;
+			const Float3& bs = m_enemySizes[i * 2];
+			const Float3& hs = m_enemySizes[i * 2 + 1];
+			Float3 lo((float)(bp.x - bs.x / 2), (float)(bp.y - bs.y / 2), (float)(bp.z - bs.z / 2));
+			Float3 hi((float)(bp.x + bs.x / 2), (float)(hp.y + hs.y / 2), (float)(bp.z + bs.z / 2));
+			if (!m_frustum.intersects(lo, hi)) continue;
+		}
+		m_enemyShown[i] = 1;
+		m_cull.enemies_drawn++;
+	}
+	for (int part = 0; part < 2; part++) {
+		for (size_t i = 0; i < m_enemyShown.size(); i++) {
+			if (!m_enemyShown[i]) continue;
+			const int life = enemies[i].life;
+			Color color = part == 0 ? CYAN : GREEN;
+			if (life >= 1 && life <= 2) color = part == 0 ? bodyHit[life - 1] : headHit[life - 1];
+			setMaterial(Material(color));
+			drawAt(m_enemyMeshes[i * 2 + part], m_enemyPlacements[i * 2 + part], part == 0 ? enemies[i].body : enemies[i].head);
+		}
+	}
+}
+
+// the player's bullets first
+void CSceneRenderer::drawBullets(const sim::CWorld& world, const sim::Snapshot& state) {
+	PROFILE_SCOPE("draw bullets");
+	const sim::Vec3 eye = state.eye;
+	const std::vector<sim::BulletState>& bullets = state.bullets;
+	const float r = m_bullet.radius;
+	m_cull.bullets_drawn = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		for (size_t k = 0; k < bullets.size(); k++) {
+			const bool mine = bullets[k].owner == OWNER_PLAYER;
+			if (mine != (pass == 0)) continue;
+			const sim::Vec3 c = bullets[k].center;
+			if (m_culling) {
+				if (!world.isPotentiallyVisible(eye, c)) continue;
+				if (!m_frustum.intersects(Float3((float)c.x - r, (float)c.y - r, (float)c.z - r), Float3((float)c.x + r, (float)c.y + r, (float)c.z + r))) continue;
+			}
+			m_cull.bullets_drawn++;
+			setMaterial(Material(mine ? BLACK : RED));
+			drawSphere(m_bullet, c, eye);
+		}
+	}
+}
+
+}
@@ -0,0 +1,163 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: sceneRenderer.h
+//
+// Desc: Turns the simulation state into a frame of IRenderBackend calls: the baked static
+//       level batches first, then enemies, bullets, the aim point and the light marker.
+//       Walls and floor carry the level's lights in their vertex colors (lightBaker.h) and
+//       are drawn unlit; everything else is lit by one point light over the map.
+//       Static geometry is cut into square chunks of the map; a chunk, enemy or bullet is
+//       only drawn when the level's PVS lets the player's cell see it and it touches the
+//       view frustum.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __sceneRendererH__
+#define __sceneRendererH__
+
+#include "gameSim.h"
+#include "snapshot.h"
+#include "renderBackend.h"
+#include "levelBatch.h"
+#include "lightBaker.h"
+#include "meshCache.h"
+#include <vector>
+
+namespace render
+{
+	class CSceneRenderer {
+	public:
+		CSceneRenderer(void);
+
+		// false draws every static box on its own, the way the level was drawn before batching;
+		// has to be chosen before create()
+		void setBatching(bool enable) { m_batching = enable; }
+		// PVS and frustum culling (default on); the PVS part needs the world's culling on
+		void setCulling(bool enable) { m_culling = enable; }
+		// bake the level's lights into the walls and floor (default on, needs batching);
+		// off lights them with the point light like the moving objects. Chosen before create()
+		void setBakedLighting(bool enable) { m_bakeLighting = enable; }
+		// threads the bake runs on, 0 for every core
+		void setBakeThreads(int threads) { m_baker.setThreads(threads); }
+
+		struct CullStats
+		{
+			int static_drawn, static_total;     // batches, or boxes when batching is off
+			int enemies_drawn, bullets_drawn;
+			int transforms_built;               // world matrices of moving objects rebuilt this frame
+		};
+
+		bool create(IRenderBackend* backend, const sim::CWorld& world, int width, int height);
+		void destroy();
+		// the world's current state
+		bool drawFrame(const sim::CWorld& world);
+		// a snapshot of the moving parts, e.g. a blend of two ticks from a simulation thread;
+		// only what the level load built is read from the world
+		bool drawFrame(const sim::CWorld& world, const sim::Snapshot& state);
+
+		const Mat4& getView() const { return m_view; }
+		const Mat4& getProj() const { return m_proj; }
+		int getStaticBoxes() const { return m_staticBoxes; }
+		int getStaticBatches() const { return (int)m_batches.size(); }
+		const CMeshCache& getMeshCache() const { return m_cache; }
+		const CullStats& getCullStats() const { return m_cull; }
+		// all zero unless the last create() baked
+		const BakeStats& getBakeStats() const { return m_bakeStats; }
+
+	private:
+		struct Batch
+		{
+			BufferHandle buffer;
+			Material material;
+			int chunk;          // -1 = not culled by the PVS
+			bool baked;
+			Float3 lo, hi;
+		};
+
+		struct Box
+		{
+			MeshHandle mesh;
+			Mat4 transform;
+			Material material;
+			int chunk;
+			Float3 lo, hi;
+		};
+
+		// the world matrix of something that can move, rebuilt only when it is drawn
+		// somewhere else than the last time
+		struct Placement
+		{
+			Placement() : valid(false) {}
+
+			Float3 position;
+			Mat4 transform;
+			bool valid;
+		};
+
+		// one cached mesh per tessellation level
+		struct LodSphere
+		{
+			float radius;
+			MeshHandle lod[SPHERE_LODS];
+		};
+
+		bool addStatic(const sim::CWall& wall, const Material& material, CStaticBatcher& batcher, bool split);
+		bool addPiece(const Float3& center, const Float3& size, const Material& material, int chunk, CStaticBatcher& batcher);
+		bool addBatches(const std::vector<StaticBatch>& batches);
+		int chunkOf(double x, double z) const;
+		void updateVisibleChunks(const sim::CWorld& world, const sim::Vec3& eye);
+		bool isVisible(int chunk, const Float3& lo, const Float3& hi) const;
+		bool createSphere(LodSphere& sphere, float radius);
+		void releaseSphere(LodSphere& sphere);
+		void setMaterial(const Material& material);
+		void setLighting(bool enable);
+		void drawAt(MeshHandle mesh, const sim::Vec3& position);
+		void drawAt(MeshHandle mesh, Placement& placement, const sim::Vec3& position);
+		void drawSphere(const LodSphere& sphere, const sim::Vec3& position, const sim::Vec3& eye, Placement* placement = NULL);
+		void drawStatic();
+		void drawEnemies(const sim::CWorld& world, const sim::Snapshot& state);
+		void drawBullets(const sim::CWorld& world, const sim::Snapshot& state);
+
+		IRenderBackend*		m_backend;
+		CMeshCache			m_cache;
+		bool				m_batching;
+		bool				m_culling;
+		bool				m_bakeLighting;
+		CLightBaker			m_baker;
+		BakeStats			m_bakeStats;
+
+		std::vector<Batch>	m_batches;
+		std::vector<Box>	m_boxes;        // unbatched static geometry
+		int					m_staticBoxes;
+
+		std::vector<MeshHandle>	m_enemyMeshes;  // body, head per enemy
+		std::vector<Float3>		m_enemySizes;   // the boxes the meshes were made from
+		std::vector<Placement>	m_enemyPlacements;  // same order as the meshes
+		std::vector<unsigned char>	m_enemyShown;   // survived culling this frame
+		sim::Snapshot		m_current;      // the world captured by drawFrame(world)
+		LodSphere			m_bullet;       // player and enemy bullets differ only in material
+		LodSphere			m_aimPoint;
+		Placement			m_aimPlacement;
+		MeshHandle			m_lightMesh;
+		Placement			m_lightPlacement;
+		PointLight			m_light;
+
+		Mat4				m_view;
+		Mat4				m_proj;
+		float				m_pixelScale;   // screen pixels per world unit at distance 1
+
+		// chunk grid over the map and which chunks the player's PVS tile can see
+		int					m_chunkCols, m_chunkRows;
+		double				m_originX, m_originZ;
+		std::vector<unsigned char>	m_visibleChunks;
+		int					m_pvsTile;
+		Frustum				m_frustum;
+		CullStats			m_cull;
+
+		Material			m_lastMaterial;
+		bool				m_hasMaterial;
+		bool				m_lighting;
+	};
+}
+
+#endif // __sceneRendererH__
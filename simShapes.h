@@ -0,0 +1,118 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: simShapes.h
+//
+// Desc: Simulation primitives shared by the game logic and the collision structures:
+//       bullets (spheres) and axis aligned boxes.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __simShapesH__
+#define __simShapesH__
+
+#define M_RADIUS 0.05   // ball radius
+
+namespace sim
+{
+	struct Vec3
+	{
+		Vec3() : x(0), y(0), z(0) {}
+		Vec3(double ix, double iy, double iz) : x(ix), y(iy), z(iz) {}
+
+		double x, y, z;
+	};
+
+	// -----------------------------------------------------------------------------
+	// CSphere : bullets
+	// -----------------------------------------------------------------------------
+
+	class CSphere {
+	public:
+		CSphere(double radius = M_RADIUS) {
+			center_x = center_y = center_z = 0;
+			m_radius = radius;
+			m_velocity_x = 0;
+			m_velocity_y = 0;
+			m_velocity_z = 0;
+		}
+
+		void ballUpdate(double timeDelta) {
+			setCenter(center_x + m_velocity_x * timeDelta,
+				center_y + m_velocity_y * timeDelta,
+				center_z + m_velocity_z * timeDelta);
+		}
+
+		void setPower(double vx, double vz) { setPowerY(vx, 0, vz); }
+		void setPowerY(double vx, double vy, double vz) {
+			m_velocity_x = vx;
+			m_velocity_y = vy;
+			m_velocity_z = vz;
+		}
+		void setCenter(double x, double y, double z) {
+			center_x = x;	center_y = y;	center_z = z;
+		}
+
+		double getRadius(void) const { return m_radius; }
+		Vec3 getCenter(void) const { return Vec3(center_x, center_y, center_z); }
+		Vec3 getVelocity(void) const { return Vec3(m_velocity_x, m_velocity_y, m_velocity_z); }
+
+	private:
+		double					center_x, center_y, center_z;
+		double                  m_radius;
+		double					m_velocity_x;
+		double					m_velocity_y;
+		double					m_velocity_z;
+	};
+
+	// -----------------------------------------------------------------------------
+	// CWall : axis aligned box (map walls, floor, ceiling, flag, enemy hitboxes)
+	// -----------------------------------------------------------------------------
+
+	class CWall {
+	public:
+		CWall(void) {
+			m_x = m_y = m_z = 0;
+			m_width = m_height = m_depth = 0;
+		}
+		CWall(double iwidth, double iheight, double idepth) {
+			m_x = m_y = m_z = 0;
+			setSize(iwidth, iheight, idepth);
+		}
+
+		void setSize(double iwidth, double iheight, double idepth) {
+			m_width = iwidth;
+			m_height = iheight;
+			m_depth = idepth;
+		}
+		void setPosition(double x, double y, double z) {
+			m_x = x;
+			m_y = y;
+			m_z = z;
+		}
+
+		bool hasIntersected(const CSphere& ball) const {
+			Vec3 ball_center = ball.getCenter();
+			double ball_radius = ball.getRadius();
+			if (ball_center.z + ball_radius > m_z - m_depth / 2 &&
+				ball_center.z - ball_radius < m_z + m_depth / 2 &&
+				ball_center.y + ball_radius > m_y - m_height / 2 &&
+				ball_center.y - ball_radius < m_y + m_height / 2 &&
+				ball_center.x + ball_radius > m_x - m_width / 2 &&
+				ball_center.x - ball_radius < m_x + m_width / 2) return true;
+			return false;
+		}
+
+		Vec3 getPosition(void) const { return Vec3(m_x, m_y, m_z); }
+		Vec3 getSize(void) const { return Vec3(m_width, m_height, m_depth); }
+
+	private:
+		double					m_x;
+		double					m_y;
+		double					m_z;
+		double                  m_width;
+		double					m_height;
+		double                  m_depth;
+	};
+}
+
+#endif // __simShapesH__
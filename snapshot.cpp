@@ -0,0 +1,230 @@
+#include "snapshot.h"
+#include "profiler.h"
+#include <cmath>
+
+namespace sim
+{
+
+static const int MAX_CATCH_UP = 8;     // ticks run back to back before the clock is let go
+
+void captureSnapshot(const CWorld& world, double time, Snapshot& out) {
+	out.tick = world.getTick();
+	out.time = time;
+	out.eye = world.getPlayerPosition();
+	out.look = world.getLookDirection();
+	out.life = world.getLife();
+	out.status = world.getStatus();
+
+	out.players.resize(world.getPlayerCount());
+	for (int p = 0; p < world.getPlayerCount(); p++) {
+		const Player& player = world.getPlayer(p);
+		PlayerState& s = out.players[p];
+		s.position = world.getPlayerPosition(p);
+		s.look = Vec3(player.target_x, player.target_y, player.target_z);
+		s.life = player.life;
+		s.active = player.active;
+	}
+
+	const CEnemyPool& enemies = world.getEnemies();
+	const CArenaArray<CWall>& boxes = world.getHitboxes();
+	out.enemies.resize(enemies.size());
+	for (int i = 0; i < enemies.size(); i++) {
+		EnemyState& e = out.enemies[i];
+		e.body = boxes[i * 2].getPosition();
+		e.head = boxes[i * 2 + 1].getPosition();
+		e.life = enemies.getLife(i);
+		e.alive = enemies.isAlive(i);
+	}
+
+	const CProjectilePool& bullets = world.getProjectiles();
+	out.bullets.resize(bullets.size());
+	for (int k = 0; k < bullets.size(); k++) {
+		out.bullets[k].center = bullets.getCenter(k);
+		out.bullets[k].velocity = bullets.getVelocity(k);
+		out.bullets[k].owner = bullets.getOwner(k);
+	}
+}
+
+static Vec3 lerp(const Vec3& a, const Vec3& b, double t) {
+	return Vec3(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+}
+
+void interpolateSnapshots(const Snapshot& prev, const Snapshot& curr, double alpha, Snapshot& out) {
+	out.tick = curr.tick;
+	out.time = prev.time + (curr.time - prev.time) * alpha;
+	out.life = curr.life;
+	out.status = curr.status;
+	out.eye = lerp(prev.eye, curr.eye, alpha);
+	out.look = lerp(prev.look, curr.look, alpha);
+	const double length = sqrt(out.look.x * out.look.x + out.look.y * out.look.y + out.look.z * out.look.z);
+	if (length > 0) out.look = Vec3(out.look.x / length, out.look.y / length, out.look.z / length);
+	else out.look = curr.look;
+
+	// players come and go between snapshots; a slot that changed hands is drawn where it is now
+	out.players.resize(curr.players.size());
+	for (size_t p = 0; p < curr.players.size(); p++) {
+		out.players[p] = curr.players[p];
+		if (p < prev.players.size() && prev.players[p].active && curr.players[p].active)
+			out.players[p].position = lerp(prev.players[p].position, curr.players[p].position, alpha);
+	}
+
+	// a level restart in between changes the enemy list; draw curr as it is then
+	const bool same = prev.enemies.size() == curr.enemies.size();
+	out.enemies.resize(curr.enemies.size());
+	for (size_t i = 0; i < curr.enemies.size(); i++) {
+		out.enemies[i] = curr.enemies[i];
+		if (!same) continue;
+		out.enemies[i].body = lerp(prev.enemies[i].body, curr.enemies[i].body, alpha);
+		out.enemies[i].head = lerp(prev.enemies[i].head, curr.enemies[i].head, alpha);
+	}
+
+	// bullets are one tick behind like everything else: back from curr by the part of the
+	// tick that is left
+	const double back = (1 - alpha) * (curr.time - prev.time);
+	out.bullets.resize(curr.bullets.size());
+	for (size_t k = 0; k < curr.bullets.size(); k++) {
+		const BulletState& b = curr.bullets[k];
+		out.bullets[k] = b;
+		out.bullets[k].center = Vec3(b.center.x - b.velocity.x * back, b.center.y - b.velocity.y * back, b.center.z - b.velocity.z * back);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// CSnapshotBuffer
+// -----------------------------------------------------------------------------
+
+CSnapshotBuffer::CSnapshotBuffer(void) {
+	reset();
+}
+
+void CSnapshotBuffer::reset() {
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_prev = &m_slots[0];
+	m_curr = &m_slots[1];
+	m_back = &m_slots[2];
+	m_published = m_read = 0;
+}
+
+// the oldest snapshot becomes the next one to write
+void CSnapshotBuffer::publish() {
+	std::lock_guard<std::mutex> guard(m_lock);
+	Snapshot* oldest = m_prev;
+	m_prev = m_curr;
+	m_curr = m_back;
+	m_back = oldest;
+	m_published++;
+}
+
+bool CSnapshotBuffer::read(Snapshot& prev, Snapshot& curr) {
+	std::lock_guard<std::mutex> guard(m_lock);
+	if (m_published < 2 || m_published == m_read) return false;
+	prev = *m_prev;
+	curr = *m_curr;
+	m_read = m_published;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// CSimThread
+// -----------------------------------------------------------------------------
+
+CSimThread::CSimThread(void) : m_world(NULL), m_recorder(NULL), m_dt(1.0 / 120), m_quit(false), m_running(false), m_ticks(0), m_dropped(0) {
+	m_epoch = std::chrono::steady_clock::now();
+}
+
+CSimThread::~CSimThread(void) {
+	stop();
+}
+
+double CSimThread::now() const {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_epoch).count();
+}
+
+double CSimThread::getAlpha(const Snapshot& prev, const Snapshot& curr) const {
+	if (curr.time <= prev.time) return 1;
+	const double alpha = (now() - m_dt - prev.time) / (curr.time - prev.time);
+	return alpha < 0 ? 0 : alpha > 1 ? 1 : alpha;
+}
+
+void CSimThread::start(CWorld& world, double hz) {
+	stop();
+	m_world = &world;
+	m_dt = 1.0 / hz;
+	m_input = Input();
+	m_ticks = 0;
+	m_dropped = 0;
+	m_snapshots.reset();
+
+	// two snapshots of the starting state, so there is something to draw right away
+	const double t = now();
+	captureSnapshot(world, t - m_dt, m_snapshots.getBack());
+	m_snapshots.publish();
+	captureSnapshot(world, t, m_snapshots.getBack());
+	m_snapshots.publish();
+
+	m_quit = false;
+	m_running = true;
+	m_thread = std::thread(&CSimThread::main, this);
+}
+
+void CSimThread::stop() {
+	if (!m_thread.joinable()) return;
+	m_quit = true;
+	m_thread.join();
+	m_running = false;
+}
+
+void CSimThread::addInput(const Input& input) {
+	std::lock_guard<std::mutex> guard(m_inputLock);
+	m_input.forward = input.forward;
+	m_input.back = input.back;
+	m_input.left = input.left;
+	m_input.right = input.right;
+	m_input.fire = m_input.fire || input.fire;
+	m_input.look_h += input.look_h;
+	m_input.look_v += input.look_v;
+}
+
+// ticks are due every m_dt seconds; a late thread runs the missed ones back to back, up to
+// MAX_CATCH_UP, and drops the rest rather than spiralling
+void CSimThread::main() {
+	CProfiler::setThreadName("simulation");
+	CWorld& world = *m_world;
+	double due = now() + m_dt;
+	while (!m_quit) {
+		const double t = now();
+		if (t < due) {
+			std::this_thread::sleep_for(std::chrono::duration<double>(due - t));
+			continue;
+		}
+
+		for (int k = 0; k < MAX_CATCH_UP && due <= t && world.getStatus() == GAME_RUNNING; k++) {
+			Input input;
+			{
+				std::lock_guard<std::mutex> guard(m_inputLock);
+				input = m_input;
+				m_input.fire = false;
+				m_input.look_h = m_input.look_v = 0;
+			}
+			world.tick(m_dt, input);
+			if (m_recorder) m_recorder->record(input, world.getStateHash());
+			m_ticks++;
+			due += m_dt;
+		}
+		if (due <= t) {
+			const unsigned long behind = (unsigned long)((t - due) / m_dt) + 1;
+			m_dropped += behind;
+			due += behind * m_dt;
+		}
+
+		{
+			PROFILE_SCOPE("snapshot");
+			captureSnapshot(world, due - m_dt, m_snapshots.getBack());
+			m_snapshots.publish();
+		}
+		if (world.getStatus() != GAME_RUNNING) break;
+	}
+	m_running = false;
+}
+
+}
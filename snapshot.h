@@ -0,0 +1,141 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: snapshot.h
+//
+// Desc: What the renderer needs of one simulation tick, copied out of the world so it can
+//       be drawn while the simulation thread works on the next tick. CSnapshotBuffer hands
+//       the last two published snapshots to the render thread, which draws a blend of
+//       them; CSimThread runs the world at a fixed tick rate and publishes into it.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __snapshotH__
+#define __snapshotH__
+
+#include "gameSim.h"
+#include "inputLog.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sim
+{
+	struct EnemyState
+	{
+		Vec3 body, head;    // box centers
+		int life;
+		bool alive;
+	};
+
+	struct PlayerState
+	{
+		Vec3 position, look;
+		int life;
+		bool active;
+	};
+
+	struct BulletState
+	{
+		Vec3 center, velocity;
+		int owner;
+	};
+
+	struct Snapshot
+	{
+		Snapshot() : tick(0), time(0), life(0), status(GAME_LOST) {}
+
+		unsigned long tick;
+		double time;        // seconds on the publishing clock
+		Vec3 eye, look;
+		int life;
+		GameStatus status;
+		std::vector<PlayerState> players;   // every slot, the local player's included
+		std::vector<EnemyState> enemies;
+		std::vector<BulletState> bullets;
+	};
+
+	// reuses the vectors of out, so a steady state capture does not allocate
+	void captureSnapshot(const CWorld& world, double time, Snapshot& out);
+	// alpha 0 gives prev, 1 gives curr; players and enemies are matched by index, bullets (whose pool
+	// slots move around) are carried forward from curr along their velocity
+	void interpolateSnapshots(const Snapshot& prev, const Snapshot& curr, double alpha, Snapshot& out);
+
+	// -----------------------------------------------------------------------------
+	// CSnapshotBuffer : one writer, one reader
+	// -----------------------------------------------------------------------------
+
+	class CSnapshotBuffer {
+	public:
+		CSnapshotBuffer(void);
+
+		// the writer fills getBack() and then publishes it as the newest snapshot
+		Snapshot& getBack() { return *m_back; }
+		void publish();
+		void reset();
+
+		// copies the two newest snapshots when something was published since the last
+		// call; false (and nothing copied) otherwise or before two snapshots exist
+		bool read(Snapshot& prev, Snapshot& curr);
+		unsigned long getPublished() const { return m_published; }
+
+	private:
+		Snapshot			m_slots[3];
+		Snapshot*			m_prev;
+		Snapshot*			m_curr;
+		Snapshot*			m_back;
+		std::mutex			m_lock;
+		unsigned long		m_published;
+		unsigned long		m_read;
+	};
+
+	// -----------------------------------------------------------------------------
+	// CSimThread : ticks a world at a fixed rate on its own thread
+	// -----------------------------------------------------------------------------
+
+	class CSimThread {
+	public:
+		CSimThread(void);
+		~CSimThread(void);
+
+		// the world belongs to the thread until stop(); ticking ends by itself when the game does
+		void start(CWorld& world, double hz);
+		void stop();
+		bool isRunning() const { return m_running.load(); }
+
+		// merged into the input of the next tick: held keys are replaced, mouse movement
+		// adds up and a click is kept until a tick has seen it
+		void addInput(const Input& input);
+		// every tick's input and state hash go to the log; set before start()
+		void setRecorder(CInputLog* log) { m_recorder = log; }
+
+		CSnapshotBuffer& getSnapshots() { return m_snapshots; }
+		double getTickSeconds() const { return m_dt; }
+		// seconds on the clock the snapshots are stamped with
+		double now() const;
+		// where between prev and curr a frame drawn now sits; frames are drawn one tick
+		// behind the simulation so there is always a later snapshot to blend towards
+		double getAlpha(const Snapshot& prev, const Snapshot& curr) const;
+		unsigned long getTicks() const { return m_ticks.load(); }
+		unsigned long getDroppedTicks() const { return m_dropped.load(); }
+
+	private:
+		void main();
+
+		CWorld*				m_world;
+		CInputLog*			m_recorder;
+		double				m_dt;
+		std::thread			m_thread;
+		std::atomic<bool>	m_quit;
+		std::atomic<bool>	m_running;
+		std::atomic<unsigned long>	m_ticks;
+		std::atomic<unsigned long>	m_dropped;     // ticks skipped after falling too far behind
+		std::mutex			m_inputLock;
+		Input				m_input;
+		CSnapshotBuffer		m_snapshots;
+		std::chrono::steady_clock::time_point m_epoch;
+	};
+}
+
+#endif // __snapshotH__
@@ -0,0 +1,174 @@
+#include "udpSocket.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mutex>
+typedef int socklen_t;
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace sim
+{
+
+#ifdef _WIN32
+static const uintptr_t NO_SOCKET = (uintptr_t)INVALID_SOCKET;
+
+// Winsock stays up until the process ends once any socket was opened
+static bool startup() {
+	static std::once_flag once;
+	static bool ok = false;
+	std::call_once(once, []() {
+		WSADATA data;
+		ok = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	});
+	return ok;
+}
+
+static bool wouldBlock() {
+	const int error = WSAGetLastError();
+	// a send to a closed port comes back as a reset on the next receive
+	return error == WSAEWOULDBLOCK || error == WSAECONNRESET;
+}
+#else
+static const uintptr_t NO_SOCKET = (uintptr_t)-1;
+
+static bool startup() { return true; }
+
+static bool wouldBlock() {
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNREFUSED || errno == EINTR;
+}
+#endif
+
+bool parseAddress(const char* text, NetAddress& out) {
+	const char* colon = strrchr(text, ':');
+	if (colon == NULL || colon[1] == '\0') return false;
+	char* end = NULL;
+	const unsigned long port = strtoul(colon + 1, &end, 10);
+	if (*end != '\0' || port == 0 || port > 65535) return false;
+
+	uint32_t ip = 0;
+	if ((size_t)(colon - text) == strlen("localhost") && !strncmp(text, "localhost", colon - text)) ip = NET_LOOPBACK;
+	else {
+		const char* p = text;
+		for (int k = 0; k < 4; k++) {
+			const unsigned long part = strtoul(p, &end, 10);
+			if (end == p || part > 255 || (k < 3 ? *end != '.' : end != colon)) return false;
+			ip = (ip << 8) | (uint32_t)part;
+			p = end + 1;
+		}
+	}
+	out = NetAddress(ip, (uint16_t)port);
+	return true;
+}
+
+CUdpSocket::CUdpSocket(void) {
+	m_socket = NO_SOCKET;
+	m_port = 0;
+}
+
+CUdpSocket::~CUdpSocket(void) {
+	close();
+}
+
+bool CUdpSocket::isOpen() const {
+	return m_socket != NO_SOCKET;
+}
+
+bool CUdpSocket::open(uint32_t ip, uint16_t port) {
+	close();
+	if (!startup()) return false;
+#ifdef _WIN32
+	SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (s == INVALID_SOCKET) return false;
+	u_long nonblocking = 1;
+	bool ok = ioctlsocket(s, FIONBIO, &nonblocking) == 0;
+#else
+	int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (s < 0) return false;
+	bool ok = fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+	m_socket = (uintptr_t)s;
+
+	// a server answering many clients in one burst needs more than the default buffers
+	int buffer = 1 << 20;
+	setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*)&buffer, sizeof(buffer));
+	setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char*)&buffer, sizeof(buffer));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(ip);
+	addr.sin_port = htons(port);
+	socklen_t length = sizeof(addr);
+	ok = ok && bind(s, (const sockaddr*)&addr, sizeof(addr)) == 0;
+	ok = ok && getsockname(s, (sockaddr*)&addr, &length) == 0;
+	if (!ok) {
+		close();
+		return false;
+	}
+	m_port = ntohs(addr.sin_port);
+	return true;
+}
+
+void CUdpSocket::close() {
+	if (m_socket == NO_SOCKET) return;
+#ifdef _WIN32
+	closesocket((SOCKET)m_socket);
+#else
+	::close((int)m_socket);
+#endif
+	m_socket = NO_SOCKET;
+	m_port = 0;
+}
+
+bool CUdpSocket::send(const NetAddress& to, const void* data, size_t size) {
+	if (m_socket == NO_SOCKET || size > NET_MAX_DATAGRAM) return false;
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(to.ip);
+	addr.sin_port = htons(to.port);
+#ifdef _WIN32
+	return sendto((SOCKET)m_socket, (const char*)data, (int)size, 0, (const sockaddr*)&addr, sizeof(addr)) == (int)size;
+#else
+	return sendto((int)m_socket, data, size, 0, (const sockaddr*)&addr, sizeof(addr)) == (ssize_t)size;
+#endif
+}
+
+int CUdpSocket::receive(NetAddress& from, void* data, size_t capacity) {
+	if (m_socket == NO_SOCKET) return -1;
+	for (;;) {
+		sockaddr_in addr;
+		socklen_t length = sizeof(addr);
+#ifdef _WIN32
+		const int n = recvfrom((SOCKET)m_socket, (char*)data, (int)capacity, 0, (sockaddr*)&addr, &length);
+		if (n < 0 && WSAGetLastError() == WSAEMSGSIZE) continue;     // cut off; take the next one
+#else
+		const int n = (int)recvfrom((int)m_socket, data, capacity, 0, (sockaddr*)&addr, &length);
+#endif
+		if (n < 0) {
+			if (!wouldBlock()) return -1;
+			// a refused or interrupted call says nothing about the queue; only an empty one ends the loop
+#ifdef _WIN32
+			if (WSAGetLastError() == WSAEWOULDBLOCK) return 0;
+#else
+			if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+#endif
+			continue;
+		}
+		if (n == 0) continue;     // empty datagrams carry nothing
+		from = NetAddress(ntohl(addr.sin_addr.s_addr), ntohs(addr.sin_port));
+		return n;
+	}
+}
+
+}
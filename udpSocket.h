@@ -0,0 +1,64 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: udpSocket.h
+//
+// Desc: Non-blocking IPv4 UDP socket over Winsock or BSD sockets, just enough for the
+//       game server and its clients: bind, send a datagram, take the next waiting one.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __udpSocketH__
+#define __udpSocketH__
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace sim
+{
+	#define NET_MAX_DATAGRAM 65507     // largest UDP payload over IPv4
+
+	// host byte order
+	struct NetAddress
+	{
+		NetAddress() : ip(0), port(0) {}
+		NetAddress(uint32_t ip_, uint16_t port_) : ip(ip_), port(port_) {}
+
+		bool operator==(const NetAddress& other) const { return ip == other.ip && port == other.port; }
+		bool operator!=(const NetAddress& other) const { return !(*this == other); }
+
+		uint32_t ip;
+		uint16_t port;
+	};
+
+	#define NET_LOOPBACK 0x7f000001u
+
+	// "a.b.c.d:port" or "localhost:port"; no name lookups
+	bool parseAddress(const char* text, NetAddress& out);
+
+	class CUdpSocket {
+	public:
+		CUdpSocket(void);
+		~CUdpSocket(void);
+
+		// port 0 takes any free one; false if the socket cannot be made or bound
+		bool open(uint32_t ip, uint16_t port);
+		void close();
+		bool isOpen() const;
+		uint16_t getPort() const { return m_port; }
+
+		// false when the datagram was not handed to the system (too big, buffer full)
+		bool send(const NetAddress& to, const void* data, size_t size);
+		// size of the next waiting datagram, copied into data; 0 when none is waiting, -1 on
+		// an error. A datagram longer than capacity is cut off.
+		int receive(NetAddress& from, void* data, size_t capacity);
+
+	private:
+		CUdpSocket(const CUdpSocket&);
+		CUdpSocket& operator=(const CUdpSocket&);
+
+		uintptr_t	m_socket;
+		uint16_t	m_port;
+	};
+}
+
+#endif // __udpSocketH__
@@ -0,0 +1,287 @@
+#include "visibility.h"
+#include "jobSystem.h"
+#include <algorithm>
+#include <chrono>
+
+namespace sim
+{
+
+static const int MAX_TILES = 4096;      // table of at most 4096 x 4096 bits (2 MB)
+
+// quadrants of markSeen(), rows growing downwards
+enum
+{
+	QUADRANT_RIGHT_DOWN = 1,
+	QUADRANT_RIGHT_UP = 2,
+	QUADRANT_LEFT_UP = 4,
+	QUADRANT_LEFT_DOWN = 8,
+};
+
+CVisibility::CVisibility(void) {
+	m_threads = 0;
+	m_cols = m_rows = 0;
+	m_tileSize = 1;
+	m_tileShift = 0;
+	m_tilesX = m_tilesY = 0;
+	m_words = 0;
+	m_buildMs = 0;
+}
+
+void CVisibility::clear() {
+	m_bits.clear();
+	m_cols = m_rows = 0;
+	m_tileSize = 1;
+	m_tileShift = 0;
+	m_tilesX = m_tilesY = 0;
+	m_words = 0;
+	m_buildMs = 0;
+}
+
+// -----------------------------------------------------------------------------
+// precise permissive field of view: a cell is seen from the source cell when some
+// unblocked line joins a point of the one to a point of the other. Each quadrant is
+// walked diagonal by diagonal, keeping the wedges of lines (views) that are still open;
+// wall cells narrow, split or close them.
+// -----------------------------------------------------------------------------
+
+struct FovLine
+{
+	int xi, yi, xf, yf;
+
+	long long relativeSlope(int x, int y) const { return (long long)(yf - yi) * (xf - x) - (long long)(xf - xi) * (yf - y); }
+	bool isBelow(int x, int y) const { return relativeSlope(x, y) > 0; }
+	bool isBelowOrContains(int x, int y) const { return relativeSlope(x, y) >= 0; }
+	bool isAbove(int x, int y) const { return relativeSlope(x, y) < 0; }
+	bool isAboveOrContains(int x, int y) const { return relativeSlope(x, y) <= 0; }
+	bool contains(int x, int y) const { return relativeSlope(x, y) == 0; }
+	bool isCollinear(const FovLine& o) const { return contains(o.xi, o.yi) && contains(o.xf, o.yf); }
+};
+
+// a corner a view's line was bent around; views split from one another share their history
+struct FovBump
+{
+	int x, y;
+	int parent;     // -1 at the end of the list
+};
+
+struct FovView
+{
+	FovLine shallow, steep;
+	int shallowBump, steepBump;
+};
+
+struct FovWalk
+{
+	const unsigned char*	walls;
+	int						cols;
+	int						row, col;       // the source cell
+	int						dx, dy;         // quadrant
+	std::vector<FovView>	views;          // ordered from shallow to steep
+	std::vector<FovBump>	bumps;
+};
+
+static void addShallowBump(FovWalk& w, FovView& v, int x, int y) {
+	v.shallow.xf = x;
+	v.shallow.yf = y;
+	const FovBump bump = { x, y, v.shallowBump };
+	w.bumps.push_back(bump);
+	v.shallowBump = (int)w.bumps.size() - 1;
+	for (int b = v.steepBump; b >= 0; b = w.bumps[b].parent) {
+		if (v.shallow.isAbove(w.bumps[b].x, w.bumps[b].y)) {
+			v.shallow.xi = w.bumps[b].x;
+			v.shallow.yi = w.bumps[b].y;
+		}
+	}
+}
+
+static void addSteepBump(FovWalk& w, FovView& v, int x, int y) {
+	v.steep.xf = x;
+	v.steep.yf = y;
+	const FovBump bump = { x, y, v.steepBump };
+	w.bumps.push_back(bump);
+	v.steepBump = (int)w.bumps.size() - 1;
+	for (int b = v.shallowBump; b >= 0; b = w.bumps[b].parent) {
+		if (v.steep.isBelow(w.bumps[b].x, w.bumps[b].y)) {
+			v.steep.xi = w.bumps[b].x;
+			v.steep.yi = w.bumps[b].y;
+		}
+	}
+}
+
+// drops the view once its two lines meet in a line through the source's far corners;
+// false when it was dropped
+static bool checkView(FovWalk& w, int index) {
+	const FovView& v = w.views[index];
+	if (v.shallow.isCollinear(v.steep) && (v.shallow.contains(0, 1) || v.shallow.contains(1, 0))) {
+		w.views.erase(w.views.begin() + index);
+		return false;
+	}
+	return true;
+}
+
+// cell (x, y) of the quadrant; view is the first view that may hold it, advanced past the
+// ones the cell lies beyond
+static void visitCell(FovWalk& w, int x, int y, int& view, const CVisibility& pvs, uint64_t* bits) {
+	const int topLeftX = x, topLeftY = y + 1;
+	const int bottomRightX = x + 1, bottomRightY = y;
+	while (view < (int)w.views.size() && w.views[view].steep.isBelowOrContains(bottomRightX, bottomRightY)) view++;
+	if (view == (int)w.views.size() || w.views[view].shallow.isAboveOrContains(topLeftX, topLeftY)) return;
+
+	const int row = w.row + y * w.dy, col = w.col + x * w.dx;
+	const int tile = pvs.tileOf(row, col);
+	bits[tile >> 6] |= (uint64_t)1 << (tile & 63);
+	if (!w.walls[(size_t)row * w.cols + col]) return;
+
+	FovView& v = w.views[view];
+	const bool shallowAbove = v.shallow.isAbove(bottomRightX, bottomRightY);
+	const bool steepBelow = v.steep.isBelow(topLeftX, topLeftY);
+	if (shallowAbove && steepBelow) {
+		w.views.erase(w.views.begin() + view);
+	}
+	else if (shallowAbove) {
+		addShallowBump(w, v, topLeftX, topLeftY);
+		checkView(w, view);
+	}
+	else if (steepBelow) {
+		addSteepBump(w, v, bottomRightX, bottomRightY);
+		checkView(w, view);
+	}
+	else {
+		// the wall sits inside the view: one copy passes below it, one above
+		const FovView copy = v;
+		w.views.insert(w.views.begin() + view, copy);
+		int shallowView = view, steepView = view + 1;
+		view++;
+		addSteepBump(w, w.views[shallowView], bottomRightX, bottomRightY);
+		if (!checkView(w, shallowView)) {
+			view--;
+			steepView--;
+		}
+		addShallowBump(w, w.views[steepView], topLeftX, topLeftY);
+		checkView(w, steepView);
+	}
+}
+
+static void walkQuadrant(FovWalk& w, int extentX, int extentY, const CVisibility& pvs, uint64_t* bits) {
+	w.views.clear();
+	w.bumps.clear();
+	FovView first;
+	first.shallow.xi = 0;	first.shallow.yi = 1;	first.shallow.xf = extentX;	first.shallow.yf = 0;
+	first.steep.xi = 1;		first.steep.yi = 0;		first.steep.xf = 0;			first.steep.yf = extentY;
+	first.shallowBump = first.steepBump = -1;
+	w.views.push_back(first);
+
+	for (int i = 1; i <= extentX + extentY && !w.views.empty(); i++) {
+		int view = 0;
+		const int firstJ = i > extentX ? i - extentX : 0, lastJ = i < extentY ? i : extentY;
+		for (int j = firstJ; j <= lastJ && view < (int)w.views.size(); j++) visitCell(w, i - j, j, view, pvs, bits);
+	}
+}
+
+// marks the tile of every cell the open cell (row, col) sees in the given quadrants,
+// walls that stop the view included
+void CVisibility::markSeen(const unsigned char* walls, int row, int col, int quadrants, FovWalk& walk, uint64_t* bits) const {
+	walk.walls = walls;
+	walk.cols = m_cols;
+	walk.row = row;
+	walk.col = col;
+	const int left = col, right = m_cols - 1 - col, up = row, down = m_rows - 1 - row;
+	if (quadrants & QUADRANT_RIGHT_DOWN) { walk.dx = 1;		walk.dy = 1;	walkQuadrant(walk, right, down, *this, bits); }
+	if (quadrants & QUADRANT_RIGHT_UP) { walk.dx = 1;		walk.dy = -1;	walkQuadrant(walk, right, up, *this, bits); }
+	if (quadrants & QUADRANT_LEFT_UP) { walk.dx = -1;		walk.dy = -1;	walkQuadrant(walk, left, up, *this, bits); }
+	if (quadrants & QUADRANT_LEFT_DOWN) { walk.dx = -1;		walk.dy = 1;	walkQuadrant(walk, left, down, *this, bits); }
+}
+
+// a line from inside a tile to a cell outside it leaves the tile through one of its open
+// border cells and goes on unblocked from there, heading away from the edge it crossed;
+// so the views of the border cells, each over the quadrants that face out of the tile,
+// together hold everything the tile can see. With 1x1 tiles that is the cell itself.
+void CVisibility::markTile(const unsigned char* walls, int tile, FovWalk& walk) {
+	uint64_t* bits = &m_bits[(size_t)tile * m_words];
+	bits[tile >> 6] |= (uint64_t)1 << (tile & 63);
+
+	const int tx = tile % m_tilesX, ty = tile / m_tilesX;
+	const int row0 = ty * m_tileSize, row1 = std::min(row0 + m_tileSize, m_rows) - 1;
+	const int col0 = tx * m_tileSize, col1 = std::min(col0 + m_tileSize, m_cols) - 1;
+	for (int row = row0; row <= row1; row++) {
+		const bool edgeRow = row == row0 || row == row1;
+		for (int col = col0; col <= col1; col += (edgeRow || col == col1) ? 1 : col1 - col0) {
+			if (walls[(size_t)row * m_cols + col]) continue;
+			int quadrants = 0;
+			if (col == col1) quadrants |= QUADRANT_RIGHT_DOWN | QUADRANT_RIGHT_UP;
+			if (col == col0) quadrants |= QUADRANT_LEFT_DOWN | QUADRANT_LEFT_UP;
+			if (row == row1) quadrants |= QUADRANT_RIGHT_DOWN | QUADRANT_LEFT_DOWN;
+			if (row == row0) quadrants |= QUADRANT_RIGHT_UP | QUADRANT_LEFT_UP;
+			markSeen(walls, row, col, quadrants, walk, bits);
+		}
+	}
+}
+
+struct VisibilityJob
+{
+	CVisibility* pvs;
+	const unsigned char* walls;
+	void operator()(int, int begin, int end) {
+		FovWalk walk;
+		for (int tile = begin; tile < end; tile++) pvs->markTile(walls, tile, walk);
+	}
+};
+
+void CVisibility::build(const CLevel& level) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	clear();
+	if (!level.isOpen()) return;
+
+	m_cols = level.getCols();
+	m_rows = level.getRows();
+	m_tileSize = 1;
+	m_tileShift = 0;
+	for (;;) {
+		m_tilesX = (m_cols + m_tileSize - 1) / m_tileSize;
+		m_tilesY = (m_rows + m_tileSize - 1) / m_tileSize;
+		if (m_tilesX * m_tilesY <= MAX_TILES) break;
+		m_tileSize *= 2;
+		m_tileShift++;
+	}
+	const int tiles = m_tilesX * m_tilesY;
+	m_words = (tiles + 63) / 64;
+	m_bits.assign((size_t)tiles * m_words, 0);
+
+	std::vector<unsigned char> walls((size_t)m_cols * m_rows);
+	for (int row = 0; row < m_rows; row++)
+		for (int col = 0; col < m_cols; col++) walls[(size_t)row * m_cols + col] = level.cell(row, col) == CELL_WALL;
+
+	// every tile writes only its own row of the table
+	CJobSystem jobs;
+	jobs.start(m_threads);
+	VisibilityJob job = { this, &walls[0] };
+	jobs.parallelFor(tiles, 4, job);
+	jobs.stop();
+
+	// seeing is mutual; the border cells of one tile can miss a line the other tile's find
+	for (int a = 0; a < tiles; a++) {
+		for (int b = a + 1; b < tiles; b++) {
+			if (isVisible(a, b) || isVisible(b, a)) {
+				m_bits[(size_t)a * m_words + (b >> 6)] |= (uint64_t)1 << (b & 63);
+				m_bits[(size_t)b * m_words + (a >> 6)] |= (uint64_t)1 << (a & 63);
+			}
+		}
+	}
+	m_buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+double CVisibility::getAverageVisible() const {
+	const int tiles = m_tilesX * m_tilesY;
+	if (tiles == 0) return 0;
+	long long sum = 0;
+	for (size_t i = 0; i < m_bits.size(); i++) {
+		uint64_t w = m_bits[i];
+		while (w) {
+			w &= w - 1;
+			sum++;
+		}
+	}
+	return (double)sum / ((double)tiles * tiles);
+}
+
+}
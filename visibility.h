@@ -0,0 +1,71 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: visibility.h
+//
+// Desc: Potentially visible sets for a level, computed at load time. The grid is cut into
+//       square tiles, and a tile sees another when some unblocked line joins a point of
+//       the one to a point of the other (a precise permissive field of view from the
+//       tile's open border cells), so the sets are conservative: whatever CLineOfSight
+//       can see, and whatever the camera can see from inside a tile, is in them. Small
+//       maps use 1x1 tiles, so the sets are per cell; large maps grow the tiles to keep
+//       the table at a few megabytes. Tiles are built on a CJobSystem, each writing only
+//       its own row of the table.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __visibilityH__
+#define __visibilityH__
+
+#include "levelFile.h"
+#include <vector>
+
+namespace sim
+{
+	class CVisibility {
+	public:
+		CVisibility(void);
+
+		void build(const CLevel& level);
+		void clear();
+		// threads for build(), as CJobSystem::start(): 0 for one per hardware thread
+		void setThreads(int threads) { m_threads = threads; }
+
+		bool isBuilt() const { return m_tilesX > 0; }
+		int getTileSize() const { return m_tileSize; }
+		int getTilesX() const { return m_tilesX; }
+		int getTilesY() const { return m_tilesY; }
+
+		// -1 outside the grid
+		int tileOf(int row, int col) const {
+			if (row < 0 || col < 0 || row >= m_rows || col >= m_cols) return -1;
+			return (row >> m_tileShift) * m_tilesX + (col >> m_tileShift);
+		}
+		bool isVisible(int fromTile, int toTile) const {
+			if (fromTile < 0 || toTile < 0) return true;
+			return (m_bits[(size_t)fromTile * m_words + (toTile >> 6)] >> (toTile & 63)) & 1;
+		}
+		bool isCellVisible(int fromRow, int fromCol, int row, int col) const {
+			return isVisible(tileOf(fromRow, fromCol), tileOf(row, col));
+		}
+
+		// share of all tiles the average tile sees, 0..1
+		double getAverageVisible() const;
+		double getBuildMs() const { return m_buildMs; }
+
+	private:
+		friend struct VisibilityJob;
+		void markTile(const unsigned char* walls, int tile, struct FovWalk& walk);
+		void markSeen(const unsigned char* walls, int row, int col, int quadrants, struct FovWalk& walk, uint64_t* bits) const;
+
+		int						m_cols, m_rows;
+		int						m_tileSize;     // power of two
+		int						m_tileShift;
+		int						m_tilesX, m_tilesY;
+		int						m_words;        // 64 bit words per tile row of the table
+		std::vector<uint64_t>	m_bits;
+		double					m_buildMs;
+		int						m_threads;
+	};
+}
+
+#endif // __visibilityH__
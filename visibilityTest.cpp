@@ -0,0 +1,150 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: visibilityTest.cpp
+//
+// Desc: Checks that the potentially visible sets are conservative: every pair of cells
+//       CLineOfSight can see, and the two ends of every unblocked line between random
+//       points of the map, must be visible to each other in CVisibility. Runs on the
+//       built-in level and on generated mazes with 1x1 and larger tiles. Run by CTest;
+//       prints what failed and exits with 1.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gameSim.h"
+#include "mazeGenerator.h"
+#include <cmath>
+#include <cstdio>
+
+static int g_failures = 0;
+
+struct TestRandom
+{
+	explicit TestRandom(uint64_t seed) : state(seed) {}
+
+	uint64_t next() {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		return state >> 33;
+	}
+	int below(int n) { return (int)(next() % (uint64_t)n); }
+	double unit() { return (next() & 0xffffff) / 16777216.0; }
+
+	uint64_t state;
+};
+
+static bool isWall(const sim::CLevel& level, int row, int col) { return level.cell(row, col) == sim::CELL_WALL; }
+
+// the cells the segment passes through, walked the way the light baker does (cell units,
+// columns along x, rows along y); false when one is a wall
+static bool segmentClear(const sim::CLevel& level, double c0, double r0, double c1, double r1) {
+	int col = (int)floor(c0), row = (int)floor(r0);
+	const int lastCol = (int)floor(c1), lastRow = (int)floor(r1);
+	const double dc = c1 - c0, dr = r1 - r0;
+	const int stepCol = dc > 0 ? 1 : -1, stepRow = dr > 0 ? 1 : -1;
+	const double deltaCol = dc != 0 ? fabs(1 / dc) : 1e30, deltaRow = dr != 0 ? fabs(1 / dr) : 1e30;
+	double nextCol = dc > 0 ? (col + 1 - c0) / dc : dc < 0 ? (c0 - col) / -dc : 1e30;
+	double nextRow = dr > 0 ? (row + 1 - r0) / dr : dr < 0 ? (r0 - row) / -dr : 1e30;
+	if (isWall(level, row, col)) return false;
+	for (int n = abs(lastCol - col) + abs(lastRow - row); n > 0; n--) {
+		if (nextCol < nextRow) {
+			col += stepCol;
+			nextCol += deltaCol;
+		}
+		else {
+			row += stepRow;
+			nextRow += deltaRow;
+		}
+		if (isWall(level, row, col)) return false;
+	}
+	return true;
+}
+
+static void missed(const char* name, const char* how, int fromRow, int fromCol, int row, int col) {
+	if (g_failures < 20) printf("FAIL %s: (%d,%d) -> (%d,%d) %s but not in the PVS\n", name, fromRow, fromCol, row, col, how);
+	g_failures++;
+}
+
+// pairs: 0 for all of them, else that many random targets per cell on top of the cells
+// in the same row and column
+static void check(const char* name, const sim::CLevel& level, int pairs, int segments) {
+	sim::CVisibility pvs;
+	pvs.build(level);
+	sim::CLineOfSight los;
+	los.build(level);
+	const int cols = level.getCols(), rows = level.getRows();
+	TestRandom random(12345);
+
+	long long tested = 0, seen = 0;
+	const int failuresBefore = g_failures;
+	for (int r0 = 0; r0 < rows; r0++) {
+		for (int c0 = 0; c0 < cols; c0++) {
+			if (isWall(level, r0, c0)) continue;
+			const int count = pairs ? pairs + rows + cols : rows * cols;
+			for (int k = 0; k < count; k++) {
+				int r1, c1;
+				if (!pairs) { r1 = k / cols; c1 = k % cols; }
+				else if (k < rows) { r1 = k; c1 = c0; }
+				else if (k < rows + cols) { r1 = r0; c1 = k - rows; }
+				else { r1 = random.below(rows); c1 = random.below(cols); }
+				if (isWall(level, r1, c1)) continue;
+				tested++;
+				if (!los.canSee(r0, c0, r1, c1)) continue;
+				seen++;
+				if (!pvs.isCellVisible(r0, c0, r1, c1)) missed(name, "in line of sight", r0, c0, r1, c1);
+			}
+		}
+	}
+
+	int clear = 0;
+	for (int k = 0; k < segments; k++) {
+		const double c0 = 1 + random.unit() * (cols - 2), r0 = 1 + random.unit() * (rows - 2);
+		// mostly short lines, which in a maze are the ones that get through
+		const double reach = k % 4 ? 6 : cols;
+		const double c1 = std::min(cols - 1.0, std::max(1.0, c0 + (random.unit() * 2 - 1) * reach));
+		const double r1 = std::min(rows - 1.0, std::max(1.0, r0 + (random.unit() * 2 - 1) * reach));
+		if (!segmentClear(level, c0, r0, c1, r1)) continue;
+		clear++;
+		if (!pvs.isCellVisible((int)r0, (int)c0, (int)r1, (int)c1)) missed(name, "joined by a clear line", (int)r0, (int)c0, (int)r1, (int)c1);
+	}
+
+	printf("%-12s %dx%d tiles of %d, %lld pairs (%lld in sight), %d clear lines, %.1f%% visible, built in %.1f ms%s\n",
+		name, cols, rows, pvs.getTileSize(), tested, seen, clear, 100.0 * pvs.getAverageVisible(), pvs.getBuildMs(),
+		g_failures > failuresBefore ? "  FAILED" : "");
+}
+
+static bool maze(int size, int tile, double density, sim::CLevel& level) {
+	sim::MazeSettings settings;
+	settings.cols = settings.rows = size;
+	settings.seed = 7;
+	settings.tile = tile;
+	settings.wall_density = density;
+	sim::CMazeGenerator generator;
+	generator.setThreads(1);
+	std::vector<std::string> rows;
+	return generator.generate(settings, rows) && level.fromRows(rows);
+}
+
+int main() {
+	sim::CWorld world;
+	if (!world.load()) {
+		printf("FAIL: the built-in level does not load\n");
+		return 1;
+	}
+	check("built-in", world.getLevel(), 0, 200000);
+
+	sim::CLevel level;
+	if (maze(64, 64, 0.5, level)) check("maze 64", level, 0, 200000);
+	else g_failures++;
+	if (maze(64, 16, 0.3, level)) check("sparse 64", level, 0, 200000);
+	else g_failures++;
+	if (maze(128, 32, 0.35, level)) check("maze 128", level, 300, 400000);
+	else g_failures++;
+	if (maze(512, 64, 0.4, level)) check("maze 512", level, 20, 400000);
+	else g_failures++;
+
+	if (g_failures) {
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
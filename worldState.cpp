@@ -0,0 +1,46 @@
+#include "worldState.h"
+#include <cstdio>
+
+namespace sim
+{
+
+void CStateRing::save(const CWorld& world) {
+	m_newest = (m_newest + 1) % STATE_RING_TICKS;
+	world.saveState(m_states[m_newest]);
+	if (m_count < STATE_RING_TICKS) m_count++;
+}
+
+const std::vector<unsigned char>& CStateRing::get(int back) const {
+	return m_states[(m_newest - back + STATE_RING_TICKS) % STATE_RING_TICKS];
+}
+
+bool CStateRing::rollback(CWorld& world, int back) {
+	if (back < 0 || back >= m_count) return false;
+	const std::vector<unsigned char>& state = get(back);
+	if (!world.loadState(state.data(), state.size())) return false;
+	m_newest = (m_newest - back + STATE_RING_TICKS) % STATE_RING_TICKS;
+	m_count -= back;
+	return true;
+}
+
+bool saveStateFile(const char* path, const CWorld& world) {
+	std::vector<unsigned char> state;
+	world.saveState(state);
+	FILE* f = fopen(path, "wb");
+	if (f == NULL) return false;
+	bool ok = fwrite(state.data(), 1, state.size(), f) == state.size();
+	return fclose(f) == 0 && ok;
+}
+
+bool loadStateFile(const char* path, CWorld& world) {
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) return false;
+	std::vector<unsigned char> state;
+	unsigned char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) state.insert(state.end(), buffer, buffer + n);
+	fclose(f);
+	return world.loadState(state.data(), state.size());
+}
+
+}
@@ -0,0 +1,91 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// File: worldState.h
+//
+// Desc: Binary snapshot of everything in a CWorld that changes while it ticks (.vls), for
+//       quick save / load and rollback. The level, the settings and whatever the world
+//       can work out again (hitbox boxes and grid, flow field, caches) are not in it, so
+//       a state only loads into a world running the same level. A state is a fixed header
+//       followed by plain little endian records, with no pointers in it:
+//
+//           WorldStateHeader
+//           players  player_count x PlayerRecord
+//           enemies  enemy_count  x EnemyRecord
+//           bullets  bullet_count each of x, y, z, vx, vy, vz, age (double), then owner
+//                    (int32), as CProjectilePool::save() writes them
+//
+//       CStateRing keeps the last STATE_RING_TICKS states in buffers it reuses, so a
+//       game can save after every tick and roll back without allocating.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __worldStateH__
+#define __worldStateH__
+
+#include "gameSim.h"
+#include <stdint.h>
+#include <vector>
+
+namespace sim
+{
+	#define WORLD_STATE_MAGIC "VLWS"
+	#define WORLD_STATE_VERSION 1
+	#define STATE_RING_TICKS 64
+
+	struct WorldStateHeader
+	{
+		char		magic[4];
+		uint32_t	version;
+		uint32_t	cols, rows;         // of the level it was saved from
+		uint32_t	wall_count;
+		uint32_t	spawn_count;
+		uint32_t	player_count;
+		uint32_t	enemy_count;
+		uint32_t	bullet_count;
+		int32_t		status;
+		uint64_t	tick;
+		uint64_t	size;               // of the whole state
+	};
+
+	struct PlayerRecord
+	{
+		double		pos_x, pos_z;
+		double		target_x, target_y, target_z;
+		int32_t		life, shots;
+		int32_t		active;
+		int32_t		reserved;
+	};
+
+	struct EnemyRecord
+	{
+		double		pos_x, pos_z;
+		int32_t		life, shots;
+		int32_t		alive;
+		int32_t		reserved;
+	};
+
+	// saves the world after each tick, oldest written over first
+	class CStateRing {
+	public:
+		CStateRing(void) : m_newest(0), m_count(0) {}
+
+		void clear() { m_count = 0; }
+		void save(const CWorld& world);
+		int size() const { return m_count; }
+
+		// back 0 is the newest state; the states after it are dropped, so the next save()
+		// follows it. False when there is no such state or it does not fit the world.
+		bool rollback(CWorld& world, int back);
+		const std::vector<unsigned char>& get(int back) const;
+
+	private:
+		std::vector<unsigned char>	m_states[STATE_RING_TICKS];
+		int							m_newest;
+		int							m_count;
+	};
+
+	bool saveStateFile(const char* path, const CWorld& world);
+	bool loadStateFile(const char* path, CWorld& world);
+}
+
+#endif // __worldStateH__